@@ -93,6 +93,15 @@ typedef enum drob_error_handling {
     DROB_ERROR_HANDLING_ABORT,
 } drob_error_handling;
 
+typedef enum drob_code_align {
+    /* Align all blocks */
+    DROB_CODE_ALIGN_BLOCKS = 0,
+    /* Only align loop headers, pack everything else densely */
+    DROB_CODE_ALIGN_LOOPS,
+    /* Pack all blocks densely */
+    DROB_CODE_ALIGN_NONE,
+} drob_code_align;
+
 struct drob_cfg;
 typedef struct drob_cfg drob_cfg;
 typedef void* drob_f;
@@ -173,16 +182,42 @@ int drob_cfg_set_ptr_align(drob_cfg *cfg, int nr, uint16_t align);
  */
 int drob_cfg_add_const_range(drob_cfg *cfg, void *start, unsigned long size);
 
+/*
+ * Provide profile information about a conditional branch in the original
+ * code (e.g. collected via hardware counters or an instrumented build): how
+ * often it was taken and how often not. Hot paths will be laid out as
+ * fallthrough and rarely executed code will be moved out of the way.
+ */
+int drob_cfg_add_branch_profile(drob_cfg *cfg, const void *branch,
+                                unsigned long long taken,
+                                unsigned long long not_taken);
+
 /*
  * Should all unmodelled instructions lead to a rewriting failure?
  */
 void drob_cfg_fail_on_unmodelled(drob_cfg *cfg, bool fail);
 
 /*
- * How often to unroll simple loops. Default is 10.
+ * How often to unroll loops at most (number of additional copies of the loop
+ * body), if the trip count is unknown or too big to unroll completely. Small
+ * loops with a known trip count are always unrolled completely. 0 disables
+ * loop unrolling. Default is 10.
  */
 void drob_cfg_set_simple_loop_unroll_count(drob_cfg *cfg, uint16_t count);
 
+/*
+ * Which blocks to align in the generated code. Function entries are always
+ * aligned. Default is DROB_CODE_ALIGN_BLOCKS.
+ */
+void drob_cfg_set_code_align(drob_cfg *cfg, drob_code_align align);
+
+/*
+ * Avoid branches (including macro-fused compare and branch pairs) crossing or
+ * ending on 32 byte boundaries, which CPUs affected by the JCC erratum cannot
+ * serve from the decoded instruction cache. Default is false.
+ */
+void drob_cfg_mitigate_jcc_erratum(drob_cfg *cfg, bool mitigate);
+
 /*
  * How to proceed if rewriting failed?
  */
@@ -208,6 +243,13 @@ drob_f drob_optimize(drob_f func, const drob_cfg *cfg);
  */
 void drob_free(drob_f func);
 
+/*
+ * Drop all cached information (e.g. decoded instructions) about an original
+ * function, e.g. because its code was modified. If NULL is given, all cached
+ * information is dropped. drob_teardown() drops all cached information.
+ */
+void drob_invalidate(drob_f func);
+
 #ifdef __cplusplus
 }
 #endif
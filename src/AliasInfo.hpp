@@ -0,0 +1,166 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef ALIASINFO_HPP
+#define ALIASINFO_HPP
+
+#include "Instruction.hpp"
+#include "InstructionInfo.hpp"
+#include "RewriterCfg.hpp"
+
+namespace drob {
+
+/*
+ * A simple alias model based on the pointers computed by the stack analysis
+ * and the configured user pointer flags.
+ *
+ * We only reason about accesses where the computed pointer is exactly known
+ * (a stack/user pointer + offset, or an immediate). Deriving the base pointer
+ * from the SIB components alone is not safe: compilers happily address one
+ * object via another one (e.g. "a + (b - a)" as part of induction variable
+ * optimizations).
+ */
+
+static inline bool isKnownAccess(const MemAccess &acc)
+{
+    return acc.ptrVal.isPtr() || acc.ptrVal.isImm();
+}
+
+static inline bool isConstUsrPtrAccess(const MemAccess &acc,
+                                       const RewriterCfg &cfg)
+{
+    return acc.ptrVal.isUsrPtr() && cfg.getUsrPtrCfg(acc.ptrVal.getNr()).isConst;
+}
+
+static inline bool isRestrictUsrPtrAccess(const MemAccess &acc,
+                                          const RewriterCfg &cfg)
+{
+    return acc.ptrVal.isUsrPtr() &&
+           cfg.getUsrPtrCfg(acc.ptrVal.getNr()).isRestrict;
+}
+
+static inline bool rangesOverlap(int64_t lhs, uint8_t lhsSize, int64_t rhs,
+                                 uint8_t rhsSize)
+{
+    return lhs < rhs + rhsSize && rhs < lhs + lhsSize;
+}
+
+/*
+ * Check if two memory accesses may alias, whereby at least one of them is
+ * a write.
+ */
+static inline bool mayAlias(const MemAccess &lhs, const MemAccess &rhs,
+                            const RewriterCfg &cfg)
+{
+    const uint8_t lhsSize = static_cast<uint8_t>(lhs.size);
+    const uint8_t rhsSize = static_cast<uint8_t>(rhs.size);
+    uint64_t lhsVal, rhsVal;
+
+    /* No actual memory access (e.g. LEA) */
+    if (lhs.mode == AccessMode::None || lhs.mode == AccessMode::Address ||
+        rhs.mode == AccessMode::None || rhs.mode == AccessMode::Address) {
+        return false;
+    }
+
+    /* Constant user memory is never written */
+    if (isConstUsrPtrAccess(lhs, cfg) || isConstUsrPtrAccess(rhs, cfg)) {
+        return false;
+    }
+
+    /* Unknown pointers or sizes (e.g. string instructions) */
+    if (!isKnownAccess(lhs) || !isKnownAccess(rhs) || !lhsSize || !rhsSize) {
+        return true;
+    }
+
+    /* Same base pointer, just compare the offsets */
+    if (lhs.ptrVal.isPtr() && lhs.ptrVal.getType() == rhs.ptrVal.getType() &&
+        lhs.ptrVal.getNr() == rhs.ptrVal.getNr()) {
+        return rangesOverlap(lhs.ptrVal.getPtrOffset(), lhsSize,
+                             rhs.ptrVal.getPtrOffset(), rhsSize);
+    }
+
+    /*
+     * Memory accessed via a restrict pointer is only accessed via that
+     * pointer. The other access is based on a different pointer.
+     */
+    if (isRestrictUsrPtrAccess(lhs, cfg) || isRestrictUsrPtrAccess(rhs, cfg)) {
+        return false;
+    }
+
+    /* Compare the actual addresses if we know them */
+    if (ptrToInt(lhs.ptrVal, cfg, &lhsVal) && ptrToInt(rhs.ptrVal, cfg, &rhsVal)) {
+        return rangesOverlap(lhsVal, lhsSize, rhsVal, rhsSize);
+    }
+    return true;
+}
+
+/*
+ * Check if an instruction may write memory that aliases with the given
+ * memory access (that is not performed by that instruction).
+ */
+static inline bool mayWriteAlias(const Instruction &instr, const MemAccess &acc,
+                                 const RewriterCfg &cfg)
+{
+    const DynamicInstructionInfo *dynInfo = instr.getDynInfo();
+    bool foundWrite = false;
+
+    if (!dynInfo || dynInfo->nasty) {
+        return true;
+    } else if (!dynInfo->mayWriteMem) {
+        return false;
+    }
+
+    for (const auto &operand : dynInfo->operands) {
+        if (operand.type != OperandType::MemPtr ||
+            !(operand.isOutput || operand.isCondOutput)) {
+            continue;
+        }
+        foundWrite = true;
+        if (mayAlias(operand.memAcc, acc, cfg)) {
+            return true;
+        }
+    }
+    /* Writes memory, but we don't know where */
+    return !foundWrite;
+}
+
+/*
+ * Check if an instruction may write memory that is read by another
+ * instruction.
+ */
+static inline bool mayWriteAlias(const Instruction &writer,
+                                 const Instruction &reader,
+                                 const RewriterCfg &cfg)
+{
+    const DynamicInstructionInfo *dynInfo = reader.getDynInfo();
+
+    if (!dynInfo || dynInfo->nasty) {
+        return true;
+    }
+
+    for (const auto &operand : dynInfo->operands) {
+        if (operand.type != OperandType::MemPtr || !operand.isInput) {
+            continue;
+        }
+        if (mayWriteAlias(writer, operand.memAcc, cfg)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} /* namespace drob */
+
+#endif /* ALIASINFO_HPP */
@@ -83,10 +83,30 @@ const uint8_t *BinaryPool::nextCode()
     return nextInstr;
 }
 
-const uint8_t *BinaryPool::newBlock(bool write)
+bool BinaryPool::rewindCode(const uint8_t *addr)
 {
-    if (!IS_ALIGNED(nextInstr, ARCH_BLOCK_ALIGN)) {
-        uint8_t *aligned = (uint8_t *)ALIGN_UP(nextInstr, ARCH_BLOCK_ALIGN);
+    drob_assert(addr >= mmapStart && addr <= nextInstr);
+
+    /* we don't want to deal with already allocated pages */
+    if (ALIGN_DOWN(addr, ARCH_PAGE_SIZE) != (uint64_t)curInstrPage) {
+        return false;
+    }
+    nextInstr = (uint8_t *)addr;
+    return true;
+}
+
+const uint8_t *BinaryPool::newBlock(bool write, bool align)
+{
+    if (align) {
+        return alignCode(ARCH_BLOCK_ALIGN, write);
+    }
+    return nextInstr;
+}
+
+const uint8_t *BinaryPool::alignCode(int alignment, bool write)
+{
+    if (!IS_ALIGNED(nextInstr, alignment)) {
+        uint8_t *aligned = (uint8_t *)ALIGN_UP(nextInstr, alignment);
 
         /* pad it with NOPs - we cannot cross page boundaries here */
         if (write) {
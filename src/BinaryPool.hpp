@@ -73,10 +73,21 @@ public:
     const uint8_t *nextCode(void);
 
     /*
-     * Align the memory for the next sequential instruction to the
-     * block size and pad it with NOPs.
+     * Drop all code starting at the given address, e.g. to generate it
+     * again at a different location. Returns false if not possible.
      */
-    const uint8_t *newBlock(bool write);
+    bool rewindCode(const uint8_t *addr);
+
+    /*
+     * Align the memory for the next sequential instruction and pad it
+     * with NOPs.
+     */
+    const uint8_t *alignCode(int alignment, bool write);
+
+    /*
+     * Start a new block, optionally aligning it to the block size.
+     */
+    const uint8_t *newBlock(bool write, bool align = true);
 
     /*
      * Move the constant to the constant pool and return the address to the
@@ -0,0 +1,157 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef DECODECACHE_HPP
+#define DECODECACHE_HPP
+
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include "ICFG.hpp"
+#include "RewriterCfg.hpp"
+#include "MemProtCache.hpp"
+#include "NodeCallback.hpp"
+
+namespace drob {
+
+/*
+ * Process-wide cache of reconstructed ICFGs, indexed by the original entry
+ * itext. Specializing the same function multiple times (e.g. with different
+ * parameters) can then skip decoding and ICFG reconstruction and start with
+ * a copy of the cached ICFG.
+ *
+ * We have to assume that the original code does not change until the
+ * function is invalidated (or all functions are invalidated on teardown).
+ */
+class DecodeCache {
+public:
+    static DecodeCache &instance()
+    {
+        static DecodeCache _instance;
+
+        return _instance;
+    }
+
+    /*
+     * Replace the content of the given ICFG by a copy of the cached ICFG for
+     * the function specified in the config. Returns false if there is no
+     * cached ICFG that can be used for this config.
+     */
+    bool lookup(ICFG &icfg, const RewriterCfg &cfg,
+                const MemProtCache &memProtCache)
+    {
+        auto it = entries.find(cfg.getItext());
+
+        if (it == entries.end()) {
+            return false;
+        }
+
+        /* We might have decoded unmodelled instructions */
+        if (cfg.getDrobCfg().fail_on_unmodelled &&
+            !it->second.failOnUnmodelled) {
+            return false;
+        }
+
+        drob_info("Using cached ICFG for function: %p", cfg.getItext());
+        icfg.copy(*it->second.icfg);
+
+        /*
+         * Targets read from memory depend on the (configured) constant memory
+         * ranges. If any target changed, we have to reconstruct the ICFG.
+         */
+        RawTargetCollector collector(memProtCache);
+        icfg.for_each_instruction_any(&collector);
+        if (collector.targets != it->second.targets) {
+            drob_info("Cached ICFG cannot be used, targets changed");
+            icfg.reset();
+            return false;
+        }
+        return true;
+    }
+
+    /*
+     * Cache a copy of a freshly reconstructed ICFG for the function
+     * specified in the config.
+     */
+    void insert(ICFG &icfg, const RewriterCfg &cfg,
+                const MemProtCache &memProtCache)
+    {
+        RawTargetCollector collector(memProtCache);
+        Entry entry;
+
+        icfg.for_each_instruction_any(&collector);
+
+        entry.icfg = std::make_unique<ICFG>();
+        entry.icfg->copy(icfg);
+        entry.targets = std::move(collector.targets);
+        entry.failOnUnmodelled = cfg.getDrobCfg().fail_on_unmodelled;
+
+        entries[cfg.getItext()] = std::move(entry);
+    }
+
+    void invalidateFunction(const uint8_t *itext)
+    {
+        entries.erase(itext);
+    }
+
+    void invalidateAllFunctions()
+    {
+        entries.clear();
+    }
+
+private:
+    DecodeCache() = default;
+    DecodeCache(const DecodeCache&) = delete;
+    DecodeCache &operator=(const DecodeCache &) = delete;
+
+    /*
+     * Collect the raw targets of all branches and calls in ICFG order.
+     */
+    class RawTargetCollector: public NodeCallback {
+    public:
+        RawTargetCollector(const MemProtCache &memProtCache) :
+            memProtCache(memProtCache) {}
+
+        int handleInstruction(Instruction *instruction, SuperBlock *block,
+                              Function *function)
+        {
+            (void)block;
+            (void)function;
+            if (instruction->isBranch() || instruction->isCall()) {
+                targets.push_back(instruction->getRawTarget(memProtCache));
+            }
+            return 0;
+        }
+
+        std::vector<const uint8_t *> targets;
+    private:
+        const MemProtCache &memProtCache;
+    };
+
+    typedef struct Entry {
+        /* the ICFG right after reconstruction */
+        std::unique_ptr<ICFG> icfg;
+        /* raw targets of all branches and calls, as resolved when decoding */
+        std::vector<const uint8_t *> targets;
+        /* decoded while failing on unmodelled instructions */
+        bool failOnUnmodelled;
+    } Entry;
+
+    std::unordered_map<const uint8_t *, Entry> entries;
+};
+
+} /* namespace drob */
+
+#endif /* DECODECACHE_HPP */
@@ -340,11 +340,97 @@ SuperBlock* Function::copyBlock(SuperBlock *block)
     return blockRet;
 }
 
+void Function::copyBlocks(const Function &function,
+                          std::unordered_map<const Instruction *, Instruction *> &instrMap,
+                          std::unordered_map<const SuperBlock *, SuperBlock *> &blockMap)
+{
+    std::unordered_map<const BranchEdge *, std::shared_ptr<BranchEdge>> edgeMap;
+
+    /* copy all blocks and instructions */
+    for (auto & block : function.blocks) {
+        std::unique_ptr<SuperBlock> newBlock = std::make_unique<SuperBlock>(this);
+
+        for (auto & instr : block->instrs) {
+            std::unique_ptr<Instruction> newInstr = std::make_unique<Instruction>(*instr);
+
+            instrMap.insert(std::make_pair(instr.get(), newInstr.get()));
+            newBlock->appendInstruction(newInstr);
+        }
+        blockMap.insert(std::make_pair(block.get(), newBlock.get()));
+        addBlock(std::move(newBlock));
+    }
+
+    /* wire up the fallthrough chain and the outgoing edges */
+    for (auto & block : function.blocks) {
+        SuperBlock *newBlock = blockMap.at(block.get());
+
+        if (block->prev) {
+            newBlock->prev = blockMap.at(block->prev);
+        }
+        if (block->next) {
+            newBlock->next = blockMap.at(block->next);
+        }
+        for (auto & edge : block->outgoingEdges) {
+            auto newEdge = std::make_shared<BranchEdge>(blockMap.at(edge->dst),
+                                                        newBlock,
+                                                        instrMap.at(edge->instruction));
+
+            newEdge->instruction->setBranchEdge(newEdge);
+            newBlock->addOutgoingEdge(newEdge);
+            edgeMap.insert(std::make_pair(edge.get(), newEdge));
+        }
+    }
+
+    /* incoming edges, keeping the order */
+    for (auto & block : function.blocks) {
+        SuperBlock *newBlock = blockMap.at(block.get());
+
+        for (auto & edge : block->incomingEdges) {
+            newBlock->addIncomingEdge(edgeMap.at(edge.get()));
+        }
+    }
+
+    invalidateLivenessAnalysis();
+    invalidateStackAnalysis();
+}
+
+std::unique_ptr<Function> Function::copy(ICFG *icfg,
+        std::unordered_map<const Instruction *, Instruction *> &instrMap) const
+{
+    std::unique_ptr<Function> newFunction = std::make_unique<Function>(icfg, itext);
+    std::unordered_map<const SuperBlock *, SuperBlock *> blockMap;
+
+    drob_info("Copying function %p (%p)", this, itext);
+
+    if (info) {
+        newFunction->setInfo(*info);
+    }
+
+    newFunction->copyBlocks(*this, instrMap, blockMap);
+    if (entryBlock) {
+        newFunction->entryBlock = blockMap.at(entryBlock);
+    }
+
+    for (auto & edge : returnEdges) {
+        auto newEdge = std::make_shared<ReturnEdge>();
+
+        newEdge->src = blockMap.at(edge->src);
+        newEdge->dst = newFunction.get();
+        newEdge->instruction = instrMap.at(edge->instruction);
+
+        newEdge->instruction->setReturnEdge(newEdge);
+        newFunction->addReturnEdge(newEdge);
+    }
+
+    return newFunction;
+}
+
 SuperBlock* Function::decodeBlock(const uint8_t *itext, const RewriterCfg& cfg)
 {
     std::unique_ptr<SuperBlock> newBlock = std::make_unique<SuperBlock>(this);
     std::list<std::unique_ptr<Instruction>> instrs;
     SuperBlock *blockRet = newBlock.get();
+    bool afterCall = false;
     DecodeRet ret;
 
     drob_info("Decoding block %p (%p)", newBlock.get(), itext);
@@ -364,6 +450,17 @@ SuperBlock* Function::decodeBlock(const uint8_t *itext, const RewriterCfg& cfg)
             /* next read over the page boundary */
             ret = arch_decode_one(&itext, ARCH_PAGE_SIZE, instrs, cfg);
         }
+        if (afterCall && (ret == DecodeRet::UnhandledInstr ||
+                          ret == DecodeRet::UnsupportedInstr ||
+                          ret == DecodeRet::BrokenInstr)) {
+            /*
+             * Calls to unknown noreturn functions are followed by padding or
+             * other functions. End the block, as if the call never returned.
+             */
+            drob_info("Cannot decode after call, ending block");
+            instrs.clear();
+            break;
+        }
         if (unlikely(ret == DecodeRet::UnhandledInstr)) {
             drob_throw("Unhandled instruction");
         } else if (unlikely(ret == DecodeRet::UnsupportedInstr)) {
@@ -374,6 +471,7 @@ SuperBlock* Function::decodeBlock(const uint8_t *itext, const RewriterCfg& cfg)
 
         if (ret != DecodeRet::NOP) {
             drob_assert(!instrs.empty());
+            afterCall = instrs.back()->isCall();
             newBlock->addInstructions(instrs);
         }
 
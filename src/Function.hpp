@@ -20,6 +20,8 @@
 #include <queue>
 #include <stack>
 #include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "Utils.hpp"
 #include "Node.hpp"
@@ -43,6 +45,11 @@ typedef struct CallEdge {
     Function *src;
     Instruction *instruction;
     bool invalidated{false};
+    /*
+     * The ProgramState at the call site (after emulating the call), as
+     * computed by stack analysis. Used for interprocedural analysis.
+     */
+    std::shared_ptr<ProgramState> state;
 
     /* FIXME: store the source block */
 
@@ -313,6 +320,28 @@ public:
      */
     SuperBlock* copyBlock(SuperBlock *block);
 
+    /*
+     * Create a copy of the function for the given ICFG. All blocks,
+     * instructions, branch edges and return edges are copied, keeping their
+     * order. Call edges are not copied, however, all copied instructions are
+     * recorded in instrMap, so the caller can fix them up. Analysis
+     * information is not copied.
+     */
+    std::unique_ptr<Function> copy(ICFG *icfg,
+            std::unordered_map<const Instruction *, Instruction *> &instrMap) const;
+
+    /*
+     * Copy all blocks of the given function into this function, including
+     * branch edges and the fallthrough chain. Call and return edges are not
+     * copied, however, all copied instructions and blocks are recorded in
+     * instrMap and blockMap, so the caller can fix them up. If this function
+     * has no entry block yet, the first copied block will be the entry.
+     * Must not be called while iterating over blocks.
+     */
+    void copyBlocks(const Function &function,
+                    std::unordered_map<const Instruction *, Instruction *> &instrMap,
+                    std::unordered_map<const SuperBlock *, SuperBlock *> &blockMap);
+
     const std::vector<std::shared_ptr<CallEdge>>& getIncomingEdges(void) const
     {
         return incomingEdges;
@@ -382,6 +411,31 @@ public:
         drob_assert_not_reached();
     }
 
+    /*
+     * Check if the function (directly or indirectly) calls itself.
+     */
+    bool isRecursive(void) const
+    {
+        std::vector<const Function *> functions;
+        std::unordered_set<const Function *> visited;
+
+        functions.push_back(this);
+        while (!functions.empty()) {
+            const Function *f = functions.back();
+
+            functions.pop_back();
+            for (auto & edge : f->outgoingEdges) {
+                if (edge->dst == this) {
+                    return true;
+                }
+                if (visited.insert(edge->dst).second) {
+                    functions.push_back(edge->dst);
+                }
+            }
+        }
+        return false;
+    }
+
     ICFG *getICFG(void)
     {
         return icfg;
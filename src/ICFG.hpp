@@ -17,6 +17,7 @@
 #define ICFG_HPP
 
 #include <stack>
+#include <unordered_map>
 
 #include "Instruction.hpp"
 #include "Function.hpp"
@@ -216,9 +217,52 @@ public:
         functions.clear();
     }
 
+    /*
+     * Replace all functions by a copy of the functions of the given ICFG,
+     * including all edges. Analysis information is not copied.
+     */
+    void copy(const ICFG &other)
+    {
+        std::unordered_map<const Instruction *, Instruction *> instrMap;
+        std::unordered_map<const Function *, Function *> functionMap;
+        std::unordered_map<const CallEdge *, std::shared_ptr<CallEdge>> edgeMap;
+
+        reset();
+
+        for (auto && f : other.functions) {
+            std::unique_ptr<Function> newFunction = f->copy(this, instrMap);
+
+            functionMap.insert(std::make_pair(f.get(), newFunction.get()));
+            functions.push_back(std::move(newFunction));
+        }
+        if (other.entryFunction) {
+            entryFunction = functionMap.at(other.entryFunction);
+        }
+
+        /* wire up all call edges, keeping the order */
+        for (auto && f : other.functions) {
+            for (auto && edge : f->getOutgoingEdges()) {
+                auto newEdge = std::make_shared<CallEdge>();
+
+                newEdge->src = functionMap.at(edge->src);
+                newEdge->dst = functionMap.at(edge->dst);
+                newEdge->instruction = instrMap.at(edge->instruction);
+
+                newEdge->instruction->setCallEdge(newEdge);
+                newEdge->src->addOutgoingEdge(newEdge);
+                edgeMap.insert(std::make_pair(edge.get(), newEdge));
+            }
+        }
+        for (auto && f : other.functions) {
+            for (auto && edge : f->getIncomingEdges()) {
+                functionMap.at(f.get())->addIncomingEdge(edgeMap.at(edge.get()));
+            }
+        }
+    }
+
     /*
      * We might want to
-     * - copy functions (e.g. create different flavors)
+     * - copy single functions (e.g. create different flavors)
      */
 private:
     /*
@@ -487,6 +487,11 @@ Instruction::genDynInfo(ProgramState &ps, const RewriterCfg &cfg,
         }
         if (dynOpInfo.isOutput) {
             if (dynOpInfo.type == OperandType::Register) {
+                if (liveRegs && !(liveRegs->live_out &
+                                  getSubRegisterMask(dynOpInfo.regAcc.reg,
+                                                     dynOpInfo.regAcc.w))) {
+                    dynOpInfo.isDeadOutput = true;
+                }
                 if (dynOpInfo.isCondOutput) {
                     dynInfo->condWrittenRegs += getSubRegisterMask(dynOpInfo.regAcc.reg,
                                                                    dynOpInfo.regAcc.w);
@@ -571,6 +576,47 @@ static EmuRet emulateGeneric(DynamicInstructionInfo &dynInfo)
     return EmuRet::Ok;
 }
 
+/*
+ * Check if two dynamic instruction infos (of the same instruction) have the
+ * same inputs and therefore produce the same outputs when emulated. Outputs
+ * only depend on the inputs and on the refined operand accesses (dead outputs
+ * might not have been calculated).
+ */
+static bool sameInputs(const DynamicInstructionInfo &prev,
+                       const DynamicInstructionInfo &cur)
+{
+    if (prev.willExecute != cur.willExecute || prev.nasty != cur.nasty ||
+        prev.operands.size() != cur.operands.size()) {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < cur.operands.size(); i++) {
+        const DynamicOperandInfo &p = prev.operands[i];
+        const DynamicOperandInfo &c = cur.operands[i];
+
+        if (p.isInput != c.isInput || p.isCondInput != c.isCondInput ||
+            p.isOutput != c.isOutput || p.isCondOutput != c.isCondOutput ||
+            p.isDeadOutput != c.isDeadOutput) {
+            return false;
+        }
+        if (c.isInput && p.input != c.input) {
+            return false;
+        }
+        if (c.type == OperandType::Register) {
+            if (p.regAcc.mode != c.regAcc.mode) {
+                return false;
+            }
+        } else if (c.type == OperandType::MemPtr) {
+            if (p.memAcc.mode != c.memAcc.mode ||
+                p.memAcc.size != c.memAcc.size ||
+                p.memAcc.ptrVal != c.memAcc.ptrVal) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 void Instruction::emulate(ProgramState &ps, const RewriterCfg &cfg,
                           const MemProtCache &memProtCache,
                           bool cacheDynInfo) const
@@ -583,12 +629,6 @@ void Instruction::emulate(ProgramState &ps, const RewriterCfg &cfg,
         goto skip_emulation;
     }
 
-    /*
-     * TODO: If we have previous data and the inputs match, we can skip the
-     * actual emulation. But not sure if the comparisons are faster than the
-     * actual emulator.
-     */
-
     /*
      * Caller has to handle effects of ret/call/jmp.
      */
@@ -596,10 +636,18 @@ void Instruction::emulate(ProgramState &ps, const RewriterCfg &cfg,
         ps.nastyInstruction();
     } else  {
         /*
-         * Run the opcode specific emulation function if possible. Fallback to
-         * the generic emulator.
+         * If the inputs match the ones of the last emulation (e.g. when
+         * reanalyzing a block after a merge didn't change the values this
+         * instruction consumes), reuse the outputs. Otherwise, run the opcode
+         * specific emulation function if possible. Fallback to the generic
+         * emulator.
          */
-        if (!opcodeInfo->emulate) {
+        if (cachedDynInfo && sameInputs(*cachedDynInfo, *dynInfo)) {
+            for (unsigned int i = 0; i < dynInfo->operands.size(); i++) {
+                dynInfo->operands[i].output = cachedDynInfo->operands[i].output;
+            }
+            ret = cachedEmuRet;
+        } else if (!opcodeInfo->emulate) {
             ret = emulateGeneric(*dynInfo);
         } else if (opcodeInfo->flags & OfEmuFull) {
             ret = opcodeInfo->emulate(*dynInfo, cfg);
@@ -617,6 +665,10 @@ void Instruction::emulate(ProgramState &ps, const RewriterCfg &cfg,
             }
         }
 
+        if (cacheDynInfo) {
+            cachedEmuRet = ret;
+        }
+
         /*
          * Move all output to the destination. We have to take care of
          * conditional execution and conditional writes.
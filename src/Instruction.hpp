@@ -269,6 +269,23 @@ public:
         this->useShortBranch = useShortBranch;
     }
 
+    /*
+     * A tail call jumps to the called function instead of calling it, the
+     * called function returns directly to our caller. Only set right before
+     * code generation, analyses don't know about tail calls.
+     */
+    bool isTailCall(void) const
+    {
+        drob_assert(isCall());
+        return tailCall;
+    }
+
+    void setTailCall(bool tailCall)
+    {
+        drob_assert(isCall());
+        this->tailCall = tailCall;
+    }
+
     /*
      * Get the call edge for a call instruction.
      */
@@ -400,6 +417,7 @@ private:
     std::shared_ptr<CallEdge> callEdge;
     std::shared_ptr<ReturnEdge> returnEdge;
     bool useShortBranch{false};
+    bool tailCall{false};
 
     /*
      * Cached information about this instruction. Invalidated on
@@ -408,6 +426,8 @@ private:
     mutable std::unique_ptr<InstructionInfo> cachedInfo;
     mutable std::unique_ptr<DynamicInstructionInfo> cachedDynInfo;
     mutable std::unique_ptr<LivenessData> liveRegs;
+    /* Result of the emulator that produced the outputs in cachedDynInfo */
+    mutable EmuRet cachedEmuRet{EmuRet::Ok};
 
     /* Helper functions */
     OperandInfo createOperandInfo(const StaticOperandInfo &rawInfo, int nr,
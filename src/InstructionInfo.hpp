@@ -136,6 +136,11 @@ typedef struct DynamicOperandInfo {
     bool isCondInput{false};
     bool isOutput{false};
     bool isCondOutput{false};
+    /*
+     * The output will not be read by anybody (register liveness). Emulators
+     * don't have to calculate it (e.g. eflags).
+     */
+    bool isDeadOutput{false};
     /*
      * If we don't have an immediate, this is the actual register/memory
      * pointer. The input located at that location (eventually) is given below.
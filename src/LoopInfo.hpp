@@ -0,0 +1,313 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef LOOPINFO_HPP
+#define LOOPINFO_HPP
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <utility>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Utils.hpp"
+#include "Function.hpp"
+#include "SuperBlock.hpp"
+
+namespace drob {
+
+/*
+ * A natural loop. The header dominates all blocks of the loop, so the loop
+ * can only be entered via the header.
+ */
+typedef struct Loop {
+    /* the single entry into the loop */
+    SuperBlock *header;
+    /* all blocks of the loop (including the header) */
+    std::unordered_set<SuperBlock *> blocks;
+    /* all blocks of the loop in a stable order, starting with the header */
+    std::vector<SuperBlock *> blockList;
+    /* all blocks that branch/fall through back to the header */
+    std::vector<SuperBlock *> latches;
+    /* the loop does not contain other loops */
+    bool innermost;
+} Loop;
+
+/*
+ * Dominator tree and natural loops of a function. Only blocks reachable
+ * from the entry block are considered. Fallthrough (next/prev) is treated
+ * like a branch edge. The information is not updated when the function
+ * is modified.
+ */
+class LoopInfo {
+public:
+    LoopInfo(Function *function)
+    {
+        computeOrder(function->getEntryBlock());
+        computeDominators();
+        computeLoops();
+    }
+
+    /*
+     * All successors of a block (branch edges and the fallthrough block).
+     */
+    static std::vector<SuperBlock *> getSuccessors(SuperBlock *block)
+    {
+        std::vector<SuperBlock *> succs;
+
+        for (auto & edge : block->getOutgoingEdges()) {
+            succs.push_back(edge->dst);
+        }
+        if (block->getNext()) {
+            succs.push_back(block->getNext());
+        }
+        return succs;
+    }
+
+    /*
+     * All predecessors of a block (branch edges and the previous block).
+     */
+    static std::vector<SuperBlock *> getPredecessors(SuperBlock *block)
+    {
+        std::vector<SuperBlock *> preds;
+
+        for (auto & edge : block->getIncomingEdges()) {
+            preds.push_back(edge->src);
+        }
+        if (block->getPrev()) {
+            preds.push_back(block->getPrev());
+        }
+        return preds;
+    }
+
+    /*
+     * Is the block reachable from the entry block?
+     */
+    bool isReachable(SuperBlock *block) const
+    {
+        return order.count(block);
+    }
+
+    /*
+     * Does block a dominate block b? Every block dominates itself.
+     */
+    bool dominates(SuperBlock *a, SuperBlock *b) const
+    {
+        if (!isReachable(a) || !isReachable(b)) {
+            return false;
+        }
+        while (true) {
+            if (a == b) {
+                return true;
+            }
+            SuperBlock *dom = idom.at(b);
+            if (dom == b) {
+                /* we reached the entry block */
+                return false;
+            }
+            b = dom;
+        }
+    }
+
+    /*
+     * Get the immediate dominator of a block. The entry block is its own
+     * immediate dominator.
+     */
+    SuperBlock *getImmediateDominator(SuperBlock *block) const
+    {
+        auto it = idom.find(block);
+
+        return it == idom.end() ? nullptr : it->second;
+    }
+
+    /*
+     * All natural loops, in reverse postorder of their headers (outer loops
+     * before inner loops). Loops sharing a header are merged.
+     */
+    const std::vector<std::unique_ptr<Loop>>& getLoops(void) const
+    {
+        return loops;
+    }
+private:
+    /*
+     * Compute the reverse postorder of all reachable blocks.
+     */
+    void computeOrder(SuperBlock *entry)
+    {
+        std::vector<std::pair<SuperBlock *, std::vector<SuperBlock *>>> stack;
+        std::unordered_set<SuperBlock *> visited;
+        std::vector<SuperBlock *> postorder;
+
+        if (!entry) {
+            return;
+        }
+        stack.emplace_back(entry, getSuccessors(entry));
+        visited.insert(entry);
+
+        while (!stack.empty()) {
+            auto & cur = stack.back();
+
+            if (cur.second.empty()) {
+                postorder.push_back(cur.first);
+                stack.pop_back();
+                continue;
+            }
+            /* process successors in order */
+            SuperBlock *succ = cur.second.front();
+            cur.second.erase(cur.second.begin());
+            if (visited.insert(succ).second) {
+                stack.emplace_back(succ, getSuccessors(succ));
+            }
+        }
+
+        rpo.assign(postorder.rbegin(), postorder.rend());
+        for (unsigned int i = 0; i < rpo.size(); i++) {
+            order[rpo[i]] = i;
+        }
+    }
+
+    SuperBlock *intersect(SuperBlock *a, SuperBlock *b) const
+    {
+        while (a != b) {
+            while (order.at(a) > order.at(b)) {
+                a = idom.at(a);
+            }
+            while (order.at(b) > order.at(a)) {
+                b = idom.at(b);
+            }
+        }
+        return a;
+    }
+
+    /*
+     * Iterative dominator computation ("A Simple, Fast Dominance Algorithm",
+     * Cooper, Harvey, Kennedy).
+     */
+    void computeDominators(void)
+    {
+        bool changed = true;
+
+        if (rpo.empty()) {
+            return;
+        }
+        idom[rpo.front()] = rpo.front();
+
+        while (changed) {
+            changed = false;
+            for (unsigned int i = 1; i < rpo.size(); i++) {
+                SuperBlock *block = rpo[i];
+                SuperBlock *newIdom = nullptr;
+
+                for (auto & pred : getPredecessors(block)) {
+                    /* unreachable or not processed yet */
+                    if (!idom.count(pred)) {
+                        continue;
+                    }
+                    newIdom = newIdom ? intersect(pred, newIdom) : pred;
+                }
+                drob_assert(newIdom);
+                auto it = idom.find(block);
+                if (it == idom.end() || it->second != newIdom) {
+                    idom[block] = newIdom;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    /*
+     * Detect back edges (the destination dominates the source) and collect
+     * the blocks of the resulting natural loops.
+     */
+    void computeLoops(void)
+    {
+        std::unordered_map<SuperBlock *, Loop *> headers;
+
+        for (auto & block : rpo) {
+            for (auto & succ : getSuccessors(block)) {
+                Loop *loop;
+
+                if (!dominates(succ, block)) {
+                    continue;
+                }
+
+                auto it = headers.find(succ);
+                if (it == headers.end()) {
+                    loops.push_back(std::make_unique<Loop>());
+                    loop = loops.back().get();
+                    loop->header = succ;
+                    loop->innermost = true;
+                    loop->blocks.insert(succ);
+                    headers[succ] = loop;
+                } else {
+                    loop = it->second;
+                }
+                if (std::find(loop->latches.begin(), loop->latches.end(),
+                              block) != loop->latches.end()) {
+                    continue;
+                }
+                loop->latches.push_back(block);
+
+                /* walk backwards from the latch until we reach the header */
+                std::vector<SuperBlock *> worklist = { block };
+                while (!worklist.empty()) {
+                    SuperBlock *cur = worklist.back();
+
+                    worklist.pop_back();
+                    if (!loop->blocks.insert(cur).second) {
+                        continue;
+                    }
+                    for (auto & pred : getPredecessors(cur)) {
+                        if (isReachable(pred)) {
+                            worklist.push_back(pred);
+                        }
+                    }
+                }
+            }
+        }
+
+        /* keep the block lists in reverse postorder, so they are stable */
+        std::sort(loops.begin(), loops.end(),
+                  [this](const std::unique_ptr<Loop> &a, const std::unique_ptr<Loop> &b) {
+                      return order.at(a->header) < order.at(b->header);
+                  });
+        for (auto & loop : loops) {
+            for (auto & block : rpo) {
+                if (loop->blocks.count(block)) {
+                    loop->blockList.push_back(block);
+                }
+            }
+            for (auto & other : loops) {
+                if (other != loop && loop->blocks.count(other->header)) {
+                    loop->innermost = false;
+                }
+            }
+        }
+    }
+
+    /* reachable blocks in reverse postorder */
+    std::vector<SuperBlock *> rpo;
+    /* reverse postorder number of all reachable blocks */
+    std::unordered_map<SuperBlock *, unsigned int> order;
+    /* immediate dominators of all reachable blocks */
+    std::unordered_map<SuperBlock *, SuperBlock *> idom;
+    /* all natural loops */
+    std::vector<std::unique_ptr<Loop>> loops;
+};
+
+} /* namespace drob */
+
+#endif /* LOOPINFO_HPP */
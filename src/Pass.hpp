@@ -96,7 +96,21 @@ private:
 #include "passes/DeadCodeEliminationPass.hpp"
 #include "passes/BlockLayoutOptimizationPass.hpp"
 #include "passes/ICFGReconstructionPass.hpp"
-#include "passes/SimpleLoopUnrollingPass.hpp"
+#include "passes/DevirtualizationPass.hpp"
+#include "passes/LoopUnrollingPass.hpp"
+#include "passes/JumpThreadingPass.hpp"
+#include "passes/LoopInvariantCodeMotionPass.hpp"
+#include "passes/ValueNumberingPass.hpp"
+#include "passes/PeepholeOptimizationPass.hpp"
+#include "passes/StrengthReductionPass.hpp"
+#include "passes/SLPVectorizationPass.hpp"
+#include "passes/ProfileGuidedLayoutPass.hpp"
+#include "passes/StackSlotPromotionPass.hpp"
+#include "passes/DeadStackStoreEliminationPass.hpp"
+#include "passes/FramePointerEliminationPass.hpp"
+#include "passes/TailCallConversionPass.hpp"
+#include "passes/InliningPass.hpp"
+#include "passes/FunctionCloningPass.hpp"
 #include "passes/LivenessAnalysisPass.hpp"
 #include "passes/DeadWriteEliminationPass.hpp"
 #include "passes/InstructionSpecializationPass.hpp"
@@ -245,6 +245,23 @@ public:
             drob_assert_not_reached();
         }
     }
+    bool operator ==(const DynamicValue &rhs) const
+    {
+        if (type != rhs.type)
+            return false;
+        if (isImm()) {
+            if (isImm128() || rhs.isImm128())
+                return getImm128() == rhs.getImm128();
+            return imm64_val == rhs.imm64_val;
+        }
+        if (isPtr())
+            return nr == rhs.nr && ptrOffset == rhs.ptrOffset;
+        return true;
+    }
+    bool operator !=(const DynamicValue &rhs) const
+    {
+        return !(*this == rhs);
+    }
 private:
     typedef enum class ImmediateSize {
         Imm64,
@@ -69,34 +69,71 @@ typedef enum class RegisterAccessType : uint8_t {
 } RegisterAccessType;
 
 #define SUBREGISTER_BITS static_cast<uint16_t>(SubRegister::MAX)
+#define SUBREGISTER_WORDS BITMAP_BITS_TO_ELEMENTS(SUBREGISTER_BITS)
 
 /*
  * Mask of SubRegisters.
+ *
+ * The number of subregisters is known at compile time, so instead of going
+ * via the generic bitmap_* functions (that loop over a runtime number of
+ * elements), we operate on a fixed number of elements. Loops get fully
+ * unrolled/vectorized by the compiler and no function calls are involved.
+ * This matters, as liveness analysis heavily operates on these masks.
+ *
+ * Bits beyond SUBREGISTER_BITS are always kept zero (see fill()).
  */
 typedef struct SubRegisterMask {
     BITMAP_DECLARE(m, SUBREGISTER_BITS);
 
+    static constexpr unsigned int words = SUBREGISTER_WORDS;
+    static constexpr unsigned int lastWordBits =
+            SUBREGISTER_BITS % BITMAP_BITS_PER_ELEMENT;
+    static constexpr bitmap_t lastWordMask = lastWordBits ?
+            (~0ul >> (BITMAP_BITS_PER_ELEMENT - lastWordBits)) : ~0ul;
+
     void zero(void)
     {
-        bitmap_zero(m, SUBREGISTER_BITS);
+        for (unsigned int i = 0; i < words; i++) {
+            m[i] = 0;
+        }
     }
     void fill(void)
     {
-        bitmap_fill(m, SUBREGISTER_BITS);
+        for (unsigned int i = 0; i < words - 1; i++) {
+            m[i] = ~0ul;
+        }
+        m[words - 1] = lastWordMask;
     }
     SubRegisterMask& operator +=(const SubRegisterMask &rhs)
     {
-        bitmap_or(m, m, rhs.m, SUBREGISTER_BITS);
+        for (unsigned int i = 0; i < words; i++) {
+            m[i] |= rhs.m[i];
+        }
         return *this;
     }
     SubRegisterMask& operator -=(const SubRegisterMask &rhs)
     {
-        bitmap_andnot(m, m, rhs.m, SUBREGISTER_BITS);
+        for (unsigned int i = 0; i < words; i++) {
+            m[i] &= ~rhs.m[i];
+        }
+        return *this;
+    }
+    SubRegisterMask& operator &=(const SubRegisterMask &rhs)
+    {
+        for (unsigned int i = 0; i < words; i++) {
+            m[i] &= rhs.m[i];
+        }
         return *this;
     }
     bool operator ==(const SubRegisterMask& rhs) const
     {
-        return bitmap_equal(m, rhs.m, SUBREGISTER_BITS);
+        bitmap_t diff = 0;
+
+        /* no early exit, so this can be vectorized */
+        for (unsigned int i = 0; i < words; i++) {
+            diff |= m[i] ^ rhs.m[i];
+        }
+        return !diff;
     }
     bool operator !=(const SubRegisterMask& rhs) const
     {
@@ -104,7 +141,12 @@ typedef struct SubRegisterMask {
     }
     bool operator !(void) const
     {
-        return bitmap_empty(m, SUBREGISTER_BITS);
+        bitmap_t any = 0;
+
+        for (unsigned int i = 0; i < words; i++) {
+            any |= m[i];
+        }
+        return !any;
     }
     void dump(void) const;
 } SubRegisterMask;
@@ -112,9 +154,9 @@ typedef struct SubRegisterMask {
 static inline SubRegisterMask operator&(const SubRegisterMask& lhs,
                                         const SubRegisterMask& rhs)
 {
-    SubRegisterMask tmp;
+    SubRegisterMask tmp = lhs;
 
-    bitmap_and(tmp.m, lhs.m, rhs.m, SUBREGISTER_BITS);
+    tmp &= rhs;
     return tmp;
 }
 
@@ -39,12 +39,19 @@ Rewriter::Rewriter(const uint8_t * itext, const drob_cfg *drob_cfg) :
     if (unlikely(loglevel >= DROB_LOGLEVEL_DEBUG))
         passes.emplace_back(new DumpPass(icfg, *binaryPool, cfg, memProtCache));
 
-    /* TODO: inline functions */
+    /* Convert indirect calls to known targets into direct calls */
+    passes.emplace_back(new DevirtualizationPass(icfg, *binaryPool, cfg, memProtCache));
+
+    /* Inline small functions called by the entry function */
+    passes.emplace_back(new InliningPass(icfg, *binaryPool, cfg, memProtCache));
+
+    if (unlikely(loglevel >= DROB_LOGLEVEL_DEBUG))
+        passes.emplace_back(new DumpPass(icfg, *binaryPool, cfg, memProtCache));
 
     if (likely(drob_cfg->simple_loop_unroll_count)) {
-        /* Perform a simple block-wise unrolling of simple loops */
-        passes.emplace_back( new SimpleLoopUnrollingPass(icfg, *binaryPool, cfg,
-                                                         memProtCache));
+        /* Unroll innermost loops, completely if the trip count is small */
+        passes.emplace_back(new LoopUnrollingPass(icfg, *binaryPool, cfg,
+                                                  memProtCache));
 
         /* Try to chain and merge blocks */
         passes.emplace_back(new BlockLayoutOptimizationPass(icfg, *binaryPool,
@@ -54,6 +61,12 @@ Rewriter::Rewriter(const uint8_t * itext, const drob_cfg *drob_cfg) :
             passes.emplace_back(new DumpPass(icfg, *binaryPool, cfg, memProtCache));
     }
 
+    /* Clone functions called with different constant parameters */
+    passes.emplace_back(new FunctionCloningPass(icfg, *binaryPool, cfg, memProtCache));
+
+    /* Duplicate blocks whose branches are decided for some predecessors */
+    passes.emplace_back(new JumpThreadingPass(icfg, *binaryPool, cfg, memProtCache));
+
     /* Remove dead code */
     passes.emplace_back(new DeadCodeEliminationPass(icfg, *binaryPool, cfg, memProtCache));
 
@@ -63,15 +76,45 @@ Rewriter::Rewriter(const uint8_t * itext, const drob_cfg *drob_cfg) :
     /* Specialize instructions to known input operands */
     passes.emplace_back(new InstructionSpecializationPass(icfg, *binaryPool, cfg, memProtCache));
 
+    /* Replace multiplications/divisions by known constants */
+    passes.emplace_back(new StrengthReductionPass(icfg, *binaryPool, cfg, memProtCache));
+
     /* Optimize memory operands */
     passes.emplace_back(new MemoryOperandOptimizationPass(icfg, *binaryPool, cfg, memProtCache));
 
+    /* Promote stack slots to unused registers */
+    passes.emplace_back(new StackSlotPromotionPass(icfg, *binaryPool, cfg, memProtCache));
+
+    /* Move loop-invariant instructions out of loops */
+    passes.emplace_back(new LoopInvariantCodeMotionPass(icfg, *binaryPool, cfg, memProtCache));
+
+    /* Remove redundant computations */
+    passes.emplace_back(new ValueNumberingPass(icfg, *binaryPool, cfg, memProtCache));
+
+    /* Pack scalar operations on adjacent memory */
+    passes.emplace_back(new SLPVectorizationPass(icfg, *binaryPool, cfg, memProtCache));
+
+    /* Drop the frame pointer if it is not needed */
+    passes.emplace_back(new FramePointerEliminationPass(icfg, *binaryPool, cfg, memProtCache));
+
+    /* Remove dead stores to the stack */
+    passes.emplace_back(new DeadStackStoreEliminationPass(icfg, *binaryPool, cfg, memProtCache));
+
+    /* Replace instruction sequences by cheaper ones */
+    passes.emplace_back(new PeepholeOptimizationPass(icfg, *binaryPool, cfg, memProtCache));
+
     /* Remove dead writes to registers */
     passes.emplace_back(new DeadWriteEliminationPass(icfg, *binaryPool, cfg, memProtCache));
 
+    /* Convert calls followed by returns into tail calls */
+    passes.emplace_back(new TailCallConversionPass(icfg, *binaryPool, cfg, memProtCache));
+
     /* Try to chain and merge blocks */
     passes.emplace_back(new BlockLayoutOptimizationPass(icfg, *binaryPool, cfg, memProtCache));
 
+    /* Lay out hot paths as fallthrough and move cold blocks out of the way */
+    passes.emplace_back(new ProfileGuidedLayoutPass(icfg, *binaryPool, cfg, memProtCache));
+
     if (unlikely(loglevel >= DROB_LOGLEVEL_DEBUG))
         passes.emplace_back(new DumpPass(icfg, *binaryPool, cfg, memProtCache));
 
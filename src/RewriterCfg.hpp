@@ -156,6 +156,26 @@ static inline bool ptrToInt(const DynamicValue &ptr, const RewriterCfg &cfg,
     return false;
 }
 
+/*
+ * Check if a pointer is aligned to the given (power of 2) alignment. For
+ * user pointers with unknown values, the alignment follows from the configured
+ * alignment and the offset added via pointer arithmetic.
+ */
+static inline bool isPtrAligned(const DynamicValue &ptr, const RewriterCfg &cfg,
+                                uint16_t align)
+{
+    uint64_t ptrVal;
+
+    if (ptrToInt(ptr, cfg, &ptrVal)) {
+        return !(ptrVal & (align - 1));
+    } else if (ptr.isUsrPtr()) {
+        const UsrPtrCfg &ptrCfg = cfg.getUsrPtrCfg(ptr.getNr());
+
+        return ptrCfg.align >= align && !(ptr.getPtrOffset() & (align - 1));
+    }
+    return false;
+}
+
 } /* namespace drob */
 
 #endif /* REWRITER_CFG_HPP */
@@ -71,6 +71,49 @@ void SuperBlock::removeInstruction(Instruction *instruction)
     drob_assert_not_reached();
 }
 
+void SuperBlock::replaceInstruction(Instruction *instruction,
+                                    std::list<std::unique_ptr<Instruction>> &newInstrs)
+{
+    drob_info("Replacing instruction: %p (%p) in %p (%p)", instruction,
+               instruction->getStartAddr(), this, getStartAddr());
+
+    invalidateLivenessAnalysis();
+    invalidateStackAnalysis();
+
+    cleanupInstruction(instruction);
+
+    auto it = instrs.begin();
+    for (;it != instrs.end(); it++) {
+        auto && instr = *it;
+
+        if (instr.get() == instruction) {
+            instrs.splice(it, newInstrs);
+            instrs.erase(it);
+            return;
+        }
+    }
+    drob_assert_not_reached();
+}
+
+void SuperBlock::insertInstructions(Instruction *instruction,
+                                    std::list<std::unique_ptr<Instruction>> &newInstrs)
+{
+    drob_info("Inserting instructions in front of: %p (%p) in %p (%p)",
+               instruction, instruction->getStartAddr(), this, getStartAddr());
+
+    invalidateLivenessAnalysis();
+    invalidateStackAnalysis();
+
+    auto it = instrs.begin();
+    for (;it != instrs.end(); it++) {
+        if (it->get() == instruction) {
+            instrs.splice(it, newInstrs);
+            return;
+        }
+    }
+    drob_assert_not_reached();
+}
+
 void SuperBlock::removeAllInstructions(void)
 {
     drob_info("Removing all instructions from: %p (%p) ", this, getStartAddr());
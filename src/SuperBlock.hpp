@@ -196,6 +196,18 @@ public:
      */
     void removeInstruction(Instruction *instruction);
 
+    /*
+     * Replace an instruction by a list of instructions, along with edges.
+     */
+    void replaceInstruction(Instruction *instruction,
+                            std::list<std::unique_ptr<Instruction>> &newInstrs);
+
+    /*
+     * Insert a list of instructions in front of the given instruction.
+     */
+    void insertInstructions(Instruction *instruction,
+                            std::list<std::unique_ptr<Instruction>> &newInstrs);
+
     /*
      * Delete all instruction from the block, along with edges.
      */
@@ -276,6 +288,12 @@ public:
     {
         return function;
     }
+
+    /*
+     * Rarely executed according to the profile. Code generation will move
+     * the fallthrough chain starting at this block out of the way.
+     */
+    bool cold{false};
 private:
     friend class Function;
 
@@ -19,6 +19,7 @@
 #include <cstdint>
 #include <list>
 #include <queue>
+#include <vector>
 #include <memory>
 #include "arch_def.h"
 #include "OpcodeInfo.hpp"
@@ -28,6 +29,7 @@ namespace drob {
 class Instruction;
 class BinaryPool;
 class ProgramState;
+class MemProtCache;
 struct CallLocation;
 struct BranchLocation;
 struct OperandInfo;
@@ -69,11 +71,21 @@ struct BranchLocation {
 
 void arch_decode_dump(const uint8_t *start, const uint8_t *end);
 void arch_fill_with_nops(uint8_t *start, int size);
+/*
+ * Will the CPU fuse the instruction with the following conditional branch
+ * into a single operation (macro-fusion)?
+ */
+bool arch_is_macro_fused(const Instruction &instr, const Instruction &branch);
 CallLocation arch_prepare_call(Instruction &instr, BinaryPool &binaryPool);
 void arch_fixup_call(const CallLocation &call, const uint8_t *target, bool write);
 BranchLocation arch_prepare_branch(Instruction &instr, BinaryPool &binaryPool);
+/*
+ * When not writing, remember if a short branch can be used. When verifying a
+ * layout that already uses short branches ("relayout"), only fall back to
+ * long branches if the displacement no longer fits.
+ */
 void arch_fixup_branch(const BranchLocation &branch, const uint8_t *target,
-                       bool write);
+                       bool write, bool relayout);
 const OpcodeInfo *arch_get_opcode_info(Opcode opc);
 const RegisterInfo *arch_get_register_info(Register reg);
 /* get by assigned register id, for debugging purposes only - slow */
@@ -82,6 +94,109 @@ const RegisterInfo *arch_get_register_info(RegisterType type, int nr);
 void arch_translate_cfg(const drob_cfg &drob_cfg, RewriterCfg &cfg);
 Opcode arch_invert_branch(Opcode opcode);
 
+/*
+ * Create instructions that modify the stack just like the given call/ret
+ * instruction, without actually branching. Used for inlining functions.
+ */
+void arch_inline_call(const Instruction &call,
+                      std::list<std::unique_ptr<Instruction>> &instrs);
+void arch_inline_ret(const Instruction &ret,
+                     std::list<std::unique_ptr<Instruction>> &instrs);
+
+/*
+ * Turn an indirect call into a direct call if stack analysis knows the
+ * target. Returns false if not possible.
+ */
+bool arch_devirtualize_call(Instruction &call, const RewriterCfg &cfg);
+
+/*
+ * The instructions between a call and a ret (including the ret) of a
+ * function. Create instructions that perform the same stack cleanup
+ * (e.g. releasing the stack frame, restoring callee-saved registers), so it
+ * can be done before the call, turning it into a tail call. Returns false if
+ * not possible.
+ */
+bool arch_tail_call_epilogue(const std::vector<Instruction *> &epilogue,
+                             std::list<std::unique_ptr<Instruction>> &instrs);
+
+/*
+ * Is the register preserved by called functions according to the ABI?
+ */
+bool arch_is_callee_saved(Register reg);
+
+/*
+ * Create an instruction that copies the complete content of one register
+ * into another one, without modifying anything else. Returns nullptr if not
+ * supported for the given registers.
+ */
+std::unique_ptr<Instruction> arch_copy_register(Register dst, Register src);
+
+/*
+ * Convert a plain load/store of a complete memory location (e.g. a stack slot)
+ * into a load/store of the given register, which will hold the content of
+ * the memory location instead. Returns false if not supported.
+ */
+bool arch_promote_mem_access(Opcode &opcode, ExplicitStaticOperands &operands,
+                             Register reg);
+
+/*
+ * Convert an instruction that writes memory into one that has the same effect
+ * on registers, but doesn't write memory (e.g. a PUSH into a stack pointer
+ * adjustment). Returns false if not supported.
+ */
+bool arch_remove_mem_write(Opcode &opcode, ExplicitStaticOperands &operands);
+
+/*
+ * Detect instructions used for setting up and tearing down a frame pointer:
+ * saving a register on the stack, restoring it from the stack and copying
+ * one register into another one.
+ */
+bool arch_is_push_register(const Instruction &instr, Register reg);
+bool arch_is_pop_register(const Instruction &instr, Register reg);
+bool arch_is_copy_register(const Instruction &instr, Register dst, Register src);
+
+/*
+ * Try to match an instruction (given via opcode and operands) and its
+ * predecessor in the same block (if any) against the peephole patterns.
+ * Modifies the opcode and operands or indicates that the instruction can be
+ * dropped.
+ */
+SpecRet arch_peephole(const Instruction *prev, Opcode &opcode,
+                      ExplicitStaticOperands &operands,
+                      const LivenessData &livenessData);
+
+/*
+ * Try to replace an expensive instruction (e.g. multiplication or division by
+ * a known constant) by a sequence of cheaper instructions. The replacement
+ * might clobber eflags or registers that are dead after the instruction.
+ * Returns false if not possible.
+ */
+bool arch_strength_reduce(Opcode opcode, const ExplicitStaticOperands &operands,
+                          const DynamicInstructionInfo &dynInfo,
+                          const LivenessData &livenessData,
+                          const RewriterCfg &cfg, BinaryPool &binaryPool,
+                          std::list<std::unique_ptr<Instruction>> &instrs);
+
+/*
+ * Try to pack isomorphic scalar operations starting at the given index into
+ * packed (SIMD) operations. Returns the number of instructions that have to be
+ * replaced by the packed instructions or 0 if not possible.
+ */
+unsigned int arch_slp_vectorize(const std::vector<Instruction *> &instrs,
+                                unsigned int start,
+                                std::list<std::unique_ptr<Instruction>> &packed);
+
+/*
+ * Try to resolve the indirect branch at the end of the given block, if it
+ * branches via a jump table in constant memory with an index bounded in the
+ * same block. The branch can then be replaced by the created direct branches
+ * to all targets. Returns false if not possible.
+ */
+bool arch_lower_jump_table(const std::list<std::unique_ptr<Instruction>> &blockInstrs,
+                           const MemProtCache &memProtCache,
+                           const RewriterCfg &cfg,
+                           std::list<std::unique_ptr<Instruction>> &instrs);
+
 } /* namespace drob */
 
 #endif /* ARCH_HPP */
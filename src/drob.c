@@ -352,6 +352,33 @@ int drob_cfg_add_const_range(drob_cfg *cfg, void *start, unsigned long size)
     return 0;
 }
 
+int drob_cfg_add_branch_profile(drob_cfg *cfg, const void *branch,
+                                unsigned long long taken,
+                                unsigned long long not_taken)
+{
+    drob_branch_cfg *tmp;
+
+    if (cfg->branches) {
+        tmp = realloc(cfg->branches,
+                      (cfg->branch_count + 1) * sizeof(*cfg->branches));
+        if (!tmp) {
+            return -ENOMEM;
+        }
+        cfg->branches = tmp;
+        cfg->branch_count++;
+    } else {
+        cfg->branches = malloc(sizeof(*cfg->branches));
+        if (!cfg->branches) {
+            return -ENOMEM;
+        }
+        cfg->branch_count = 1;
+    }
+    cfg->branches[cfg->branch_count - 1].branch = branch;
+    cfg->branches[cfg->branch_count - 1].taken = taken;
+    cfg->branches[cfg->branch_count - 1].not_taken = not_taken;
+    return 0;
+}
+
 void drob_cfg_fail_on_unmodelled(drob_cfg *cfg, bool fail)
 {
     cfg->fail_on_unmodelled = fail;
@@ -362,6 +389,15 @@ void drob_cfg_set_simple_loop_unroll_count(drob_cfg *cfg, uint16_t count)
     cfg->simple_loop_unroll_count = count;
 }
 
+void drob_cfg_set_code_align(drob_cfg *cfg, drob_code_align align)
+{
+    cfg->code_align = align;
+}
+
+void drob_cfg_mitigate_jcc_erratum(drob_cfg *cfg, bool mitigate)
+{
+    cfg->mitigate_jcc_erratum = mitigate;
+}
 
 void drob_cfg_set_error_handling(drob_cfg *cfg, drob_error_handling handling)
 {
@@ -379,6 +415,9 @@ void drob_cfg_free(drob_cfg *cfg)
     if (cfg->ranges) {
         free(cfg->ranges);
     }
+    if (cfg->branches) {
+        free(cfg->branches);
+    }
     free(cfg);
 }
 
@@ -387,6 +426,11 @@ void drob_free(drob_f func)
     drobcpp_free((const uint8_t *)func);
 }
 
+void drob_invalidate(drob_f func)
+{
+    drobcpp_invalidate((const uint8_t *)func);
+}
+
 drob_f drob_optimize(drob_f func, const drob_cfg *cfg)
 {
     const uint8_t *ftext = (const uint8_t *)func;
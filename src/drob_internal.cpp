@@ -19,6 +19,7 @@
 #include "drob_internal.h"
 #include "Rewriter.hpp"
 #include "Registry.hpp"
+#include "DecodeCache.hpp"
 #include "arch.hpp"
 
 namespace drob {
@@ -34,6 +35,7 @@ int drobcpp_setup(void)
 void drobcpp_teardown(void)
 {
     Registry::instance().deleteAllFunctions();
+    DecodeCache::instance().invalidateAllFunctions();
 
     arch_teardown();
 }
@@ -87,4 +89,13 @@ void drobcpp_free(const uint8_t *itext)
     Registry::instance().deleteFunction(itext);
 }
 
+void drobcpp_invalidate(const uint8_t *itext)
+{
+    if (!itext) {
+        DecodeCache::instance().invalidateAllFunctions();
+    } else {
+        DecodeCache::instance().invalidateFunction(itext);
+    }
+}
+
 } /* namespace drob */
@@ -96,6 +96,12 @@ typedef struct drob_mem_cfg {
     unsigned long size;
 } drob_mem_cfg;
 
+typedef struct drob_branch_cfg {
+    const void *branch;
+    unsigned long long taken;
+    unsigned long long not_taken;
+} drob_branch_cfg;
+
 typedef struct drob_cfg {
     /* the return type of the function */
     drob_param_type ret_type;
@@ -107,16 +113,23 @@ typedef struct drob_cfg {
     int range_count;
     /* information about memory ranges (e.g. constant) */
     drob_mem_cfg *ranges;
+    /* the number of branch profiles */
+    int branch_count;
+    /* profile information about conditional branches */
+    drob_branch_cfg *branches;
     /* rewriting options */
     bool fail_on_unmodelled;
     drob_error_handling error_handling;
     uint16_t simple_loop_unroll_count;
+    drob_code_align code_align;
+    bool mitigate_jcc_erratum;
 } drob_cfg;
 
 int drobcpp_setup(void);
 void drobcpp_teardown(void);
 const uint8_t *drobcpp_optimize(const uint8_t *ftext, const drob_cfg *cfg);
 void drobcpp_free(const uint8_t *ftext);
+void drobcpp_invalidate(const uint8_t *ftext);
 
 #ifdef __cplusplus
 }
@@ -16,7 +16,9 @@
 #ifndef PASSES_CODE_GENERATION_PASS_HPP
 #define PASSES_CODE_GENERATION_PASS_HPP
 
+#include <unordered_set>
 #include "../Pass.hpp"
+#include "../LoopInfo.hpp"
 
 namespace drob {
 
@@ -29,8 +31,24 @@ public:
     int handleInstruction(Instruction *instruction, SuperBlock *block,
                   Function *function)
     {
+        const uint8_t *start = binaryPool.nextCode();
+
         (void)block;
         (void)function;
+        generateInstruction(instruction);
+
+        if (unlikely(cfg.getDrobCfg().mitigate_jcc_erratum) &&
+            (instruction->isBranch() || instruction->isCall() ||
+             instruction->isRet())) {
+            alignBranch(instruction, start);
+        }
+        prevInstr = instruction;
+        prevStart = start;
+        return 0;
+    }
+
+    void generateInstruction(Instruction *instruction)
+    {
         if (instruction->isBranch()) {
             auto &edge = instruction->getBranchEdge();
 
@@ -39,12 +57,11 @@ public:
 
                 /* see if we already know the branch target */
                 if (blockMap.find(edge->dst) != blockMap.end()) {
-                    arch_fixup_branch(branch, blockMap.find(edge->dst)->second,
-                                      write);
+                    fixupBranch(branch, blockMap.find(edge->dst)->second);
                 } else {
                     branches.push_back(branch);
                 }
-                return 0;
+                return;
             }
         } else if (instruction->isCall()) {
            auto &edge = instruction->getCallEdge();
@@ -53,22 +70,101 @@ public:
                 CallLocation call = arch_prepare_call(*instruction, binaryPool);
 
                 calls.push_back(call);
-                return 0;
+                return;
             }
         }
 
         drob_assert(!instruction->isRet() || instruction->getReturnEdge());
 
         instruction->generateCode(binaryPool,  write);
-        return 0;
+    }
+
+    void fixupBranch(const BranchLocation &branch, const uint8_t *target)
+    {
+        const bool wasShort = branch.instr->getUseShortBranch();
+
+        arch_fixup_branch(branch, target, write, relayout);
+        if (wasShort != branch.instr->getUseShortBranch()) {
+            layoutChanged = true;
+        }
+    }
+
+    /*
+     * Branches (including macro-fused pairs) must not cross or end on a
+     * branch boundary, otherwise CPUs affected by the JCC erratum cannot
+     * serve them from the decoded instruction cache. Generate them again
+     * behind the boundary.
+     */
+    void alignBranch(Instruction *instruction, const uint8_t *start)
+    {
+        const bool fused = prevInstr && arch_is_macro_fused(*prevInstr, *instruction);
+        const uint8_t *end = binaryPool.nextCode();
+
+        if (fused) {
+            start = prevStart;
+        }
+        if (ALIGN_DOWN(start, ARCH_BRANCH_BOUNDARY) ==
+            ALIGN_DOWN(end, ARCH_BRANCH_BOUNDARY)) {
+            return;
+        }
+        if (!binaryPool.rewindCode(start)) {
+            return;
+        }
+
+        /* Forget about the branch we generated */
+        if (!branches.empty() && branches.back().instr == instruction) {
+            branches.pop_back();
+        } else if (!calls.empty() && calls.back().instr == instruction) {
+            calls.pop_back();
+        }
+        if (!write && !relayout) {
+            /* The displacement will change, calculate it again */
+            instruction->setUseShortBranch(false);
+        }
+
+        binaryPool.alignCode(ARCH_BRANCH_BOUNDARY, write);
+        if (fused) {
+            generateInstruction(prevInstr);
+        }
+        generateInstruction(instruction);
     }
 
     int handleBlock(SuperBlock *block, Function *function)
     {
+        SuperBlock *head = block;
+
+        /* Cold chains are placed behind all hot code */
+        while (head->getPrev()) {
+            head = head->getPrev();
+        }
+        if (unlikely(head->cold)) {
+            coldBlocks.emplace_back(block, function);
+            return 0;
+        }
+        return generateBlock(block, function);
+    }
+
+    int generateBlock(SuperBlock *block, Function *function)
+    {
+        bool align;
+
         drob_debug("Block at [%p - %p]", block->getStartAddr(),
                block->getEndAddr());
 
-        blockMap.insert(std::make_pair(block, binaryPool.newBlock(write)));
+        switch (cfg.getDrobCfg().code_align) {
+        case DROB_CODE_ALIGN_LOOPS:
+            align = loopHeaders.count(block);
+            break;
+        case DROB_CODE_ALIGN_NONE:
+            align = false;
+            break;
+        case DROB_CODE_ALIGN_BLOCKS:
+        default:
+            align = true;
+            break;
+        }
+        blockMap.insert(std::make_pair(block, binaryPool.newBlock(write, align)));
+        prevInstr = nullptr;
         drob_assert(!block->getInstructions().empty() && "Empty block");
         block->for_each_instruction(this, function);
         return 0;
@@ -79,20 +175,17 @@ public:
         drob_debug("Function at [%p]", function->getStartAddr());
         drob_assert(function->getEntryBlock() && "Empty function");
 
-        /* Walk all blocks starting with the entry */
-        functionMap.insert(std::make_pair(function, binaryPool.newBlock(write)));
-        function->for_each_block_dfs(this);
+        if (cfg.getDrobCfg().code_align == DROB_CODE_ALIGN_LOOPS) {
+            LoopInfo loopInfo(function);
 
-        /* fixup all branches */
-        for (auto && branch : branches) {
-            auto &edge = branch.instr->getBranchEdge();
-
-            drob_assert(blockMap.find(edge->dst) != blockMap.end());
-            const uint8_t *itext = blockMap.find(edge->dst)->second;
-            arch_fixup_branch(branch, itext, write);
+            for (auto & loop : loopInfo.getLoops()) {
+                loopHeaders.insert(loop->header);
+            }
         }
-        branches.clear();
 
+        /* Walk all blocks starting with the entry */
+        functionMap.insert(std::make_pair(function, binaryPool.newBlock(write)));
+        function->for_each_block_dfs(this);
         return 0;
     }
 
@@ -104,6 +197,22 @@ public:
         /* Walk all functions starting with the entry */
         icfg.for_each_function_dfs(this);
 
+        /* Generate all cold blocks, keeping the fallthrough chains intact */
+        for (auto && pair : coldBlocks) {
+            generateBlock(pair.first, pair.second);
+        }
+        coldBlocks.clear();
+
+        /* Fixup all branches */
+        for (auto && branch : branches) {
+            auto &edge = branch.instr->getBranchEdge();
+
+            drob_assert(blockMap.find(edge->dst) != blockMap.end());
+            const uint8_t *itext = blockMap.find(edge->dst)->second;
+            fixupBranch(branch, itext);
+        }
+        branches.clear();
+
         /* Fixup all calls */
         for (auto && call : calls) {
             auto &edge = call.instr->getCallEdge();
@@ -116,8 +225,21 @@ public:
 
         functionMap.clear();
         blockMap.clear();
+        loopHeaders.clear();
 
         if (!write) {
+            /*
+             * Padding branches depends on the layout: using short branches
+             * might move branches across a boundary, growing displacements
+             * again. Repeat the sizing run with the short branches, until
+             * no short branch has to be dropped anymore.
+             */
+            if (cfg.getDrobCfg().mitigate_jcc_erratum &&
+                (!relayout || layoutChanged)) {
+                relayout = true;
+                layoutChanged = false;
+                return true;
+            }
             /* write on the next run */
             write = true;
             return true;
@@ -128,8 +250,12 @@ public:
     void reset(void)
     {
         write = false;
+        relayout = false;
+        layoutChanged = false;
         functionMap.clear();
         blockMap.clear();
+        coldBlocks.clear();
+        loopHeaders.clear();
     }
 
 private:
@@ -141,9 +267,20 @@ private:
      * calcualted information.
      */
     bool write{false};
+    /*
+     * Sizing runs with the short branches of the previous run, to detect
+     * short branches that no longer fit due to branch padding.
+     */
+    bool relayout{false};
+    bool layoutChanged{false};
     std::unordered_map<const Function*, const uint8_t *> functionMap;
     std::unordered_map<const SuperBlock *, const uint8_t *> blockMap;
     std::vector<BranchLocation> branches;
+    std::vector<std::pair<SuperBlock *, Function *>> coldBlocks;
+    std::unordered_set<const SuperBlock *> loopHeaders;
+    /* The previous instruction in the current block, for macro-fusion */
+    Instruction *prevInstr{nullptr};
+    const uint8_t *prevStart{nullptr};
     std::vector<CallLocation> calls;
 };
 
@@ -57,6 +57,8 @@ public:
      */
     bool run(void)
     {
+        bool rerun;
+
         /* collect functions, blocks and instructions that are unreachable */
         icfg.for_each_function_any(this);
 
@@ -93,13 +95,17 @@ public:
         }
         blocksToDelete.resize(0);
 
-        /* Remove all functions */
+        /*
+         * Remove all functions. Functions only called by removed functions
+         * are no longer called, remove them in the next run.
+         */
+        rerun = !functionsToDelete.empty();
         for (auto &f : functionsToDelete) {
             icfg.removeFunction(f);
         }
         functionsToDelete.resize(0);
 
-        return false;
+        return rerun;
     }
 
     bool needsStackAnalysis(void)
@@ -110,13 +116,14 @@ public:
 
     int handleFunction(Function *function)
     {
-        /* FIXME: analyze all functions. For now we have to skip these */
-        if (!function->getEntryBlock()->getEntryState()) {
+        /* Functions that are no longer called (e.g. inlined) */
+        if (function != icfg.getEntryFunction() &&
+            function->getIncomingEdges().empty()) {
+            functionsToDelete.push_back(function);
             return 0;
         }
-        /* No state attached during stack analysis -> unreachable */
+        /* Not all called functions can be analyzed. We have to skip these */
         if (!function->getEntryBlock()->getEntryState()) {
-            functionsToDelete.push_back(function);
             return 0;
         }
         function->for_each_block_any(this);
@@ -0,0 +1,412 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef PASSES_DEAD_STACK_STORE_ELIMINATION_PASS_HPP
+#define PASSES_DEAD_STACK_STORE_ELIMINATION_PASS_HPP
+
+#include <vector>
+#include <unordered_map>
+#include "../Utils.hpp"
+#include "../Pass.hpp"
+#include "../NodeCallback.hpp"
+#include "../Instruction.hpp"
+#include "../arch.hpp"
+
+namespace drob {
+
+/*
+ * Remove stores to the stack frame of the entry function that are never read
+ * before being overwritten or before returning.
+ *
+ * Memory liveness is computed per byte of the own stack frame (negative
+ * offsets relative to the stack pointer on entry), based on the targets of
+ * memory accesses as computed by stack analysis. Just like for stack slot
+ * promotion, this is only possible if no stack pointer can escape (no
+ * tainted pointers, no calls, no nasty instructions).
+ *
+ * Dead pushes are converted into stack pointer adjustments. If the stack is
+ * not accessed at all anymore, all stack pointer adjustments (e.g. a
+ * "sub rsp, X" frame setup) are dropped.
+ */
+class DeadStackStoreEliminationPass : public Pass, public NodeCallback {
+public:
+    DeadStackStoreEliminationPass(ICFG &icfg, BinaryPool &binaryPool,
+                                  const RewriterCfg &cfg,
+                                  const MemProtCache &memProtCache) :
+        Pass(icfg, binaryPool, cfg, memProtCache, "DeadStackStoreElimination",
+             "Remove dead stores to the stack")
+    {
+    }
+
+    bool needsStackAnalysis(void)
+    {
+        /* We need the targets of all memory accesses */
+        return true;
+    }
+
+    bool needsLivenessAnalysis(void)
+    {
+        /* We need to know if register outputs are alive */
+        return true;
+    }
+
+    typedef struct StackAccess {
+        int64_t offset;
+        uint8_t size;
+        /* the complete range is definitely written */
+        bool write;
+        /* the range might be written (e.g. conditionally) */
+        bool mayWrite;
+        /* the range might be read */
+        bool read;
+    } StackAccess;
+
+    typedef std::vector<bool> LiveBytes;
+
+    int handleInstruction(Instruction *instruction, SuperBlock *block,
+                          Function *function)
+    {
+        const DynamicInstructionInfo *dynInfo = instruction->getDynInfo();
+        std::vector<StackAccess> &instrAccesses = accesses[instruction];
+        (void)block;
+        (void)function;
+
+        if (instruction->getInfo().nasty || instruction->isCall() ||
+            (instruction->isBranch() && !instruction->getBranchEdge())) {
+            return -1;
+        }
+        if (!dynInfo) {
+            /* Instructions without liveness data are dead and will be dropped */
+            return instruction->getLivenessData() ? -1 : 0;
+        }
+
+        for (auto & operand : dynInfo->operands) {
+            const DynamicValue &ptr = operand.memAcc.ptrVal;
+            StackAccess access;
+
+            if (operand.type != OperandType::MemPtr ||
+                operand.memAcc.mode == AccessMode::None ||
+                operand.memAcc.mode == AccessMode::Address) {
+                continue;
+            }
+            if (ptr.isTainted()) {
+                return -1;
+            } else if (!ptr.isStackPtr()) {
+                continue;
+            } else if (operand.memAcc.size == MemAccessSize::Unknown) {
+                return -1;
+            }
+
+            access.offset = ptr.getPtrOffset();
+            access.size = static_cast<uint8_t>(operand.memAcc.size);
+            access.write = operand.memAcc.mode == AccessMode::Write;
+            access.mayWrite = !access.write && isWrite(operand.memAcc.mode);
+            access.read = operand.memAcc.mode != AccessMode::Write &&
+                          operand.memAcc.mode != AccessMode::MayWrite;
+            instrAccesses.push_back(access);
+
+            frameSize = std::max(frameSize, -access.offset);
+        }
+        return 0;
+    }
+
+    void setRange(LiveBytes &live, int64_t offset, uint8_t size, bool val)
+    {
+        for (int64_t i = offset; i < offset + size; i++) {
+            /* Only the own stack frame is tracked */
+            if (i < 0 && i >= -frameSize) {
+                live[i + frameSize] = val;
+            }
+        }
+    }
+
+    bool isRangeDead(const LiveBytes &live, int64_t offset, uint8_t size)
+    {
+        /* Everything outside of the own stack frame is alive */
+        if (offset + size > 0) {
+            return false;
+        }
+        for (int64_t i = offset; i < offset + size; i++) {
+            if (live[i + frameSize]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /*
+     * Check if all stores of the instruction are dead and the instruction
+     * has no other effects.
+     */
+    bool isDeadStore(Instruction *instruction, const LiveBytes &live)
+    {
+        const InstructionInfo &info = instruction->getInfo();
+        bool stores = false;
+
+        if (instruction->getPredicate() || instruction->isRet() ||
+            instruction->isBranch() || !info.mayWriteMem) {
+            return false;
+        }
+        for (auto & access : accesses[instruction]) {
+            /* We don't know which bytes will be written, they might be alive */
+            if (access.mayWrite) {
+                return false;
+            }
+            if (access.write && !isRangeDead(live, access.offset, access.size)) {
+                return false;
+            }
+            stores |= access.write;
+        }
+        return stores;
+    }
+
+    LiveBytes getLiveIn(SuperBlock *block)
+    {
+        auto it = liveIn.find(block);
+
+        /* Be conservative when leaving the function */
+        if (it == liveIn.end()) {
+            return LiveBytes(frameSize, true);
+        }
+        return it->second;
+    }
+
+    /*
+     * Walk a block backwards, computing the live bytes on entry. Optionally
+     * remember all dead stores.
+     */
+    LiveBytes processBlock(SuperBlock *block, bool collect)
+    {
+        LiveBytes live(frameSize, false);
+
+        if (block->getNext()) {
+            live = getLiveIn(block->getNext());
+        }
+
+        const auto &instrs = block->getInstructions();
+        for (auto it = instrs.rbegin(); it != instrs.rend(); it++) {
+            Instruction *instr = it->get();
+
+            if (instr->isBranch()) {
+                const LiveBytes dst = getLiveIn(instr->getBranchEdge()->dst);
+
+                if (instr->getPredicate()) {
+                    for (int64_t i = 0; i < frameSize; i++) {
+                        live[i] = live[i] || dst[i];
+                    }
+                } else {
+                    live = dst;
+                }
+                continue;
+            } else if (instr->isRet()) {
+                /* The own stack frame is dead once we return */
+                live.assign(frameSize, false);
+                continue;
+            }
+
+            if (collect && isDeadStore(instr, live)) {
+                deadStores.emplace_back(block, instr);
+            }
+            for (auto & access : accesses[instr]) {
+                if (access.write) {
+                    setRange(live, access.offset, access.size, false);
+                }
+            }
+            for (auto & access : accesses[instr]) {
+                if (access.read) {
+                    setRange(live, access.offset, access.size, true);
+                }
+            }
+        }
+        return live;
+    }
+
+    int handleBlock(SuperBlock *block, Function *function)
+    {
+        (void)function;
+        blocks.push_back(block);
+        liveIn[block] = LiveBytes(frameSize, false);
+        return 0;
+    }
+
+    /*
+     * Is this instruction only adjusting the stack pointer (e.g. "sub rsp, X")?
+     */
+    bool isStackAdjustment(Instruction *instruction)
+    {
+        const InstructionInfo &info = instruction->getInfo();
+        const LivenessData *livenessData = instruction->getLivenessData();
+        const SubRegisterMask &rsp = arch_get_register_info(Register::RSP)->full;
+        SubRegisterMask reads = info.readRegs;
+        SubRegisterMask writes = info.writtenRegs;
+
+        if (!livenessData || instruction->getPredicate() || info.mayWriteMem ||
+            instruction->isRet() || instruction->isBranch() ||
+            !accesses[instruction].empty()) {
+            return false;
+        }
+        reads += info.predicateRegs;
+        reads -= rsp;
+        writes += info.condWrittenRegs;
+        writes -= rsp;
+        return !reads && !(writes & livenessData->live_out) &&
+               !!(info.writtenRegs & rsp);
+    }
+
+    /*
+     * If the stack is not accessed anymore (besides returning), drop all
+     * stack pointer adjustments.
+     */
+    bool dropStackAdjustments(void)
+    {
+        const SubRegisterMask &rsp = arch_get_register_info(Register::RSP)->full;
+        std::vector<std::pair<SuperBlock *, Instruction *>> adjustments;
+
+        for (auto & block : blocks) {
+            for (auto & instr : block->getInstructions()) {
+                const DynamicInstructionInfo *dynInfo = instr->getDynInfo();
+                SubRegisterMask reads = instr->getInfo().readRegs;
+
+                reads += instr->getInfo().predicateRegs;
+                if (instr->isRet()) {
+                    if (!dynInfo) {
+                        return false;
+                    }
+                    /* We must return with the original stack pointer */
+                    for (auto & operand : dynInfo->operands) {
+                        if (operand.type == OperandType::Register &&
+                            operand.regAcc.reg == Register::RSP &&
+                            (!operand.input.isStackPtr() ||
+                             operand.input.getPtrOffset() != 0)) {
+                            return false;
+                        }
+                    }
+                } else if (isStackAdjustment(instr.get())) {
+                    adjustments.emplace_back(block, instr.get());
+                } else if (!accesses[instr.get()].empty() || !!(reads & rsp)) {
+                    return false;
+                }
+            }
+        }
+
+        for (auto & adjustment : adjustments) {
+            drob_info("Dropping stack pointer adjustment %p (%p)", adjustment.second,
+                      adjustment.second->getStartAddr());
+            adjustment.first->removeInstruction(adjustment.second);
+        }
+        return !adjustments.empty();
+    }
+
+    bool run(void)
+    {
+        Function *function = icfg.getEntryFunction();
+        bool changed = true;
+        bool ret = false;
+
+        if (!function) {
+            return false;
+        }
+
+        frameSize = 0;
+        if (function->for_each_instruction_any(this)) {
+            drob_info("Stack of function %p (%p) might escape", function,
+                      function->getStartAddr());
+            cleanup();
+            return false;
+        }
+        function->for_each_block_any(this);
+
+        /* Compute the live bytes on entry of all blocks */
+        while (changed) {
+            changed = false;
+            for (auto & block : blocks) {
+                LiveBytes live = processBlock(block, false);
+
+                if (live != liveIn[block]) {
+                    liveIn[block] = std::move(live);
+                    changed = true;
+                }
+            }
+        }
+
+        for (auto & block : blocks) {
+            processBlock(block, true);
+        }
+
+        for (auto & deadStore : deadStores) {
+            SuperBlock *block = deadStore.first;
+            Instruction *instr = deadStore.second;
+            const InstructionInfo &info = instr->getInfo();
+            SubRegisterMask writes = info.writtenRegs;
+
+            writes += info.condWrittenRegs;
+            if (!instr->getLivenessData() || !(writes & instr->getLivenessData()->live_out)) {
+                drob_info("Dropping dead stack store %p (%p)", instr,
+                          instr->getStartAddr());
+                block->removeInstruction(instr);
+                ret = true;
+                continue;
+            }
+
+            /* Other outputs are still alive, try to only drop the store */
+            Opcode opcode = instr->getOpcode();
+            ExplicitStaticOperands operands = instr->getOperands();
+            if (!arch_remove_mem_write(opcode, operands)) {
+                continue;
+            }
+            drob_info("Dropping dead stack store of %p (%p)", instr,
+                      instr->getStartAddr());
+            instr->setOpcode(opcode);
+            for (int i = 0; i < instr->getNumOperands(); i++) {
+                instr->setOperand(i, operands.op[i]);
+            }
+            block->invalidateLivenessAnalysis();
+            block->invalidateStackAnalysis();
+            ret = true;
+        }
+
+        /* Once all dead stores are gone, we might be able to drop the frame */
+        if (!ret) {
+            ret = dropStackAdjustments();
+        }
+        cleanup();
+
+        /* Rerun with updated analysis data */
+        return ret;
+    }
+private:
+    void cleanup(void)
+    {
+        accesses.clear();
+        blocks.clear();
+        liveIn.clear();
+        deadStores.clear();
+    }
+
+    /* size of the tracked stack frame */
+    int64_t frameSize{0};
+    /* stack accesses per instruction */
+    std::unordered_map<Instruction *, std::vector<StackAccess>> accesses;
+    /* all blocks of the function */
+    std::vector<SuperBlock *> blocks;
+    /* live bytes on entry of each block */
+    std::unordered_map<SuperBlock *, LiveBytes> liveIn;
+    /* dead stores we found */
+    std::vector<std::pair<SuperBlock *, Instruction *>> deadStores;
+};
+
+} /* namespace drob */
+
+#endif /* PASSES_DEAD_STACK_STORE_ELIMINATION_PASS_HPP */
@@ -40,22 +40,28 @@ public:
 
     bool run(void)
     {
-        /* TODO: analyze all functions. */
-        if (!icfg.getEntryFunction())
-            return false;
-        icfg.getEntryFunction()->for_each_instruction_any(this);
+        icfg.for_each_function_any(this);
 
         /* Remove all instruction */
         for (auto &i : instructionsToDelete) {
             i.second->removeInstruction(i.first);
             icfg.livenessAnalysisValid  = false;
-            icfg.getEntryFunction()->livenessAnalysisValid  = false;
+            i.second->getFunction()->livenessAnalysisValid  = false;
             i.second->livenessAnalysisValid = false;
         }
         instructionsToDelete.resize(0);
         return false;
     }
 
+    int handleFunction(Function *function)
+    {
+        /* We might only have data for some functions */
+        if (unlikely(!function->livenessAnalysisValid))
+            return 0;
+        function->for_each_instruction_any(this);
+        return 0;
+    }
+
     bool needsLivenessAnalysis(void)
     {
         /* We need a valid liveness analysis to identify instructions to remove */
@@ -0,0 +1,118 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef PASSES_DEVIRTUALIZATION_PASS_HPP
+#define PASSES_DEVIRTUALIZATION_PASS_HPP
+
+#include <stack>
+#include <unordered_map>
+#include <vector>
+#include "../Utils.hpp"
+#include "../Pass.hpp"
+#include "../NodeCallback.hpp"
+#include "../Instruction.hpp"
+#include "../arch.hpp"
+#include "ICFGReconstructionPass.hpp"
+
+namespace drob {
+
+/*
+ * Indirect calls (e.g. via function pointer parameters or vtables in constant
+ * memory) whose target is known after stack analysis are converted into
+ * direct calls. The called functions are decoded, so they can be optimized
+ * and inlined like any other called function.
+ */
+class DevirtualizationPass : public Pass, public NodeCallback {
+public:
+    DevirtualizationPass(ICFG &icfg, BinaryPool &binaryPool,
+                         const RewriterCfg &cfg,
+                         const MemProtCache &memProtCache) :
+        Pass(icfg, binaryPool, cfg, memProtCache, "Devirtualization",
+             "Convert indirect calls to known targets into direct calls") {}
+
+    bool needsStackAnalysis(void)
+    {
+        /* We need the values of registers and memory operands */
+        return true;
+    }
+
+    bool run(void)
+    {
+        ICFGReconstructionPass reconstruction(icfg, binaryPool, cfg,
+                                              memProtCache);
+        std::stack<Function *> resolveStack;
+        bool changed;
+
+        icfg.for_each_function_any(this);
+        changed = !functionsToResolve.empty();
+
+        /*
+         * Wire up the new call edges. Already decoded functions are reused,
+         * except the entry function (see ICFG reconstruction).
+         */
+        for (auto &function : functionsToResolve) {
+            resolveStack.push(function);
+        }
+        reconstruction.resolveCallEdges(resolveStack, knownFunctions);
+        functionsToResolve.clear();
+        knownFunctions.clear();
+
+        /* Calls in the new functions might now be resolvable */
+        return changed;
+    }
+
+    int handleFunction(Function *function)
+    {
+        if (function != icfg.getEntryFunction()) {
+            knownFunctions.emplace(function->getStartAddr(), function);
+        }
+        if (unlikely(!function->stackAnalysisValid)) {
+            return 0;
+        }
+        curFunctionChanged = false;
+        function->for_each_instruction_any(this);
+        if (curFunctionChanged) {
+            functionsToResolve.push_back(function);
+        }
+        return 0;
+    }
+
+    int handleInstruction(Instruction *instruction, SuperBlock *block,
+                          Function *function)
+    {
+        (void)function;
+
+        if (!instruction->isCall() || instruction->getCallEdge() ||
+            !arch_devirtualize_call(*instruction, cfg)) {
+            return 0;
+        }
+
+        drob_info("Devirtualized call %p (%p) to %p", instruction,
+                  instruction->getStartAddr(),
+                  instruction->getRawTarget(memProtCache));
+        block->invalidateStackAnalysis();
+        block->invalidateLivenessAnalysis();
+        curFunctionChanged = true;
+        return 0;
+    }
+private:
+    std::unordered_map<const uint8_t *, Function *> knownFunctions;
+    std::vector<Function *> functionsToResolve;
+    bool curFunctionChanged;
+};
+
+} /* namespace drob */
+
+#endif /* PASSES_DEVIRTUALIZATION_PASS_HPP */
@@ -0,0 +1,409 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef PASSES_FRAME_POINTER_ELIMINATION_PASS_HPP
+#define PASSES_FRAME_POINTER_ELIMINATION_PASS_HPP
+
+#include <vector>
+#include "../Utils.hpp"
+#include "../Pass.hpp"
+#include "../NodeCallback.hpp"
+#include "../Instruction.hpp"
+#include "../arch.hpp"
+
+namespace drob {
+
+/*
+ * Drop the frame pointer of the entry function, e.g. for code compiled with
+ * -fno-omit-frame-pointer:
+ *
+ *     push rbp
+ *     mov rbp, rsp
+ *     ...
+ *     pop rbp
+ *     ret
+ *
+ * First, all memory operands based on the frame pointer are rebased to the
+ * stack pointer. If the frame pointer is then no longer used, the
+ * prologue/epilogue is dropped. The remaining stack frame moves up into the
+ * now unused slot of the saved frame pointer; accesses to the caller's
+ * frame (e.g. stack arguments) are fixed up.
+ *
+ * Just like for stack slot promotion, this is only possible if no stack
+ * pointer can escape (no tainted pointers, no calls, no nasty instructions).
+ */
+class FramePointerEliminationPass : public Pass, public NodeCallback {
+public:
+    FramePointerEliminationPass(ICFG &icfg, BinaryPool &binaryPool,
+                                const RewriterCfg &cfg,
+                                const MemProtCache &memProtCache) :
+        Pass(icfg, binaryPool, cfg, memProtCache, "FramePointerElimination",
+             "Drop frame pointer setup and teardown")
+    {
+    }
+
+    bool needsStackAnalysis(void)
+    {
+        /* We need the targets of all memory accesses */
+        return true;
+    }
+
+    bool needsLivenessAnalysis(void)
+    {
+        /* Only to identify dead instructions that have no stack data */
+        return true;
+    }
+
+    typedef struct StackOperand {
+        Instruction *instruction;
+        SuperBlock *block;
+        /* explicit operand number */
+        int nr;
+        int64_t offset;
+        uint8_t size;
+    } StackOperand;
+
+    int handleInstruction(Instruction *instruction, SuperBlock *block,
+                          Function *function)
+    {
+        const InstructionInfo &info = instruction->getInfo();
+        const DynamicInstructionInfo *dynInfo = instruction->getDynInfo();
+        SubRegisterMask used = info.readRegs;
+        (void)function;
+
+        if (info.nasty || instruction->isCall() ||
+            (instruction->isBranch() && !instruction->getBranchEdge())) {
+            return -1;
+        }
+        if (!dynInfo) {
+            /* Instructions without liveness data are dead and will be dropped */
+            return instruction->getLivenessData() ? -1 : 0;
+        }
+
+        if (arch_is_push_register(*instruction, Register::RBP)) {
+            saves.emplace_back(block, instruction);
+        } else if (arch_is_pop_register(*instruction, Register::RBP)) {
+            restores.emplace_back(block, instruction);
+        } else if (arch_is_copy_register(*instruction, Register::RBP,
+                                         Register::RSP)) {
+            setups.emplace_back(block, instruction);
+        } else {
+            used += info.predicateRegs;
+            used += info.writtenRegs;
+            used += info.condWrittenRegs;
+            if (!!(used & rbp)) {
+                fpUsed = true;
+            }
+        }
+
+        for (auto & operand : dynInfo->operands) {
+            if (operand.type == OperandType::Register) {
+                /* Stack pointers must not leave rsp/rbp */
+                if (operand.isOutput && operand.output.isStackPtr() &&
+                    operand.regAcc.reg != Register::RSP &&
+                    operand.regAcc.reg != Register::RBP) {
+                    return -1;
+                }
+                continue;
+            } else if (operand.type != OperandType::MemPtr ||
+                       operand.memAcc.mode == AccessMode::None) {
+                continue;
+            }
+
+            const DynamicValue &ptr = operand.memAcc.ptrVal;
+            if (ptr.isTainted() || (operand.isOutput && operand.output.isStackPtr())) {
+                return -1;
+            } else if (!ptr.isStackPtr()) {
+                continue;
+            }
+
+            StackOperand stackOperand = {
+                .instruction = instruction,
+                .block = block,
+                .nr = operand.isImpl ? -1 : operand.nr,
+                .offset = ptr.getPtrOffset(),
+                .size = static_cast<uint8_t>(operand.memAcc.size),
+            };
+            if (operand.memAcc.mode != AccessMode::Address &&
+                !stackOperand.size) {
+                return -1;
+            }
+            stackOperands.push_back(stackOperand);
+        }
+        return 0;
+    }
+
+    int handleBlock(SuperBlock *block, Function *function)
+    {
+        (void)function;
+
+        blocks.push_back(block);
+        if (!block->getEntryState()) {
+            return 0;
+        }
+
+        ProgramState state = ProgramState(*block->getEntryState());
+
+        for (auto & instr : block->getInstructions()) {
+            const DynamicValue rsp = state.getRegister(Register::RSP);
+            const DynamicValue rbp = state.getRegister(Register::RBP);
+            const DynamicInstructionInfo *dynInfo = instr->getDynInfo();
+            SubRegisterMask written = instr->getInfo().writtenRegs;
+
+            instr->emulate(state, cfg, memProtCache, false);
+            if (!dynInfo || !rsp.isStackPtr() || !rbp.isStackPtr() ||
+                rsp.getNr() != rbp.getNr()) {
+                continue;
+            }
+            /*
+             * Memory operands of instructions that implicitly modify the
+             * stack pointer might be computed using the modified value
+             * (e.g. "pop [rbp - 8]"). Keep using the frame pointer.
+             */
+            written += instr->getInfo().condWrittenRegs;
+            if (!!(written & arch_get_register_info(Register::RSP)->full)) {
+                continue;
+            }
+
+            for (auto & operand : dynInfo->operands) {
+                if (operand.isImpl) {
+                    break;
+                }
+                if (operand.type != OperandType::MemPtr ||
+                    operand.memAcc.ptr.type != MemPtrType::SIB) {
+                    continue;
+                }
+
+                StaticOperand newOp = instr->getOperand(operand.nr);
+                if (newOp.mem.sib.base != Register::RBP ||
+                    newOp.mem.sib.index == Register::RBP ||
+                    newOp.mem.sib.disp.usrPtrNr != -1) {
+                    continue;
+                }
+                const int64_t disp = newOp.mem.sib.disp.val +
+                                     rbp.getPtrOffset() - rsp.getPtrOffset();
+                if (!isDisp32(disp)) {
+                    continue;
+                }
+
+                drob_debug("Instruction %p (%p): rebasing memory operand to the stack pointer",
+                           instr.get(), instr->getStartAddr());
+                newOp.mem.sib.base = Register::RSP;
+                newOp.mem.sib.disp.val = disp;
+                instr->setOperand(operand.nr, newOp);
+                block->invalidateStackAnalysis();
+                block->invalidateLivenessAnalysis();
+                rebased = true;
+            }
+        }
+        return 0;
+    }
+
+    /*
+     * Check if the frame pointer setup/teardown can be dropped.
+     */
+    bool canDropFrame(Function *function)
+    {
+        SuperBlock *entry = function->getEntryBlock();
+
+        if (fpUsed || saves.size() != 1 || restores.empty() ||
+            entry->getInstructions().front().get() != saves.front().second) {
+            return false;
+        }
+
+        for (auto & restore : restores) {
+            const auto &instrs = restore.first->getInstructions();
+            bool found = false;
+
+            /* Restores have to be directly followed by a return */
+            for (auto it = instrs.begin(); it != instrs.end(); it++) {
+                if (it->get() != restore.second) {
+                    continue;
+                }
+                found = ++it != instrs.end() && (*it)->isRet();
+                break;
+            }
+            if (!found) {
+                return false;
+            }
+        }
+
+        for (auto & stackOperand : stackOperands) {
+            Instruction *instr = stackOperand.instruction;
+            bool isFrameInstr = false;
+
+            for (auto & restore : restores) {
+                isFrameInstr |= restore.second == instr;
+            }
+            isFrameInstr |= saves.front().second == instr;
+
+            if (instr->isRet()) {
+                if (stackOperand.offset != 0) {
+                    return false;
+                }
+                continue;
+            } else if (isFrameInstr) {
+                if (stackOperand.offset != -8) {
+                    return false;
+                }
+                continue;
+            }
+
+            /* Nobody else may touch the saved frame pointer */
+            if (stackOperand.size) {
+                if (stackOperand.offset < 0 &&
+                    stackOperand.offset + stackOperand.size > -8) {
+                    return false;
+                }
+            } else if (stackOperand.offset > -8 && stackOperand.offset < 0) {
+                return false;
+            }
+
+            /* Explicit operands have to be based on the stack pointer */
+            if (stackOperand.nr >= 0) {
+                const StaticOperand &op = instr->getOperand(stackOperand.nr);
+
+                if (op.mem.type != MemPtrType::SIB ||
+                    op.mem.sib.base != Register::RSP ||
+                    op.mem.sib.index != Register::None ||
+                    op.mem.sib.disp.usrPtrNr != -1) {
+                    return false;
+                }
+            }
+        }
+
+        /* The function must not be re-entered via a branch */
+        for (auto & block : blocks) {
+            for (auto & instr : block->getInstructions()) {
+                if (instr->isRet()) {
+                    /* Returns have to be directly preceded by a restore */
+                    if (!isPrecededByRestore(block, instr.get())) {
+                        return false;
+                    }
+                } else if (instr->isBranch() &&
+                           instr->getBranchEdge()->dst == entry) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool isPrecededByRestore(SuperBlock *block, Instruction *instruction)
+    {
+        Instruction *prev = nullptr;
+
+        for (auto & instr : block->getInstructions()) {
+            if (instr.get() == instruction) {
+                break;
+            }
+            prev = instr.get();
+        }
+        return prev && arch_is_pop_register(*prev, Register::RBP);
+    }
+
+    void dropFrame(void)
+    {
+        std::vector<std::pair<SuperBlock *, Instruction *>> drop;
+
+        /*
+         * Our stack frame moves up by 8 bytes. Accesses to the stack frame of
+         * our caller (e.g. arguments) have to be fixed up.
+         */
+        for (auto & stackOperand : stackOperands) {
+            if (stackOperand.nr < 0 || stackOperand.offset < 0) {
+                continue;
+            }
+            Instruction *instr = stackOperand.instruction;
+            StaticOperand newOp = instr->getOperand(stackOperand.nr);
+
+            newOp.mem.sib.disp.val -= 8;
+            instr->setOperand(stackOperand.nr, newOp);
+            stackOperand.block->invalidateStackAnalysis();
+            stackOperand.block->invalidateLivenessAnalysis();
+        }
+
+        drop.insert(drop.end(), saves.begin(), saves.end());
+        drop.insert(drop.end(), setups.begin(), setups.end());
+        drop.insert(drop.end(), restores.begin(), restores.end());
+        for (auto & instr : drop) {
+            drob_info("Dropping frame pointer handling %p (%p)", instr.second,
+                      instr.second->getStartAddr());
+            instr.first->removeInstruction(instr.second);
+        }
+    }
+
+    bool run(void)
+    {
+        Function *function = icfg.getEntryFunction();
+        bool ret = false;
+
+        if (!function) {
+            return false;
+        }
+
+        if (function->for_each_instruction_any(this)) {
+            drob_info("Stack of function %p (%p) might escape", function,
+                      function->getStartAddr());
+            cleanup();
+            return false;
+        }
+
+        /* Rebase memory operands from the frame pointer to the stack pointer */
+        function->for_each_block_any(this);
+
+        if (rebased) {
+            /* Rerun with updated analysis data */
+            ret = true;
+        } else if (canDropFrame(function)) {
+            drob_info("Dropping frame pointer of function %p (%p)", function,
+                      function->getStartAddr());
+            dropFrame();
+            ret = true;
+        }
+        cleanup();
+        return ret;
+    }
+private:
+    void cleanup(void)
+    {
+        saves.clear();
+        restores.clear();
+        setups.clear();
+        stackOperands.clear();
+        blocks.clear();
+        fpUsed = false;
+        rebased = false;
+    }
+
+    const SubRegisterMask rbp = arch_get_register_info(Register::RBP)->full;
+    /* the frame pointer is used by other instructions */
+    bool fpUsed{false};
+    /* memory operands were rebased to the stack pointer */
+    bool rebased{false};
+    /* saves/restores of the frame pointer */
+    std::vector<std::pair<SuperBlock *, Instruction *>> saves;
+    std::vector<std::pair<SuperBlock *, Instruction *>> restores;
+    /* frame pointer setups */
+    std::vector<std::pair<SuperBlock *, Instruction *>> setups;
+    /* all stack memory operands */
+    std::vector<StackOperand> stackOperands;
+    /* all blocks of the function */
+    std::vector<SuperBlock *> blocks;
+};
+
+} /* namespace drob */
+
+#endif /* PASSES_FRAME_POINTER_ELIMINATION_PASS_HPP */
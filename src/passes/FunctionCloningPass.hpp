@@ -0,0 +1,181 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef PASSES_FUNCTION_CLONING_PASS_HPP
+#define PASSES_FUNCTION_CLONING_PASS_HPP
+
+#include <vector>
+#include <unordered_map>
+#include "../Utils.hpp"
+#include "../Pass.hpp"
+#include "../NodeCallback.hpp"
+#include "../arch.hpp"
+
+namespace drob {
+
+/*
+ * Clone called functions for call sites with different constant parameters.
+ * Interprocedural stack analysis merges the ProgramStates of all call sites,
+ * so constants that differ between call sites are lost. After cloning, each
+ * clone is analyzed (and therefore optimized) using the ProgramStates of
+ * its own call sites.
+ *
+ * Only registers that are alive at the entry of a function are considered
+ * as parameters. Other differences (e.g. stack pointers) don't result in a
+ * clone.
+ */
+class FunctionCloningPass : public Pass, public NodeCallback {
+public:
+    FunctionCloningPass(ICFG &icfg, BinaryPool &binaryPool,
+                        const RewriterCfg &cfg,
+                        const MemProtCache &memProtCache) :
+            Pass(icfg, binaryPool, cfg, memProtCache, "FunctionCloning",
+                 "Clone functions called with different constant parameters")
+    {
+    }
+
+    /* maximum number of clones to create in total */
+    static const unsigned int maxClones = 16;
+
+    bool needsStackAnalysis(void)
+    {
+        /* We need the ProgramStates at all call sites */
+        return true;
+    }
+
+    /*
+     * Check if the constant parameters passed via registers are the same.
+     */
+    static bool sameParameters(const ProgramState &lhs, const ProgramState &rhs,
+                               const SubRegisterMask &live)
+    {
+        for (int i = 1; i < (int)Register::MAX; i++) {
+            const Register reg = (Register)i;
+            const RegisterInfo *ri = arch_get_register_info(reg);
+
+            /* only look at complete registers that are alive */
+            if (ri->parent != Register::None || !(live & ri->full)) {
+                continue;
+            }
+
+            const DynamicValue lhsVal = lhs.getRegister(reg);
+            const DynamicValue rhsVal = rhs.getRegister(reg);
+
+            if ((lhsVal.isImm() || rhsVal.isImm()) && lhsVal != rhsVal) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Function *cloneFunction(Function *function)
+    {
+        std::unordered_map<const Instruction *, Instruction *> instrMap;
+        std::unique_ptr<Function> newFunction = function->copy(&icfg, instrMap);
+        Function *ret = newFunction.get();
+
+        /* Wire up all calls of the clone */
+        for (auto & edge : function->getOutgoingEdges()) {
+            auto newEdge = std::make_shared<CallEdge>();
+
+            newEdge->src = ret;
+            newEdge->dst = edge->dst;
+            newEdge->instruction = instrMap.at(edge->instruction);
+
+            newEdge->instruction->setCallEdge(newEdge);
+            newEdge->src->addOutgoingEdge(newEdge);
+            newEdge->dst->addIncomingEdge(newEdge);
+        }
+
+        icfg.addFunction(std::move(newFunction));
+        return ret;
+    }
+
+    int handleFunction(Function *function)
+    {
+        functions.push_back(function);
+        return 0;
+    }
+
+    bool run(void)
+    {
+        bool cloned = false;
+
+        icfg.for_each_function_any(this);
+
+        for (auto & function : functions) {
+            std::vector<std::vector<std::shared_ptr<CallEdge>>> groups;
+            const LivenessData *livenessData;
+
+            if (function == icfg.getEntryFunction() ||
+                !function->stackAnalysisValid || !function->livenessAnalysisValid) {
+                continue;
+            }
+            livenessData = function->getEntryBlock()->getLivenessData();
+            if (!livenessData) {
+                continue;
+            }
+
+            /* Group all call sites by the constant parameters */
+            for (auto & edge : function->getIncomingEdges()) {
+                bool found = false;
+
+                if (!edge->state) {
+                    continue;
+                }
+                for (auto & group : groups) {
+                    if (sameParameters(*group.front()->state, *edge->state,
+                                       livenessData->live_in)) {
+                        group.push_back(edge);
+                        found = true;
+                        break;
+                    }
+                }
+                if (!found) {
+                    groups.emplace_back(1, edge);
+                }
+            }
+
+            /* The first group stays with the original function */
+            for (size_t i = 1; i < groups.size() && numClones < maxClones; i++) {
+                Function *clone = cloneFunction(function);
+
+                drob_info("Cloned function %p (%p) for %zu call site(s)",
+                          function, function->getStartAddr(), groups[i].size());
+
+                for (auto & edge : groups[i]) {
+                    function->removeIncomingEdge(edge.get());
+                    edge->dst = clone;
+                    clone->addIncomingEdge(edge);
+                }
+                function->invalidateLivenessAnalysis();
+                function->invalidateStackAnalysis();
+                numClones++;
+                cloned = true;
+            }
+        }
+        functions.clear();
+
+        /* Clones might now call functions with different parameters */
+        return cloned && numClones < maxClones;
+    }
+private:
+    std::vector<Function *> functions;
+    unsigned int numClones{0};
+};
+
+} /* namespace drob */
+
+#endif /* PASSES_FUNCTION_CLONING_PASS_HPP */
@@ -18,6 +18,7 @@
 
 #include "../Utils.hpp"
 #include "../Pass.hpp"
+#include "../DecodeCache.hpp"
 
 namespace drob {
 
@@ -60,7 +61,7 @@ class CallEdgeCollector: public NodeCallback {
         (void)block;
         if (instruction->isCall() && !instruction->getCallEdge()) {
             CallEdge edge = { .dst = nullptr, .src = function, .instruction =
-                    instruction, };
+                    instruction, .state = nullptr, };
 
             edges.push_back(edge);
         }
@@ -123,6 +124,12 @@ public:
 
         icfg.reset();
 
+        /* Reuse the ICFG if we already decoded this function */
+        if (DecodeCache::instance().lookup(icfg, cfg, memProtCache)) {
+            icfg.getEntryFunction()->setInfo(cfg.getEntrySpec());
+            return false;
+        }
+
         /*
          * Decode and install the entry function. We don't allow recursion
          * on the entry function (which will have a known prototype and
@@ -132,6 +139,28 @@ public:
         resolveStack.push(icfg.getEntryFunction());
         icfg.getEntryFunction()->setInfo(cfg.getEntrySpec());
 
+        resolveCallEdges(resolveStack, functionMap);
+
+        /*
+         * Lowered jump tables depend on the content of (configured) constant
+         * memory, which is not verified when looking up cached ICFGs.
+         */
+        if (loweredJumpTables) {
+            drob_info("Not caching ICFG, it contains resolved jump tables");
+            return false;
+        }
+        DecodeCache::instance().insert(icfg, cfg, memProtCache);
+        return false;
+    }
+
+    /*
+     * Wire up the call edges of all functions on the stack. Called functions
+     * that are not contained in the function map yet are decoded and
+     * processed as well.
+     */
+    void resolveCallEdges(std::stack<Function *> &resolveStack,
+                          std::unordered_map<const uint8_t *, Function *> &functionMap)
+    {
         while (!resolveStack.empty()) {
             Function *curFunction = resolveStack.top();
             CallEdgeCollector collector;
@@ -174,7 +203,6 @@ public:
                 edge.instruction->setCallEdge(edgeptr);
             }
         }
-        return false;
     }
 
     std::unique_ptr<Function> decodeFunction(const uint8_t *itext)
@@ -210,6 +238,22 @@ public:
                 edgeptr->instruction->setReturnEdge(edgeptr);
             }
 
+            /* resolve jump tables, the branch is the last instruction */
+            if (!srcBlock->getInstructions().empty()) {
+                Instruction *branch = srcBlock->getInstructions().back().get();
+                std::list<std::unique_ptr<Instruction>> instrs;
+
+                if (branch->isBranch() && !branch->getBranchEdge() &&
+                    !branch->getRawTarget(memProtCache) &&
+                    arch_lower_jump_table(srcBlock->getInstructions(),
+                                          memProtCache, cfg, instrs)) {
+                    drob_info("Resolved jump table in block %p (%p)", srcBlock,
+                              srcBlock->getStartAddr());
+                    srcBlock->replaceInstruction(branch, instrs);
+                    loweredJumpTables = true;
+                }
+            }
+
             /* find and wire up all branch edges */
 recollectEdges:
             collector.edges.clear();
@@ -252,6 +296,9 @@ recollectEdges:
 
         return function;
     }
+private:
+    /* jump tables were lowered into direct branches while decoding */
+    bool loweredJumpTables{false};
 };
 
 } /* namespace drob */
@@ -0,0 +1,266 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef PASSES_INLINING_PASS_HPP
+#define PASSES_INLINING_PASS_HPP
+
+#include <vector>
+#include <unordered_map>
+#include "../Utils.hpp"
+#include "../Pass.hpp"
+#include "../NodeCallback.hpp"
+#include "../Instruction.hpp"
+#include "../arch.hpp"
+
+namespace drob {
+
+/*
+ * Inline small, non-recursive functions called from the entry function, so
+ * stack analysis and constant propagation are not stopped by helper calls.
+ *
+ * The call is replaced by instructions that push the original return address
+ * and the return instructions by instructions that drop it again, followed by
+ * a jump to the code following the call. This way, the stack layout (and
+ * therefore stack analysis) is the same as if the function would have been
+ * called.
+ *
+ * Every run inlines one level of calls. Calls contained in inlined functions
+ * will be considered in the next run, until the maximum depth is reached.
+ *
+ * Functions that branch to unknown code are not inlined: Such code might
+ * return via the return address, which would not return into our code.
+ *
+ * Unreachable functions are removed later by dead code elimination.
+ */
+class InliningPass : public Pass, public NodeCallback {
+public:
+    InliningPass(ICFG &icfg, BinaryPool &binaryPool, const RewriterCfg &cfg,
+                 const MemProtCache &memProtCache) :
+        Pass(icfg, binaryPool, cfg, memProtCache, "Inlining",
+             "Inline small functions")
+    {
+    }
+
+    /* maximum number of instructions of a function to inline */
+    static const unsigned int maxFunctionSize = 64;
+    /* maximum number of instructions to inline in total */
+    static const unsigned int maxInlinedSize = 1024;
+    /* maximum nesting of inlined calls */
+    static const unsigned int maxDepth = 4;
+
+    int handleInstruction(Instruction *instruction, SuperBlock *block,
+                          Function *function)
+    {
+        (void)function;
+
+        curSize++;
+        /* branches to unknown code */
+        if (instruction->isBranch() && !instruction->getBranchEdge()) {
+            return 1;
+        }
+        if (instruction->isRet() &&
+            (!instruction->getReturnEdge() ||
+             instruction != block->getInstructions().back().get())) {
+            return 1;
+        }
+        return 0;
+    }
+
+    /*
+     * Check if we can and want to inline the function. Returns the number
+     * of instructions of the function or 0 if it should not get inlined.
+     */
+    unsigned int canInline(Function *function)
+    {
+        auto it = sizeCache.find(function);
+
+        if (it != sizeCache.end()) {
+            return it->second;
+        }
+
+        curSize = 0;
+        if (function == icfg.getEntryFunction() ||
+            !function->getEntryBlock() || function->isRecursive() ||
+            function->for_each_instruction_any(this) ||
+            curSize > maxFunctionSize) {
+            curSize = 0;
+        }
+        sizeCache.insert(std::make_pair(function, curSize));
+        return curSize;
+    }
+
+    /*
+     * Append an explicit jump with a proper edge to the block.
+     */
+    static void appendJump(SuperBlock *src, SuperBlock *dst)
+    {
+        ExplicitStaticOperands dummy = {};
+
+        /* Fake any address, we have an edge, so this is basically ignored */
+        dummy.op[0].mem.type = MemPtrType::Direct;
+        std::unique_ptr<Instruction> newBranch = std::make_unique<Instruction>(Opcode::JMPa,
+                                                                               dummy);
+        std::shared_ptr<BranchEdge> newEdge = std::make_shared<BranchEdge>(dst, src, newBranch.get());
+
+        newBranch->setBranchEdge(newEdge);
+        src->appendInstruction(newBranch);
+        src->addOutgoingEdge(newEdge);
+        dst->addIncomingEdge(newEdge);
+    }
+
+    void inlineCall(Function *caller, SuperBlock *block, Instruction *call,
+                    Function *callee)
+    {
+        std::unordered_map<const Instruction *, Instruction *> instrMap;
+        std::unordered_map<const SuperBlock *, SuperBlock *> blockMap;
+        std::list<std::unique_ptr<Instruction>> instrs;
+        SuperBlock *cont, *entry;
+
+        drob_info("Inlining function %p (%p) at %p (%p)", callee,
+                  callee->getStartAddr(), call, call->getStartAddr());
+
+        /* The code following the call continues after returning */
+        if (call != block->getInstructions().back().get()) {
+            cont = caller->splitBlockAfter(block, call);
+        } else {
+            cont = block->getNext();
+        }
+
+        caller->copyBlocks(*callee, instrMap, blockMap);
+        entry = blockMap.at(callee->getEntryBlock());
+
+        /* Wire up all calls of the copied blocks */
+        for (auto & edge : callee->getOutgoingEdges()) {
+            auto newEdge = std::make_shared<CallEdge>();
+
+            newEdge->src = caller;
+            newEdge->dst = edge->dst;
+            newEdge->instruction = instrMap.at(edge->instruction);
+
+            newEdge->instruction->setCallEdge(newEdge);
+            newEdge->src->addOutgoingEdge(newEdge);
+            newEdge->dst->addIncomingEdge(newEdge);
+        }
+
+        /* Replace all returns by stack adjustments + jumps to the code after the call */
+        for (auto & edge : callee->getReturnEdges()) {
+            SuperBlock *retBlock = blockMap.at(edge->src);
+            Instruction *ret = instrMap.at(edge->instruction);
+
+            drob_assert(cont && !retBlock->getNext());
+            arch_inline_ret(*ret, instrs);
+            retBlock->removeInstruction(ret);
+            retBlock->addInstructions(instrs);
+            appendJump(retBlock, cont);
+        }
+
+        /* Replace the call by a stack adjustment, falling through to the entry */
+        arch_inline_call(*call, instrs);
+        block->removeInstruction(call);
+        block->addInstructions(instrs);
+        if (cont) {
+            cont->setPrev(nullptr);
+            block->setNext(nullptr);
+        }
+        if (!entry->getPrev()) {
+            entry->setPrev(block);
+            block->setNext(entry);
+        } else {
+            appendJump(block, entry);
+        }
+    }
+
+    bool run(void)
+    {
+        Function *entryFunction = icfg.getEntryFunction();
+        bool inlined = false;
+
+        if (unlikely(!entryFunction) || depth >= maxDepth)
+            return false;
+
+        /*
+         * Collect all calls first, inlining will add new edges. Calls of
+         * inlined functions will be processed in the next run.
+         */
+        for (auto & edge : entryFunction->getOutgoingEdges()) {
+            calls.push_back(std::make_pair(edge->instruction, edge->dst));
+        }
+
+        for (auto & call : calls) {
+            unsigned int size = canInline(call.second);
+            SuperBlock *block;
+
+            if (!size || inlinedSize + size > maxInlinedSize) {
+                continue;
+            }
+
+            /* Previous inlining might have split the block */
+            block = findBlock(entryFunction, call.first);
+            drob_assert(block);
+
+            /* Without following code, returning is impossible */
+            if (!call.second->getReturnEdges().empty() &&
+                call.first == block->getInstructions().back().get() &&
+                !block->getNext()) {
+                continue;
+            }
+
+            inlineCall(entryFunction, block, call.first, call.second);
+            inlinedSize += size;
+            inlined = true;
+        }
+        calls.clear();
+
+        depth++;
+        return inlined && depth < maxDepth;
+    }
+private:
+    class BlockFinder : public NodeCallback {
+    public:
+        BlockFinder(Instruction *instruction) : instruction(instruction) {}
+
+        int handleInstruction(Instruction *instruction, SuperBlock *block,
+                              Function *function)
+        {
+            (void)function;
+            if (instruction == this->instruction) {
+                this->block = block;
+                return 1;
+            }
+            return 0;
+        }
+
+        Instruction *instruction;
+        SuperBlock *block{nullptr};
+    };
+
+    static SuperBlock *findBlock(Function *function, Instruction *instruction)
+    {
+        BlockFinder finder(instruction);
+
+        function->for_each_instruction_any(&finder);
+        return finder.block;
+    }
+
+    std::vector<std::pair<Instruction *, Function *>> calls;
+    std::unordered_map<Function *, unsigned int> sizeCache;
+    unsigned int curSize{0};
+    unsigned int inlinedSize{0};
+    unsigned int depth{0};
+};
+
+} /* namespace drob */
+
+#endif /* PASSES_INLINING_PASS_HPP */
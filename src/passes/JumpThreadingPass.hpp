@@ -0,0 +1,219 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef PASSES_JUMP_THREADING_PASS_HPP
+#define PASSES_JUMP_THREADING_PASS_HPP
+
+#include <vector>
+#include "../Utils.hpp"
+#include "../Pass.hpp"
+#include "../NodeCallback.hpp"
+#include "../Instruction.hpp"
+#include "StackAnalysisPass.hpp"
+
+namespace drob {
+
+/*
+ * Jump threading: If the branches of a block cannot be decided based on the
+ * merged ProgramState when entering the block, they might still be decided
+ * when entering the block via some specific branch edges (e.g. a flag that
+ * is only known on some paths in a state machine).
+ *
+ * For each such branch edge, a copy of the block is created and the edge is
+ * redirected to the copy. Stack analysis will then figure out that all
+ * branches in the copy are decided and dead code elimination can drop them.
+ * The original block remains for all other predecessors.
+ */
+class JumpThreadingPass : public Pass, public NodeCallback {
+public:
+    JumpThreadingPass(ICFG &icfg, BinaryPool &binaryPool,
+                      const RewriterCfg &cfg, const MemProtCache &memProtCache) :
+        Pass(icfg, binaryPool, cfg, memProtCache, "JumpThreading",
+             "Duplicate blocks to decide branches per incoming edge")
+    {
+    }
+
+    /* maximum number of instructions of a block to be duplicated */
+    static const unsigned int maxBlockSize = 16;
+    /* maximum number of duplicated instructions per function */
+    static const unsigned int maxGrowth = 256;
+
+    bool needsStackAnalysis(void)
+    {
+        /* We need the ProgramState when entering blocks */
+        return true;
+    }
+
+    /*
+     * Compute the ProgramState when branching along the given edge.
+     */
+    std::unique_ptr<ProgramState> getEdgeState(const BranchEdge &edge)
+    {
+        if (!edge.src->getEntryState()) {
+            return nullptr;
+        }
+
+        auto state = std::make_unique<ProgramState>(*edge.src->getEntryState());
+        for (auto & instr : edge.src->getInstructions()) {
+            if (instr.get() == edge.instruction) {
+                break;
+            }
+            /* We don't know what the callee does */
+            if (instr->isCall() || instr->isRet()) {
+                return nullptr;
+            }
+            if (!instr->isBranch()) {
+                instr->emulate(*state, cfg, memProtCache, false);
+            }
+        }
+        return state;
+    }
+
+    /*
+     * Check if all branches in the block are decided when entering the block
+     * with the given ProgramState.
+     */
+    bool branchesDecided(SuperBlock *block, ProgramState &state)
+    {
+        for (auto & instr : block->getInstructions()) {
+            if (instr->isCall() || instr->isRet()) {
+                return false;
+            }
+            if (!instr->isBranch()) {
+                instr->emulate(state, cfg, memProtCache, false);
+                continue;
+            }
+
+            const TriState taken = instr->willExecute(state);
+            if (taken == TriState::Unknown) {
+                return false;
+            } else if (taken == TriState::True) {
+                return true;
+            }
+        }
+        return true;
+    }
+
+    bool isCandidate(SuperBlock *block)
+    {
+        bool predicated = false;
+
+        if (!block->getEntryState() || block->getIncomingEdges().empty() ||
+            block->getInstructions().size() > maxBlockSize) {
+            return false;
+        }
+        for (auto & instr : block->getInstructions()) {
+            if (instr->isBranch() && !instr->getBranchEdge()) {
+                return false;
+            }
+            predicated |= instr->isBranch() && instr->getPredicate();
+        }
+        if (!predicated) {
+            return false;
+        }
+
+        /* Already decided for all predecessors? */
+        ProgramState state = ProgramState(*block->getEntryState());
+        return !branchesDecided(block, state);
+    }
+
+    /*
+     * Returns the number of duplicated instructions.
+     */
+    unsigned int threadBlock(Function *function, SuperBlock *block,
+                             unsigned int budget)
+    {
+        std::vector<std::shared_ptr<BranchEdge>> edges;
+        const unsigned int size = block->getInstructions().size() + 1;
+        unsigned int growth = 0;
+
+        for (auto & edge : block->getIncomingEdges()) {
+            if (edge->src == block || growth + size > budget) {
+                continue;
+            }
+
+            auto state = getEdgeState(*edge);
+            if (!state || !branchesDecided(block, *state)) {
+                continue;
+            }
+            edges.push_back(edge);
+            growth += size;
+        }
+        if (edges.empty()) {
+            return 0;
+        }
+
+        drob_info("Threading %zu edges through block %p (%p)", edges.size(),
+                  block, block->getStartAddr());
+
+        /* The copies need an explicit branch to our successor */
+        block->unchainNext();
+        for (auto & edge : edges) {
+            SuperBlock *copy = function->copyBlock(block);
+
+            block->removeIncomingEdge(edge.get());
+            edge->dst = copy;
+            copy->addIncomingEdge(edge);
+        }
+        return growth;
+    }
+
+    int handleBlock(SuperBlock *block, Function *function)
+    {
+        (void)function;
+        blocks.push_back(block);
+        return 0;
+    }
+
+    int handleFunction(Function *function)
+    {
+        unsigned int growth = 0;
+
+        function->for_each_block_any(this);
+        for (auto & block : blocks) {
+            if (growth >= maxGrowth) {
+                break;
+            }
+            if (isCandidate(block)) {
+                growth += threadBlock(function, block, maxGrowth - growth);
+            }
+        }
+        blocks.clear();
+
+        /*
+         * Start the next stack analysis from scratch. Merging into the old
+         * entry states would lose the precision gained by threading.
+         */
+        if (growth) {
+            ClearStackAnalysisData clearStackAnalysisData;
+
+            function->for_each_block_any(&clearStackAnalysisData);
+            function->invalidateStackAnalysis();
+        }
+        return 0;
+    }
+
+    bool run(void)
+    {
+        icfg.for_each_function_any(this);
+        return false;
+    }
+private:
+    std::vector<SuperBlock *> blocks;
+};
+
+} /* namespace drob */
+
+#endif /* PASSES_JUMP_THREADING_PASS_HPP */
@@ -126,10 +126,13 @@ public:
             return false;
         }
 
-        /* For now we only handle the entry function */
+        /*
+         * We only handle functions with a specification: the entry function
+         * and called functions analyzed by the interprocedural stack analysis.
+         */
         if (!icfg.getEntryFunction())
             return false;
-        handleFunction(icfg.getEntryFunction());
+        icfg.for_each_function_dfs(this);
 
         icfg.livenessAnalysisValid = true;
         return false;
@@ -0,0 +1,308 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef PASSES_LOOP_INVARIANT_CODE_MOTION_PASS_HPP
+#define PASSES_LOOP_INVARIANT_CODE_MOTION_PASS_HPP
+
+#include <vector>
+#include <unordered_set>
+#include "../Utils.hpp"
+#include "../Pass.hpp"
+#include "../NodeCallback.hpp"
+#include "../Instruction.hpp"
+#include "../LoopInfo.hpp"
+#include "../AliasInfo.hpp"
+
+namespace drob {
+
+/*
+ * Move loop-invariant instructions out of loops, into a preheader block in
+ * front of the loop header.
+ *
+ * We only consider instructions that are executed in every iteration before
+ * the loop can be left (the straight-line code starting at the header).
+ * Therefore, no instruction is executed that wouldn't have been executed
+ * before. An instruction is invariant if
+ * - It only reads registers that are not written inside the loop.
+ * - It reads memory only if the memory is known to be constant or not
+ *   written by any instruction in the loop (see AliasInfo).
+ * - It doesn't write memory and is not predicated.
+ * - The registers it writes (and are alive afterwards) are not written
+ *   by other instructions in the loop.
+ * - The registers it writes are not alive when entering the loop.
+ */
+class LoopInvariantCodeMotionPass : public Pass, public NodeCallback {
+public:
+    LoopInvariantCodeMotionPass(ICFG &icfg, BinaryPool &binaryPool,
+                                const RewriterCfg &cfg,
+                                const MemProtCache &memProtCache) :
+        Pass(icfg, binaryPool, cfg, memProtCache, "LoopInvariantCodeMotion",
+             "Move loop-invariant instructions out of loops")
+    {
+    }
+
+    /* maximum number of iterations (e.g., to process nested loops) */
+    static const int maxIterations = 4;
+
+    bool needsStackAnalysis(void)
+    {
+        /* We need the actual memory pointers */
+        return true;
+    }
+
+    bool needsLivenessAnalysis(void)
+    {
+        return true;
+    }
+
+    /*
+     * Check if memory accessed by the instruction is constant or not
+     * modified inside the loop.
+     */
+    bool readsOnlyInvariantMemory(const Instruction *instruction,
+                                  const Loop &loop)
+    {
+        const DynamicInstructionInfo *dynInfo = instruction->getDynInfo();
+
+        if (!dynInfo) {
+            return false;
+        }
+        for (auto & operand : dynInfo->operands) {
+            uint64_t ptrVal;
+
+            if (operand.type != OperandType::MemPtr ||
+                operand.memAcc.mode == AccessMode::None ||
+                operand.memAcc.mode == AccessMode::Address) {
+                continue;
+            }
+            if (operand.memAcc.mode != AccessMode::Read &&
+                operand.memAcc.mode != AccessMode::MayRead) {
+                return false;
+            }
+            if (operand.memAcc.ptrVal.isUsrPtr() &&
+                cfg.getUsrPtrCfg(operand.memAcc.ptrVal.getNr()).isConst) {
+                continue;
+            }
+            if (ptrToInt(operand.memAcc.ptrVal, cfg, &ptrVal) &&
+                memProtCache.isConstant(ptrVal, static_cast<uint8_t>(operand.memAcc.size))) {
+                continue;
+            }
+            for (auto & cur : loop.blockList) {
+                for (auto & other : cur->getInstructions()) {
+                    if (mayWriteAlias(*other, operand.memAcc, cfg)) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    bool processLoop(Function *function, const Loop &loop)
+    {
+        std::vector<std::pair<SuperBlock *, Instruction *>> candidates;
+        std::unordered_set<Instruction *> hoisted;
+        const LivenessData *headerLiveness = loop.header->getLivenessData();
+        SuperBlock *block = loop.header;
+        bool changed = true;
+
+        if (!headerLiveness || loop.header->getInstructions().empty()) {
+            return false;
+        }
+
+        /* We need a complete picture of what the loop writes */
+        for (auto & cur : loop.blockList) {
+            for (auto & instr : cur->getInstructions()) {
+                if (instr->isCall() || instr->isRet() || instr->getInfo().nasty) {
+                    return false;
+                }
+            }
+        }
+
+        /* Collect the instructions executed in every iteration */
+        while (block && loop.blocks.count(block)) {
+            bool stop = false;
+
+            for (auto & instr : block->getInstructions()) {
+                if (instr->isBranch()) {
+                    stop = true;
+                    break;
+                }
+                candidates.emplace_back(block, instr.get());
+            }
+            if (stop) {
+                break;
+            }
+            block = block->getNext();
+            if (block == loop.header) {
+                break;
+            }
+        }
+
+        /* Hoisting an instruction might make other instructions invariant */
+        while (changed) {
+            SubRegisterMask written;
+
+            changed = false;
+            written.zero();
+            for (auto & cur : loop.blockList) {
+                for (auto & instr : cur->getInstructions()) {
+                    if (!hoisted.count(instr.get())) {
+                        written += instr->getInfo().writtenRegs;
+                        written += instr->getInfo().condWrittenRegs;
+                    }
+                }
+            }
+
+            for (auto & candidate : candidates) {
+                Instruction *instr = candidate.second;
+                const InstructionInfo &info = instr->getInfo();
+                const LivenessData *livenessData = instr->getLivenessData();
+                SubRegisterMask otherWritten;
+                SubRegisterMask reads = info.readRegs;
+
+                if (hoisted.count(instr) || !livenessData || instr->getPredicate() ||
+                    info.mayWriteMem || !!info.condWrittenRegs ||
+                    !readsOnlyInvariantMemory(instr, loop)) {
+                    continue;
+                }
+
+                /* Inputs must not be modified inside the loop */
+                reads += info.predicateRegs;
+                if (!!(reads & written)) {
+                    continue;
+                }
+                /* Outputs must not be alive when entering the loop */
+                if (!!(info.writtenRegs & headerLiveness->live_in)) {
+                    continue;
+                }
+                /* Alive outputs must not be written by other instructions */
+                otherWritten.zero();
+                for (auto & cur : loop.blockList) {
+                    for (auto & other : cur->getInstructions()) {
+                        if (other.get() != instr && !hoisted.count(other.get())) {
+                            otherWritten += other->getInfo().writtenRegs;
+                            otherWritten += other->getInfo().condWrittenRegs;
+                        }
+                    }
+                }
+                if (!!(info.writtenRegs & livenessData->live_out & otherWritten)) {
+                    continue;
+                }
+
+                hoisted.insert(instr);
+                changed = true;
+                break;
+            }
+        }
+
+        if (hoisted.empty()) {
+            return false;
+        }
+        moveToPreheader(function, loop, candidates, hoisted);
+        return true;
+    }
+
+    /*
+     * Create a preheader by splitting the header and move all hoisted
+     * instructions in order into the preheader.
+     */
+    void moveToPreheader(Function *function, const Loop &loop,
+                         const std::vector<std::pair<SuperBlock *, Instruction *>> &candidates,
+                         const std::unordered_set<Instruction *> &hoisted)
+    {
+        SuperBlock *preheader = loop.header;
+        SuperBlock *header;
+
+        drob_info("Hoisting %zu instructions out of loop %p (%p)", hoisted.size(),
+                  loop.header, loop.header->getStartAddr());
+
+        /* Fallthrough from inside the loop has to target the new header */
+        if (preheader->getPrev() && loop.blocks.count(preheader->getPrev())) {
+            preheader->getPrev()->unchainNext();
+        }
+
+        /*
+         * The old header will become the preheader. Everybody from outside
+         * the loop will continue to enter it.
+         */
+        header = function->splitBlock(preheader, preheader->getInstructions().front().get());
+
+        /* Let all back edges target the new header */
+        const auto edges = preheader->getIncomingEdges();
+        for (auto & edge : edges) {
+            if (edge->src == header ||
+                (edge->src != preheader && loop.blocks.count(edge->src))) {
+                preheader->removeIncomingEdge(edge.get());
+                edge->dst = header;
+                header->addIncomingEdge(edge);
+            }
+        }
+
+        for (auto & candidate : candidates) {
+            SuperBlock *block = candidate.first == preheader ? header : candidate.first;
+            Instruction *instr = candidate.second;
+
+            if (!hoisted.count(instr)) {
+                continue;
+            }
+            std::unique_ptr<Instruction> newInstr = std::make_unique<Instruction>(*instr);
+            preheader->appendInstruction(newInstr);
+            block->removeInstruction(instr);
+        }
+    }
+
+    int handleFunction(Function *function)
+    {
+        functions.push_back(function);
+        return 0;
+    }
+
+    bool run(void)
+    {
+        bool changed = false;
+
+        icfg.for_each_function_any(this);
+        for (auto & function : functions) {
+            std::vector<const Loop *> processed;
+            LoopInfo loopInfo(function);
+
+            /* Inner loops first, skip loops containing modified loops */
+            const auto & loops = loopInfo.getLoops();
+            for (auto it = loops.rbegin(); it != loops.rend(); it++) {
+                const Loop *loop = it->get();
+                bool skip = false;
+
+                for (auto & other : processed) {
+                    skip |= loop->blocks.count(other->header) != 0;
+                }
+                if (!skip && processLoop(function, *loop)) {
+                    processed.push_back(loop);
+                    changed = true;
+                }
+            }
+        }
+        functions.clear();
+
+        return changed && ++iteration < maxIterations;
+    }
+private:
+    std::vector<Function *> functions;
+    int iteration{0};
+};
+
+} /* namespace drob */
+
+#endif /* PASSES_LOOP_INVARIANT_CODE_MOTION_PASS_HPP */
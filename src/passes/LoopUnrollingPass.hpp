@@ -0,0 +1,407 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef PASSES_LOOP_UNROLLING_PASS_HPP
+#define PASSES_LOOP_UNROLLING_PASS_HPP
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "../Utils.hpp"
+#include "../Pass.hpp"
+#include "../NodeCallback.hpp"
+#include "../LoopInfo.hpp"
+#include "../arch.hpp"
+#include "StackAnalysisPass.hpp"
+
+namespace drob {
+
+/*
+ * Unrolling of innermost natural loops (detected via dominators). Loops may
+ * consist of multiple blocks.
+ *
+ * The trip count (number of times the header is executed) is detected by
+ * emulating the loop using the ProgramState when entering the loop (as
+ * computed by stack analysis). If an induction variable is constant when
+ * entering the loop, all loop branches can be evaluated.
+ *
+ * - Small loops with a known trip count are completely unrolled. Stack
+ *   analysis will later figure out that all loop branches are decided.
+ * - Loops with a known trip count that is too big are partially unrolled.
+ *   The remainder of iterations (trip count modulo unroll factor) is peeled
+ *   off in front of the loop. As we know when the loop will be left, all exit
+ *   branches of all but the last copy of the loop body can be dropped.
+ * - Loops with an unknown trip count are partially unrolled, keeping all
+ *   exit branches.
+ *
+ * The unroll factor is limited by the configured unroll count and the
+ * size of the unrolled loop.
+ */
+class LoopUnrollingPass : public Pass, public NodeCallback {
+public:
+    LoopUnrollingPass(ICFG &icfg, BinaryPool &binaryPool,
+                      const RewriterCfg &cfg, const MemProtCache &memProtCache) :
+        Pass(icfg, binaryPool, cfg, memProtCache, "LoopUnrolling",
+             "Loop unrolling based on trip counts")
+    {
+    }
+
+    /* maximum number of instructions of an unrolled loop (including peeling) */
+    static const unsigned int maxUnrolledSize = 512;
+    /* maximum trip count we try to detect */
+    static const unsigned int maxTripCount = 4096;
+    /* maximum number of instructions to emulate when detecting the trip count */
+    static const unsigned int maxEmulatedInstructions = 65536;
+
+    bool needsStackAnalysis(void)
+    {
+        /* We need the ProgramState when entering a loop */
+        return true;
+    }
+
+    /*
+     * Compute the ProgramState when entering the loop. Only possible if
+     * there is exactly one block entering the loop that was analyzed.
+     */
+    std::unique_ptr<ProgramState> getEntryState(const Loop &loop)
+    {
+        SuperBlock *pred = nullptr;
+        Instruction *branch = nullptr;
+
+        if (loop.header->getPrev() && !loop.blocks.count(loop.header->getPrev())) {
+            pred = loop.header->getPrev();
+        }
+        for (auto & edge : loop.header->getIncomingEdges()) {
+            if (loop.blocks.count(edge->src)) {
+                continue;
+            }
+            if (pred) {
+                return nullptr;
+            }
+            pred = edge->src;
+            branch = edge->instruction;
+        }
+        if (!pred || !pred->getEntryState()) {
+            return nullptr;
+        }
+
+        auto state = std::make_unique<ProgramState>(*pred->getEntryState());
+        for (auto & instr : pred->getInstructions()) {
+            if (instr.get() == branch) {
+                break;
+            }
+            if (instr->isCall() || instr->isRet()) {
+                return nullptr;
+            }
+            if (!instr->isBranch()) {
+                instr->emulate(*state, cfg, memProtCache, false);
+            }
+        }
+        return state;
+    }
+
+    /*
+     * Detect the trip count of a loop by emulating it. Return 0 if unknown.
+     */
+    unsigned int detectTripCount(const Loop &loop)
+    {
+        std::unique_ptr<ProgramState> state = getEntryState(loop);
+        unsigned int tripCount = 1, emulated = 0;
+        SuperBlock *block = loop.header;
+
+        if (!state) {
+            return 0;
+        }
+
+        while (true) {
+            SuperBlock *nextBlock = block->getNext();
+
+            for (auto & instr : block->getInstructions()) {
+                if (++emulated > maxEmulatedInstructions) {
+                    return 0;
+                }
+                /* We don't know what the callee does */
+                if (instr->isCall() || instr->isRet()) {
+                    return 0;
+                }
+                if (!instr->isBranch()) {
+                    instr->emulate(*state, cfg, memProtCache, false);
+                    continue;
+                }
+                if (!instr->getBranchEdge()) {
+                    return 0;
+                }
+
+                const TriState taken = instr->willExecute(*state);
+                if (taken == TriState::Unknown) {
+                    return 0;
+                } else if (taken == TriState::True) {
+                    nextBlock = instr->getBranchEdge()->dst;
+                    break;
+                }
+            }
+
+            if (!nextBlock) {
+                return 0;
+            } else if (!loop.blocks.count(nextBlock)) {
+                /* we left the loop */
+                return tripCount;
+            } else if (nextBlock == loop.header && ++tripCount > maxTripCount) {
+                return 0;
+            }
+            block = nextBlock;
+        }
+    }
+
+    static void retargetEdge(const std::shared_ptr<BranchEdge> &edge, SuperBlock *dst)
+    {
+        if (edge->dst == dst) {
+            return;
+        }
+        edge->dst->removeIncomingEdge(edge.get());
+        edge->dst = dst;
+        edge->dst->addIncomingEdge(edge);
+    }
+
+    /*
+     * Turn
+     *  jcc LOOP
+     *  jmp EXIT
+     * into
+     *  jcc' EXIT
+     *  jmp LOOP
+     * This way, the exit branch can be dropped in unrolled copies.
+     */
+    static void normalizeExits(const Loop &loop)
+    {
+        for (auto & block : loop.blockList) {
+            const auto & instrs = block->getInstructions();
+
+            if (instrs.size() < 2) {
+                continue;
+            }
+            Instruction *jmp = instrs.back().get();
+            Instruction *jcc = std::prev(instrs.end(), 2)->get();
+
+            if (!jmp->isBranch() || jmp->getPredicate() || !jmp->getBranchEdge() ||
+                loop.blocks.count(jmp->getBranchEdge()->dst) ||
+                !jcc->isBranch() || !jcc->getPredicate() || !jcc->getBranchEdge() ||
+                !loop.blocks.count(jcc->getBranchEdge()->dst)) {
+                continue;
+            }
+
+            Opcode opcode = arch_invert_branch(jcc->getOpcode());
+            if (opcode == Opcode::NONE) {
+                continue;
+            }
+            SuperBlock *exit = jmp->getBranchEdge()->dst;
+
+            jcc->setOpcode(opcode);
+            retargetEdge(jmp->getBranchEdge(), jcc->getBranchEdge()->dst);
+            retargetEdge(jcc->getBranchEdge(), exit);
+        }
+    }
+
+    /*
+     * Unroll a loop. "peel" copies of the loop body are placed in front of the
+     * loop, the loop will consist of "factor" copies of the loop body.
+     * Optionally, drop conditional exit branches from all but the last copy.
+     */
+    void unrollLoop(Function *function, const Loop &loop, unsigned int peel,
+                    unsigned int factor, bool dropExits)
+    {
+        std::vector<std::unordered_map<SuperBlock *, SuperBlock *>> bodies;
+        std::vector<std::shared_ptr<BranchEdge>> entryEdges;
+        SuperBlock *header = loop.header;
+
+        drob_info("Unrolling loop %p (%p): peel %u, factor %u", header,
+                  header->getStartAddr(), peel, factor);
+
+        /*
+         * Replace all fallthroughs by explicit branches. This makes it way
+         * easier to copy blocks and wire them up. Will be optimized out later.
+         */
+        for (auto & block : loop.blockList) {
+            block->unchainNext();
+        }
+        normalizeExits(loop);
+
+        /* Remember how the loop is entered, before adding more edges */
+        if (peel) {
+            if (header->getPrev() && !loop.blocks.count(header->getPrev())) {
+                header->getPrev()->unchainNext();
+            }
+            for (auto & edge : header->getIncomingEdges()) {
+                if (!loop.blocks.count(edge->src)) {
+                    entryEdges.push_back(edge);
+                }
+            }
+        }
+
+        /* Copy the loop body, the original body is the first loop copy */
+        for (unsigned int i = 0; i < peel + factor; i++) {
+            bodies.emplace_back();
+            for (auto & block : loop.blockList) {
+                bodies[i][block] = i == peel ? block : function->copyBlock(block);
+            }
+        }
+
+        /*
+         * Wire up the copies. Branches inside the loop body stay in the same
+         * copy, branches to the header continue with the next copy. The last
+         * copy continues with the original body.
+         */
+        for (unsigned int i = 0; i < bodies.size(); i++) {
+            SuperBlock *nextHeader = i + 1 < bodies.size() ? bodies[i + 1][header] : header;
+
+            for (auto & block : loop.blockList) {
+                SuperBlock *copy = bodies[i][block];
+                const auto edges = copy->getOutgoingEdges();
+
+                for (auto & edge : edges) {
+                    /* copyBlock() already redirected self-branches to the copy */
+                    SuperBlock *dst = edge->dst == copy ? block : edge->dst;
+
+                    if (dst == header) {
+                        retargetEdge(edge, nextHeader);
+                    } else if (loop.blocks.count(dst)) {
+                        retargetEdge(edge, bodies[i][dst]);
+                    }
+                }
+            }
+        }
+
+        /* Enter the loop via the first peeled copy */
+        for (auto & edge : entryEdges) {
+            retargetEdge(edge, bodies.front()[header]);
+        }
+
+        /* Drop exit branches that will never be taken */
+        if (!dropExits) {
+            return;
+        }
+        std::unordered_set<SuperBlock *> copies;
+        for (auto & body : bodies) {
+            for (auto & pair : body) {
+                copies.insert(pair.second);
+            }
+        }
+        for (unsigned int i = 0; i + 1 < bodies.size(); i++) {
+            for (auto & block : loop.blockList) {
+                SuperBlock *copy = bodies[i][block];
+                std::vector<Instruction *> exits;
+
+                for (auto & edge : copy->getOutgoingEdges()) {
+                    if (!copies.count(edge->dst) && edge->instruction->getPredicate()) {
+                        exits.push_back(edge->instruction);
+                    }
+                }
+                for (auto & exit : exits) {
+                    copy->removeInstruction(exit);
+                }
+            }
+        }
+    }
+
+    void processFunction(Function *function)
+    {
+        const unsigned int maxFactor = cfg.getDrobCfg().simple_loop_unroll_count + 1;
+        std::vector<std::pair<const Loop *, unsigned int>> toUnroll;
+        LoopInfo loopInfo(function);
+        bool unrolled = false;
+
+        /* Detect all trip counts first, before we modify anything */
+        for (auto & loop : loopInfo.getLoops()) {
+            if (loop->innermost) {
+                toUnroll.emplace_back(loop.get(), detectTripCount(*loop));
+            }
+        }
+
+        for (auto & entry : toUnroll) {
+            const Loop &loop = *entry.first;
+            const unsigned int tripCount = entry.second;
+            unsigned int size = 0, sizeFactor;
+
+            for (auto & block : loop.blockList) {
+                size += block->getInstructions().size();
+            }
+            sizeFactor = maxUnrolledSize / std::max(size, 1u);
+
+            if (tripCount) {
+                drob_info("Loop %p (%p) has a trip count of %u", loop.header,
+                          loop.header->getStartAddr(), tripCount);
+            }
+
+            if (tripCount && tripCount <= sizeFactor) {
+                /* Small loop, unroll it completely */
+                if (tripCount > 1) {
+                    unrollLoop(function, loop, 0, tripCount, true);
+                    unrolled = true;
+                }
+            } else if (tripCount) {
+                /* Find the biggest factor that fits, including the remainder */
+                for (unsigned int factor = std::min(maxFactor, sizeFactor);
+                     factor >= 2; factor--) {
+                    if ((factor + tripCount % factor) * size <= maxUnrolledSize) {
+                        unrollLoop(function, loop, tripCount % factor, factor, true);
+                        unrolled = true;
+                        break;
+                    }
+                }
+            } else if (std::min(maxFactor, sizeFactor) >= 2) {
+                /* Unknown trip count, keep all exit branches */
+                unrollLoop(function, loop, 0, std::min(maxFactor, sizeFactor), false);
+                unrolled = true;
+            }
+        }
+
+        /*
+         * Start the next stack analysis from scratch. Merging into the old
+         * entry states would lose the precision gained by unrolling.
+         */
+        if (unrolled) {
+            ClearStackAnalysisData clearStackAnalysisData;
+
+            function->for_each_block_any(&clearStackAnalysisData);
+            function->invalidateStackAnalysis();
+        }
+    }
+
+    int handleFunction(Function *function)
+    {
+        functions.push_back(function);
+        return 0;
+    }
+
+    bool run(void)
+    {
+        if (unlikely(!cfg.getDrobCfg().simple_loop_unroll_count))
+            return false;
+
+        icfg.for_each_function_any(this);
+        for (auto & function : functions) {
+            processFunction(function);
+        }
+        functions.clear();
+        return false;
+    }
+
+private:
+    std::vector<Function *> functions;
+};
+
+} /* namespace drob */
+
+#endif /* PASSES_LOOP_UNROLLING_PASS_HPP */
@@ -0,0 +1,109 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef PASSES_PEEPHOLE_OPTIMIZATION_PASS_HPP
+#define PASSES_PEEPHOLE_OPTIMIZATION_PASS_HPP
+
+#include <vector>
+#include "../Utils.hpp"
+#include "../Pass.hpp"
+#include "../NodeCallback.hpp"
+#include "../Instruction.hpp"
+#include "../arch.hpp"
+
+namespace drob {
+
+/*
+ * Replace short instruction sequences by cheaper ones, based on the
+ * architecture-specific pattern table. Patterns only look at an instruction
+ * and its predecessor, so we do a single linear sweep over each block.
+ */
+class PeepholeOptimizationPass : public Pass, public NodeCallback {
+public:
+    PeepholeOptimizationPass(ICFG &icfg, BinaryPool &binaryPool,
+                             const RewriterCfg &cfg,
+                             const MemProtCache &memProtCache) :
+        Pass(icfg, binaryPool, cfg, memProtCache, "PeepholeOptimization",
+             "Replace instruction sequences by cheaper ones")
+    {
+    }
+
+    bool needsLivenessAnalysis(void)
+    {
+        /* Patterns might only apply if registers are dead */
+        return true;
+    }
+
+    int handleBlock(SuperBlock *block, Function *function)
+    {
+        std::vector<Instruction *> dropped;
+        Instruction *prev = nullptr;
+        bool changed = false;
+        (void)function;
+
+        for (auto & instr : block->getInstructions()) {
+            const LivenessData *livenessData = instr->getLivenessData();
+            Opcode opcode = instr->getOpcode();
+            ExplicitStaticOperands operands = instr->getOperands();
+
+            /* Dead instructions will be dropped by dead write elimination */
+            if (!livenessData) {
+                prev = instr.get();
+                continue;
+            }
+
+            switch (arch_peephole(prev, opcode, operands, *livenessData)) {
+            case SpecRet::Change:
+                drob_debug("Instruction %p (%p): peephole optimized",
+                           instr.get(), instr->getStartAddr());
+                instr->setOpcode(opcode);
+                for (int i = 0; i < instr->getNumOperands(); i++) {
+                    instr->setOperand(i, operands.op[i]);
+                }
+                changed = true;
+                break;
+            case SpecRet::Delete:
+                drob_debug("Instruction %p (%p): dropped by peephole optimization",
+                           instr.get(), instr->getStartAddr());
+                dropped.push_back(instr.get());
+                changed = true;
+                /* keep the previous instruction */
+                continue;
+            default:
+                break;
+            }
+            prev = instr.get();
+        }
+
+        for (auto & instr : dropped) {
+            block->removeInstruction(instr);
+        }
+        if (changed) {
+            block->invalidateStackAnalysis();
+            block->invalidateLivenessAnalysis();
+        }
+        return 0;
+    }
+
+    bool run(void)
+    {
+        icfg.for_each_block_any(this);
+        return false;
+    }
+};
+
+} /* namespace drob */
+
+#endif /* PASSES_PEEPHOLE_OPTIMIZATION_PASS_HPP */
@@ -0,0 +1,316 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef PASSES_PROFILE_GUIDED_LAYOUT_PASS_HPP
+#define PASSES_PROFILE_GUIDED_LAYOUT_PASS_HPP
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../Utils.hpp"
+#include "../Pass.hpp"
+#include "../NodeCallback.hpp"
+#include "../Instruction.hpp"
+#include "../arch.hpp"
+
+namespace drob {
+
+/*
+ * Lay out blocks based on branch profiles provided via the drob config.
+ *
+ * 1. Conditional branches that are usually taken are inverted and the hot
+ *    target is chained as fallthrough.
+ * 2. Fallthrough chains that are only entered via rarely taken branches
+ *    (or from other cold chains) are marked cold. Code generation places
+ *    them behind all hot code.
+ *
+ * We run after block layout optimization, so chains are no longer changed.
+ * Earlier passes might already have inverted profiled branches, so the
+ * profiles are matched against the predicate of the original branch.
+ */
+class ProfileGuidedLayoutPass : public Pass, public NodeCallback {
+public:
+    ProfileGuidedLayoutPass(ICFG &icfg, BinaryPool &binaryPool,
+                            const RewriterCfg &cfg,
+                            const MemProtCache &memProtCache) :
+        Pass(icfg, binaryPool, cfg, memProtCache, "ProfileGuidedLayout",
+             "Lay out blocks based on branch profiles") {}
+
+    int handleBlock(SuperBlock *block, Function *function)
+    {
+        blocks.push_back(block);
+
+        /* Only one branch per block, the block might get split */
+        for (auto & instr : block->getInstructions()) {
+            unsigned long long taken, notTaken;
+
+            if (getBranchProfile(instr.get(), &taken, &notTaken) &&
+                taken > notTaken) {
+                if (canInvertBranch(block, instr.get(), function)) {
+                    hotBranches.emplace_back(block, instr.get());
+                }
+                break;
+            }
+        }
+        return 0;
+    }
+
+    int handleFunction(Function *function)
+    {
+        function->for_each_block_any(this);
+
+        for (auto & pair : hotBranches) {
+            invertBranch(function, pair.first, pair.second);
+        }
+        markColdChains(function);
+
+        hotBranches.clear();
+        blocks.clear();
+        return 0;
+    }
+
+    bool run(void)
+    {
+        const drob_cfg &drobCfg = cfg.getDrobCfg();
+
+        if (likely(!drobCfg.branch_count))
+            return false;
+
+        for (int i = 0; i < drobCfg.branch_count; i++) {
+            const drob_branch_cfg &branchCfg = drobCfg.branches[i];
+            const uint8_t *itext = (const uint8_t *)branchCfg.branch;
+            BranchProfile branchProfile = {
+                .opcode = decodeOpcode(itext),
+                .taken = branchCfg.taken,
+                .notTaken = branchCfg.not_taken,
+            };
+
+            if (branchProfile.opcode != Opcode::NONE) {
+                profile[itext] = branchProfile;
+            }
+        }
+        icfg.for_each_function_any(this);
+
+        profile.clear();
+        return false;
+    }
+private:
+    typedef struct BranchProfile {
+        /* the opcode of the original branch the counts refer to */
+        Opcode opcode;
+        unsigned long long taken;
+        unsigned long long notTaken;
+    } BranchProfile;
+
+    /*
+     * A branch is considered cold if it is taken in less than 1/COLD_RATIO
+     * of all cases.
+     */
+    static const unsigned long long COLD_RATIO = 16;
+
+    std::unordered_map<const uint8_t *, BranchProfile> profile;
+    std::vector<std::pair<SuperBlock *, Instruction *>> hotBranches;
+    std::vector<SuperBlock *> blocks;
+
+    /*
+     * Decode the original conditional branch, returns Opcode::NONE if it is
+     * not a single conditional branch.
+     */
+    Opcode decodeOpcode(const uint8_t *itext)
+    {
+        const uint64_t addr = (uint64_t)itext;
+        uint16_t max_ilen = ARCH_PAGE_SIZE - (addr & (ARCH_PAGE_SIZE - 1));
+        std::list<std::unique_ptr<Instruction>> instrs;
+        DecodeRet ret;
+
+        if (!itext) {
+            return Opcode::NONE;
+        }
+        if (max_ilen > ARCH_MAX_ILEN) {
+            max_ilen = ARCH_MAX_ILEN;
+        }
+        /* first try to decode without crossing page boundaries */
+        ret = arch_decode_one(&itext, max_ilen, instrs, cfg);
+        if (ret == DecodeRet::BrokenInstr && max_ilen < ARCH_MAX_ILEN) {
+            ret = arch_decode_one(&itext, ARCH_MAX_ILEN, instrs, cfg);
+        }
+        if (ret != DecodeRet::Ok || instrs.size() != 1 ||
+            !instrs.front()->isBranch() || !instrs.front()->getPredicate()) {
+            return Opcode::NONE;
+        }
+        return instrs.front()->getOpcode();
+    }
+
+    /*
+     * Get the profile of a conditional branch, adjusted to its current
+     * predicate.
+     */
+    bool getBranchProfile(const Instruction *instr, unsigned long long *taken,
+                          unsigned long long *notTaken)
+    {
+        if (!instr->isBranch() || !instr->getPredicate() ||
+            !instr->getBranchEdge() || !instr->getStartAddr()) {
+            return false;
+        }
+
+        auto it = profile.find(instr->getStartAddr());
+        if (it == profile.end()) {
+            return false;
+        }
+
+        if (instr->getOpcode() == it->second.opcode) {
+            *taken = it->second.taken;
+            *notTaken = it->second.notTaken;
+        } else if (instr->getOpcode() == arch_invert_branch(it->second.opcode)) {
+            /* inverted, e.g. by us or when normalizing loop exits */
+            *taken = it->second.notTaken;
+            *notTaken = it->second.taken;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    static SuperBlock *getChainHead(SuperBlock *block)
+    {
+        while (block->getPrev()) {
+            block = block->getPrev();
+        }
+        return block;
+    }
+
+    bool canInvertBranch(SuperBlock *block, Instruction *jcc,
+                         Function *function)
+    {
+        SuperBlock *dst = jcc->getBranchEdge()->dst;
+
+        /* The target has to be a chain we can append */
+        if (dst->getPrev() || dst == function->getEntryBlock() ||
+            getChainHead(block) == dst) {
+            return false;
+        }
+        /* Something has to follow that we can branch to instead */
+        if (jcc == block->getInstructions().back().get() && !block->getNext()) {
+            return false;
+        }
+        return arch_invert_branch(jcc->getOpcode()) != Opcode::NONE;
+    }
+
+    static void retargetEdge(const std::shared_ptr<BranchEdge> &edge, SuperBlock *dst)
+    {
+        edge->dst->removeIncomingEdge(edge.get());
+        edge->dst = dst;
+        edge->dst->addIncomingEdge(edge);
+    }
+
+    /*
+     * Turn
+     *  jcc HOT
+     *  COLD
+     * into
+     *  jcc' COLD
+     *  HOT
+     */
+    void invertBranch(Function *function, SuperBlock *block, Instruction *jcc)
+    {
+        const std::shared_ptr<BranchEdge> edge = jcc->getBranchEdge();
+        SuperBlock *hot = edge->dst;
+        SuperBlock *cold;
+
+        /* Another inverted branch might have already claimed the target */
+        if (hot->getPrev() || getChainHead(block) == hot) {
+            return;
+        }
+
+        drob_info("Inverting branch %p (%p) in %p (%p)", jcc,
+                  jcc->getStartAddr(), block, block->getStartAddr());
+
+        if (jcc != block->getInstructions().back().get()) {
+            cold = function->splitBlockAfter(block, jcc);
+            blocks.push_back(cold);
+        } else {
+            cold = block->getNext();
+        }
+
+        /* The fallthrough is now the branch target and vice versa */
+        cold->setPrev(nullptr);
+        jcc->setOpcode(arch_invert_branch(jcc->getOpcode()));
+        retargetEdge(edge, cold);
+        block->setNext(hot);
+        hot->setPrev(block);
+
+        block->invalidateStackAnalysis();
+        block->invalidateLivenessAnalysis();
+    }
+
+    bool isColdBranch(const Instruction *instr)
+    {
+        unsigned long long taken, notTaken;
+
+        if (!getBranchProfile(instr, &taken, &notTaken)) {
+            return false;
+        }
+        return taken < (taken + notTaken) / COLD_RATIO;
+    }
+
+    /*
+     * Can the chain only be entered via cold edges? Edges from within the
+     * chain itself (loops) don't count.
+     */
+    bool isColdChain(SuperBlock *head)
+    {
+        bool hasEdges = false;
+
+        for (SuperBlock *b = head; b; b = b->getNext()) {
+            for (auto & edge : b->getIncomingEdges()) {
+                SuperBlock *src = getChainHead(edge->src);
+
+                if (src == head) {
+                    continue;
+                } else if (!src->cold && !isColdBranch(edge->instruction)) {
+                    return false;
+                }
+                hasEdges = true;
+            }
+        }
+        return hasEdges;
+    }
+
+    void markColdChains(Function *function)
+    {
+        bool changed;
+
+        do {
+            changed = false;
+            for (auto & block : blocks) {
+                if (block->cold || block->getPrev() ||
+                    block == function->getEntryBlock() || !isColdChain(block)) {
+                    continue;
+                }
+                drob_info("Cold chain: %p (%p)", block, block->getStartAddr());
+                for (SuperBlock *b = block; b; b = b->getNext()) {
+                    b->cold = true;
+                }
+                changed = true;
+            }
+        } while (changed);
+    }
+};
+
+} /* namespace drob */
+
+#endif /* PASSES_PROFILE_GUIDED_LAYOUT_PASS_HPP */
@@ -0,0 +1,113 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef PASSES_SLP_VECTORIZATION_PASS_HPP
+#define PASSES_SLP_VECTORIZATION_PASS_HPP
+
+#include <list>
+#include <memory>
+#include <tuple>
+#include <vector>
+#include "../Utils.hpp"
+#include "../Pass.hpp"
+#include "../NodeCallback.hpp"
+#include "../Instruction.hpp"
+#include "../arch.hpp"
+
+namespace drob {
+
+/*
+ * Superword-level parallelism: pack isomorphic scalar operations on adjacent
+ * memory (e.g. two iterations of an unrolled loop) into packed operations.
+ * The actual matching is done by the architecture, we only take care of
+ * replacing the instructions.
+ */
+class SLPVectorizationPass : public Pass, public NodeCallback {
+public:
+    SLPVectorizationPass(ICFG &icfg, BinaryPool &binaryPool,
+                         const RewriterCfg &cfg,
+                         const MemProtCache &memProtCache) :
+        Pass(icfg, binaryPool, cfg, memProtCache, "SLPVectorization",
+             "Pack isomorphic scalar operations into packed operations") {}
+
+    bool needsStackAnalysis(void)
+    {
+        /* We need pointer values to detect aliasing */
+        return true;
+    }
+
+    bool needsLivenessAnalysis(void)
+    {
+        /* Packing clobbers the upper halves of vector registers */
+        return true;
+    }
+
+    int handleBlock(SuperBlock *block, Function *function)
+    {
+        std::vector<std::tuple<unsigned int, unsigned int,
+                               std::list<std::unique_ptr<Instruction>>>> replaced;
+        std::vector<Instruction *> instrs;
+        (void)function;
+
+        for (auto & instr : block->getInstructions()) {
+            instrs.push_back(instr.get());
+        }
+
+        for (unsigned int i = 0; i < instrs.size(); i++) {
+            std::list<std::unique_ptr<Instruction>> packed;
+            unsigned int count;
+
+            count = arch_slp_vectorize(instrs, i, packed);
+            if (count) {
+                drob_debug("Instruction %p (%p): packed %u instructions into %zu",
+                           instrs[i], instrs[i]->getStartAddr(), count,
+                           packed.size());
+                replaced.emplace_back(i, count, std::move(packed));
+                i += count - 1;
+            }
+        }
+
+        for (auto & entry : replaced) {
+            const unsigned int start = std::get<0>(entry);
+            const unsigned int count = std::get<1>(entry);
+
+            for (unsigned int i = start + 1; i < start + count; i++) {
+                block->removeInstruction(instrs[i]);
+            }
+            block->replaceInstruction(instrs[start], std::get<2>(entry));
+        }
+        return 0;
+    }
+
+    int handleFunction(Function *function)
+    {
+        /* We might only have data for the entry function */
+        if (unlikely(!function->stackAnalysisValid ||
+                     !function->livenessAnalysisValid))
+            return 0;
+        function->for_each_block_any(this);
+        return 0;
+    }
+
+    bool run(void)
+    {
+        icfg.for_each_function_any(this);
+        return false;
+    }
+};
+
+} /* namespace drob */
+
+#endif /* PASSES_SLP_VECTORIZATION_PASS_HPP */
@@ -17,14 +17,26 @@
 #define PASSES_STACK_ANALYSIS_PASS_HPP
 
 #include <queue>
+#include <unordered_set>
 #include "../Rewriter.hpp"
 #include "../Utils.hpp"
 #include "../Pass.hpp"
 #include "../NodeCallback.hpp"
 #include "../Instruction.hpp"
+#include "LivenessAnalysisPass.hpp"
 
 namespace drob {
 
+class ClearStackAnalysisData : public NodeCallback {
+    int handleBlock(SuperBlock * block, Function *function)
+    {
+        (void)function;
+        block->setEntryState(nullptr);
+        block->stackAnalysisValid = false;
+        return 0;
+    }
+};
+
 class StackAnalysisPass : public Pass, public NodeCallback {
 public:
     StackAnalysisPass(ICFG &icfg, BinaryPool &binaryPool,
@@ -180,6 +192,123 @@ public:
         function->stackAnalysisValid = true;
     }
 
+    /*
+     * Analyze a called function using the merged ProgramStates of all call
+     * sites as entry state. The function specification is derived from the
+     * call sites, too: We don't know the prototype, however, all registers
+     * read after returning (at any call site) have to be produced or
+     * preserved by the function.
+     */
+    void processCallee(Function *function)
+    {
+        std::unique_ptr<ProgramState> entryState;
+        FunctionSpecification spec;
+
+        spec.reg.in.fill();
+        spec.reg.out.zero();
+        spec.reg.preserved.zero();
+
+        for (auto & edge : function->getIncomingEdges()) {
+            const LivenessData *livenessData = edge->instruction->getLivenessData();
+
+            /* No state -> the call site is never executed */
+            if (!edge->state) {
+                continue;
+            }
+            if (!entryState) {
+                entryState = std::make_unique<ProgramState>(*edge->state);
+            } else {
+                entryState->merge(*edge->state);
+            }
+            if (livenessData) {
+                spec.reg.out += livenessData->live_out;
+            } else {
+                spec.reg.out.fill();
+            }
+        }
+
+        /* Without return edges, we cannot compute liveness information */
+        if (!entryState || function->getReturnEdges().empty()) {
+            return;
+        }
+
+        /* Nothing changed since the last analysis? */
+        SuperBlock *entryBlock = function->getEntryBlock();
+        if (function->livenessAnalysisValid && function->stackAnalysisValid &&
+            function->getInfo() && function->getInfo()->reg.out == spec.reg.out &&
+            entryBlock->getEntryState() &&
+            sameState(*entryBlock->getEntryState(), *entryState)) {
+            return;
+        }
+
+        drob_info("Analyzing called function %p (%p)", function,
+                  function->getStartAddr());
+
+        /* Start fresh, the new entry state might be more precise */
+        ClearStackAnalysisData clearStackAnalysisData;
+        function->for_each_block_any(&clearStackAnalysisData);
+        function->stackAnalysisValid = false;
+        function->livenessAnalysisValid = false;
+
+        function->setInfo(spec);
+        LivenessAnalysisPass livenessAnalysis(icfg, binaryPool, cfg, memProtCache);
+        livenessAnalysis.handleFunction(function);
+
+        entryBlock->setEntryState(std::move(entryState));
+        processFunction(function);
+    }
+
+    /*
+     * Interprocedural analysis: Analyze called functions once all callers
+     * have been analyzed. Recursive functions and functions only called by
+     * them are not analyzed.
+     */
+    void processCallees(Function *entryFunction)
+    {
+        std::unordered_set<Function *> done;
+        bool progress = true;
+
+        icfg.for_each_function_any(this);
+        done.insert(entryFunction);
+
+        while (progress) {
+            progress = false;
+            for (auto & function : functions) {
+                bool ready = true;
+                bool analyzable = true;
+
+                if (done.count(function)) {
+                    continue;
+                }
+                for (auto & edge : function->getIncomingEdges()) {
+                    if (!done.count(edge->src)) {
+                        ready = false;
+                        break;
+                    }
+                    if (!edge->src->stackAnalysisValid) {
+                        analyzable = false;
+                    }
+                }
+                if (!ready) {
+                    continue;
+                }
+                done.insert(function);
+                progress = true;
+
+                if (analyzable && !function->getIncomingEdges().empty()) {
+                    processCallee(function);
+                }
+            }
+        }
+        functions.clear();
+    }
+
+    int handleFunction(Function *function)
+    {
+        functions.push_back(function);
+        return 0;
+    }
+
     bool run(void)
     {
         Function *entryFunction = icfg.getEntryFunction();
@@ -200,15 +329,27 @@ public:
         }
 
         /*
-         * TODO for now, we only handle the entry function for which we
-         * don't allow recursion, so we can safely optimize it.
+         * We don't allow recursion of the entry function, so we can safely
+         * optimize it. Called functions are analyzed afterwards.
          */
         processFunction(entryFunction);
+        processCallees(entryFunction);
 
         icfg.stackAnalysisValid = true;
         return false;
     }
 
+    static bool sameState(const ProgramState &lhs, const ProgramState &rhs)
+    {
+        ProgramState tmp = lhs;
+
+        if (tmp.merge(rhs)) {
+            return false;
+        }
+        tmp = rhs;
+        return !tmp.merge(lhs);
+    }
+
     static bool regIsDead(const LivenessData *livenessData, Register reg,
                           RegisterAccessType type = RegisterAccessType::Full)
     {
@@ -247,6 +388,11 @@ public:
         drob_debug("Calculating stack analysis data");
         instruction->emulate(*curState, cfg, memProtCache, true);
 
+        /* Remember the state for interprocedural analysis */
+        if (instruction->isCall() && instruction->getCallEdge()) {
+            instruction->getCallEdge()->state = std::make_shared<ProgramState>(*curState);
+        }
+
         /*
          * Stack Analysis Optimization:
          *
@@ -321,6 +467,7 @@ public:
 private:
     ProgramState *curState;
     std::queue<SuperBlock *> blocksToProcess;
+    std::vector<Function *> functions;
 };
 
 } /* namespace drob */
@@ -0,0 +1,233 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef PASSES_STACK_SLOT_PROMOTION_PASS_HPP
+#define PASSES_STACK_SLOT_PROMOTION_PASS_HPP
+
+#include <map>
+#include <vector>
+#include "../Utils.hpp"
+#include "../Pass.hpp"
+#include "../NodeCallback.hpp"
+#include "../Instruction.hpp"
+#include "../arch.hpp"
+
+namespace drob {
+
+/*
+ * Promote stack slots of the entry function (e.g. locals of unoptimized
+ * code) to registers. Loads and stores of a slot are replaced by register
+ * moves, which can be optimized further (e.g. dead write elimination).
+ *
+ * Stack analysis knows the target of every memory access. A stack pointer
+ * can never be hidden in an unknown value - it becomes tainted. So a slot is
+ * not accessed via unknown pointers (escapes) if
+ * - No memory access uses a tainted pointer.
+ * - There are no calls and no nasty instructions.
+ *
+ * A slot (offset + size) can be promoted if all accesses are plain loads/stores
+ * of the complete slot and no other access overlaps. Only slots within the
+ * own stack frame (below the return address) are considered, their content is
+ * not visible once we return.
+ *
+ * We use registers not accessed by the function at all (and neither preserved
+ * nor returned according to the function specification), so they are dead
+ * across the complete live range of the slot.
+ */
+class StackSlotPromotionPass : public Pass, public NodeCallback {
+public:
+    StackSlotPromotionPass(ICFG &icfg, BinaryPool &binaryPool,
+                           const RewriterCfg &cfg,
+                           const MemProtCache &memProtCache) :
+        Pass(icfg, binaryPool, cfg, memProtCache, "StackSlotPromotion",
+             "Promote stack slots to unused registers")
+    {
+    }
+
+    bool needsStackAnalysis(void)
+    {
+        /* We need the targets of all memory accesses */
+        return true;
+    }
+
+    typedef struct SlotAccess {
+        Instruction *instruction;
+        SuperBlock *block;
+        int64_t offset;
+        uint8_t size;
+        /* plain load/store of the complete slot */
+        bool promotable;
+    } SlotAccess;
+
+    int handleInstruction(Instruction *instruction, SuperBlock *block,
+                          Function *function)
+    {
+        const InstructionInfo &info = instruction->getInfo();
+        const DynamicInstructionInfo *dynInfo = instruction->getDynInfo();
+        (void)function;
+
+        if (info.nasty || instruction->isCall()) {
+            return -1;
+        }
+        used += info.readRegs;
+        used += info.writtenRegs;
+        used += info.condWrittenRegs;
+        used += info.predicateRegs;
+
+        if (!dynInfo) {
+            /* Instructions without liveness data are dead and will be dropped */
+            return instruction->getLivenessData() ? -1 : 0;
+        }
+
+        for (auto & operand : dynInfo->operands) {
+            const DynamicValue &ptr = operand.memAcc.ptrVal;
+
+            if (operand.type != OperandType::MemPtr ||
+                operand.memAcc.mode == AccessMode::None ||
+                operand.memAcc.mode == AccessMode::Address) {
+                continue;
+            }
+            if (ptr.isTainted()) {
+                return -1;
+            } else if (!ptr.isStackPtr()) {
+                continue;
+            }
+
+            Opcode opcode = instruction->getOpcode();
+            ExplicitStaticOperands operands = instruction->getOperands();
+            SlotAccess access = {
+                .instruction = instruction,
+                .block = block,
+                .offset = ptr.getPtrOffset(),
+                .size = static_cast<uint8_t>(operand.memAcc.size),
+                .promotable = !operand.isImpl && !instruction->getPredicate() &&
+                              arch_promote_mem_access(opcode, operands, Register::RAX),
+            };
+            accesses.push_back(access);
+        }
+        return 0;
+    }
+
+    /*
+     * Collect all registers that can hold a stack slot.
+     */
+    std::vector<Register> getFreeRegisters(const Function *function)
+    {
+        std::vector<Register> regs;
+        SubRegisterMask blocked = used;
+
+        blocked += function->getInfo()->reg.preserved;
+        blocked += function->getInfo()->reg.out;
+        blocked += function->getInfo()->reg.in;
+        for (int i = 1; i < (int)Register::MAX; i++) {
+            const RegisterInfo *ri = arch_get_register_info((Register)i);
+
+            if (ri->type == RegisterType::Gprs64 && ri->parent == Register::None &&
+                !(blocked & ri->full)) {
+                regs.push_back((Register)i);
+            }
+        }
+        return regs;
+    }
+
+    bool run(void)
+    {
+        Function *function = icfg.getEntryFunction();
+        std::map<std::pair<int64_t, uint8_t>, bool> slots;
+        std::vector<Register> regs;
+        std::map<std::pair<int64_t, uint8_t>, Register> promoted;
+
+        if (!function || !function->getInfo()) {
+            return false;
+        }
+
+        used.zero();
+        accesses.clear();
+        if (function->for_each_instruction_any(this)) {
+            drob_info("Stack slots of function %p (%p) might escape",
+                      function, function->getStartAddr());
+            return false;
+        }
+
+        /* Detect the slots, only plain and complete accesses */
+        for (auto & access : accesses) {
+            auto key = std::make_pair(access.offset, access.size);
+            bool ok = access.promotable && access.offset + access.size <= 0 &&
+                      (access.size == 4 || access.size == 8);
+
+            auto it = slots.find(key);
+            if (it == slots.end()) {
+                slots[key] = ok;
+            } else {
+                it->second &= ok;
+            }
+        }
+
+        /* No overlapping slots */
+        for (auto it = slots.begin(); it != slots.end(); it++) {
+            for (auto next = std::next(it); next != slots.end(); next++) {
+                if (it->first.first + it->first.second <= next->first.first) {
+                    break;
+                }
+                it->second = false;
+                next->second = false;
+            }
+        }
+
+        regs = getFreeRegisters(function);
+        for (auto & slot : slots) {
+            if (regs.empty()) {
+                break;
+            }
+            if (slot.second) {
+                drob_info("Promoting stack slot %" PRIi64 " (%d bytes) to %s",
+                          slot.first.first, slot.first.second,
+                          arch_get_register_info(regs.back())->name);
+                promoted[slot.first] = regs.back();
+                regs.pop_back();
+            }
+        }
+
+        for (auto & access : accesses) {
+            auto it = promoted.find(std::make_pair(access.offset, access.size));
+
+            if (it == promoted.end()) {
+                continue;
+            }
+
+            Opcode opcode = access.instruction->getOpcode();
+            ExplicitStaticOperands operands = access.instruction->getOperands();
+
+            arch_promote_mem_access(opcode, operands, it->second);
+            access.instruction->setOpcode(opcode);
+            for (int i = 0; i < access.instruction->getNumOperands(); i++) {
+                access.instruction->setOperand(i, operands.op[i]);
+            }
+            access.block->invalidateLivenessAnalysis();
+            access.block->invalidateStackAnalysis();
+        }
+        accesses.clear();
+        return false;
+    }
+private:
+    /* all registers accessed by the function */
+    SubRegisterMask used;
+    /* all accesses to the stack */
+    std::vector<SlotAccess> accesses;
+};
+
+} /* namespace drob */
+
+#endif /* PASSES_STACK_SLOT_PROMOTION_PASS_HPP */
@@ -0,0 +1,105 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef PASSES_STRENGTH_REDUCTION_PASS_HPP
+#define PASSES_STRENGTH_REDUCTION_PASS_HPP
+
+#include <list>
+#include <memory>
+#include <vector>
+#include "../Utils.hpp"
+#include "../Pass.hpp"
+#include "../NodeCallback.hpp"
+#include "../Instruction.hpp"
+#include "../arch.hpp"
+
+namespace drob {
+
+/*
+ * Replace expensive instructions with known operands (e.g. multiplications
+ * and divisions by constants) by sequences of cheaper instructions. Single
+ * instruction replacements are already done by instruction specialization,
+ * this pass takes care of replacements that require multiple instructions.
+ */
+class StrengthReductionPass : public Pass, public NodeCallback {
+public:
+    StrengthReductionPass(ICFG &icfg, BinaryPool &binaryPool,
+                          const RewriterCfg &cfg,
+                          const MemProtCache &memProtCache) :
+        Pass(icfg, binaryPool, cfg, memProtCache, "StrengthReduction",
+             "Replace expensive instructions by cheaper sequences") {}
+
+    bool needsStackAnalysis(void)
+    {
+        /* We need to known runtime operands */
+        return true;
+    }
+
+    bool needsLivenessAnalysis(void)
+    {
+        /* Replacements might clobber eflags and other dead registers */
+        return true;
+    }
+
+    int handleBlock(SuperBlock *block, Function *function)
+    {
+        std::vector<std::pair<Instruction *,
+                              std::list<std::unique_ptr<Instruction>>>> replaced;
+        (void)function;
+
+        for (auto & instr : block->getInstructions()) {
+            const DynamicInstructionInfo *dynInfo = instr->getDynInfo();
+            const LivenessData *livenessData = instr->getLivenessData();
+            std::list<std::unique_ptr<Instruction>> instrs;
+
+            if (unlikely(!dynInfo || !livenessData)) {
+                continue;
+            }
+
+            if (arch_strength_reduce(instr->getOpcode(), instr->getOperands(),
+                                     *dynInfo, *livenessData, cfg, binaryPool,
+                                     instrs)) {
+                drob_debug("Instruction %p (%p): replaced by %zu instructions",
+                           instr.get(), instr->getStartAddr(), instrs.size());
+                replaced.emplace_back(instr.get(), std::move(instrs));
+            }
+        }
+
+        for (auto & pair : replaced) {
+            block->replaceInstruction(pair.first, pair.second);
+        }
+        return 0;
+    }
+
+    int handleFunction(Function *function)
+    {
+        /* We might only have data for the entry function */
+        if (unlikely(!function->stackAnalysisValid ||
+                     !function->livenessAnalysisValid))
+            return 0;
+        function->for_each_block_any(this);
+        return 0;
+    }
+
+    bool run(void)
+    {
+        icfg.for_each_function_any(this);
+        return false;
+    }
+};
+
+} /* namespace drob */
+
+#endif /* PASSES_STRENGTH_REDUCTION_PASS_HPP */
@@ -0,0 +1,226 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef PASSES_TAIL_CALL_CONVERSION_PASS_HPP
+#define PASSES_TAIL_CALL_CONVERSION_PASS_HPP
+
+#include <list>
+#include <memory>
+#include <vector>
+#include "../Utils.hpp"
+#include "../Pass.hpp"
+#include "../NodeCallback.hpp"
+#include "../Instruction.hpp"
+#include "../arch.hpp"
+
+namespace drob {
+
+/*
+ * Turn calls that are followed by a return (and some stack cleanup in
+ * between) into tail calls: perform the stack cleanup before the call and
+ * jump to the called function, which will return directly to our caller.
+ *
+ * Tail calls are not modeled by our analyses, so this has to run after all
+ * optimizations.
+ */
+class TailCallConversionPass : public Pass, public NodeCallback {
+public:
+    TailCallConversionPass(ICFG &icfg, BinaryPool &binaryPool,
+                           const RewriterCfg &cfg,
+                           const MemProtCache &memProtCache) :
+        Pass(icfg, binaryPool, cfg, memProtCache, "TailCallConversion",
+             "Convert calls followed by returns into tail calls") {}
+
+    bool needsStackAnalysis(void)
+    {
+        /* We have to know how the called function accesses the stack */
+        return true;
+    }
+
+    bool needsLivenessAnalysis(void)
+    {
+        /* Registers the epilogue writes must not be alive when returning */
+        return true;
+    }
+
+    /*
+     * Check if the called function might access the stack above its return
+     * address (stack arguments or our stack frame).
+     */
+    int handleInstruction(Instruction *instruction, SuperBlock *block,
+                          Function *function)
+    {
+        const DynamicInstructionInfo *dynInfo = instruction->getDynInfo();
+        (void)block;
+        (void)function;
+
+        /* Not executed */
+        if (!dynInfo) {
+            return 0;
+        }
+        /* We don't know what other called functions do */
+        if (dynInfo->nasty || instruction->isCall()) {
+            return 1;
+        }
+
+        for (auto & operand : dynInfo->operands) {
+            if (operand.type != OperandType::MemPtr ||
+                (!operand.isInput && !operand.isOutput)) {
+                continue;
+            }
+
+            const DynamicValue &ptr = operand.memAcc.ptrVal;
+            if (ptr.isTainted()) {
+                return 1;
+            } else if (ptr.isStackPtr() &&
+                       (operand.memAcc.size == MemAccessSize::Unknown ||
+                        ptr.getPtrOffset() + (int64_t)operand.memAcc.size > stackLimit)) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    int handleBlock(SuperBlock *block, Function *function)
+    {
+        const auto & instrs = block->getInstructions();
+        std::list<std::unique_ptr<Instruction>> cleanup;
+        std::vector<Instruction *> epilogue;
+        Instruction *call = nullptr;
+        (void)function;
+
+        for (auto it = instrs.rbegin(); it != instrs.rend(); ++it) {
+            if ((*it)->isCall()) {
+                call = it->get();
+                break;
+            }
+            epilogue.insert(epilogue.begin(), it->get());
+        }
+
+        if (!call || call->getPredicate() || !call->getCallEdge() ||
+            block->getNext()) {
+            return 0;
+        }
+        if (!arch_tail_call_epilogue(epilogue, cleanup) ||
+            epilogueWritesLiveRegs(epilogue, cleanup)) {
+            return 0;
+        }
+        /*
+         * The called function will see a different stack pointer, at least
+         * the return address of our caller instead of ours.
+         */
+        if (mayAccessCallerStack(*call->getCallEdge())) {
+            return 0;
+        }
+
+        drob_debug("Call %p (%p): converting into tail call", call,
+                   call->getStartAddr());
+        tailCalls.push_back({ block, call, std::move(epilogue),
+                              std::move(cleanup) });
+        return 0;
+    }
+
+    int handleFunction(Function *function)
+    {
+        /* We might only have data for the entry function */
+        if (unlikely(!function->stackAnalysisValid ||
+                     !function->livenessAnalysisValid))
+            return 0;
+        function->for_each_block_any(this);
+        return 0;
+    }
+
+    bool run(void)
+    {
+        icfg.for_each_function_any(this);
+
+        for (auto & tailCall : tailCalls) {
+            tailCall.block->insertInstructions(tailCall.call, tailCall.cleanup);
+            for (auto & instr : tailCall.epilogue) {
+                tailCall.block->removeInstruction(instr);
+            }
+            tailCall.call->setTailCall(true);
+        }
+        tailCalls.clear();
+        return false;
+    }
+private:
+    typedef struct TailCall {
+        SuperBlock *block;
+        Instruction *call;
+        std::vector<Instruction *> epilogue;
+        std::list<std::unique_ptr<Instruction>> cleanup;
+    } TailCall;
+
+    std::vector<TailCall> tailCalls;
+    /* stack offset of the first byte above the return address */
+    int64_t stackLimit;
+
+    /*
+     * The epilogue is dropped and only the cleanup is performed (before the
+     * call). Registers the epilogue writes (e.g. eflags when releasing the
+     * stack frame) that are not restored by the cleanup will contain what
+     * the called function left behind and must therefore not be alive when
+     * returning.
+     */
+    bool epilogueWritesLiveRegs(const std::vector<Instruction *> &epilogue,
+                                const std::list<std::unique_ptr<Instruction>> &cleanup)
+    {
+        const LivenessData *livenessData = epilogue.back()->getLivenessData();
+        SubRegisterMask written;
+
+        if (!livenessData) {
+            return true;
+        }
+        written.zero();
+        for (auto & instr : epilogue) {
+            if (!instr->isRet()) {
+                written += instr->getInfo().writtenRegs;
+                written += instr->getInfo().condWrittenRegs;
+            }
+        }
+        for (auto & instr : cleanup) {
+            written -= instr->getInfo().writtenRegs;
+        }
+        written -= arch_get_register_info(Register::RSP)->full;
+        return !!(written & livenessData->live_in);
+    }
+
+    bool mayAccessCallerStack(const CallEdge &edge)
+    {
+        Function *callee = edge.dst;
+        const ProgramState *entryState;
+
+        if (!edge.state || !callee->stackAnalysisValid) {
+            return true;
+        }
+
+        /* All call sites have to agree on the stack pointer */
+        const DynamicValue rsp = edge.state->getRegister(Register::RSP);
+        entryState = callee->getEntryBlock()->getEntryState();
+        if (!rsp.isStackPtr() || !entryState ||
+            entryState->getRegister(Register::RSP) != rsp) {
+            return true;
+        }
+
+        /* edge.state is after the call, RSP points at the return address */
+        stackLimit = rsp.getPtrOffset() + 8;
+        return callee->for_each_instruction_any(this) != 0;
+    }
+};
+
+} /* namespace drob */
+
+#endif /* PASSES_TAIL_CALL_CONVERSION_PASS_HPP */
@@ -0,0 +1,369 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#ifndef PASSES_VALUE_NUMBERING_PASS_HPP
+#define PASSES_VALUE_NUMBERING_PASS_HPP
+
+#include <vector>
+#include <tuple>
+#include <unordered_map>
+#include "../Utils.hpp"
+#include "../Pass.hpp"
+#include "../NodeCallback.hpp"
+#include "../Instruction.hpp"
+#include "../arch.hpp"
+#include "../AliasInfo.hpp"
+
+namespace drob {
+
+/*
+ * Value numbering to remove redundant computations (e.g. the same LEA or load
+ * in unrolled loop iterations). We only care about instructions that compute
+ * a complete register (e.g. writing EAX or RAX, not AX) and don't have other
+ * alive outputs.
+ *
+ * Blocks are processed starting with the entry state computed by stack
+ * analysis. Two kinds of values are detected:
+ * - Known values (immediates, pointers), as computed by emulation. If the
+ *   register already contains the value, the instruction can be dropped. If
+ *   another register contains the value, it is copied.
+ * - Unknown values. Instructions with the same opcode and input operands
+ *   compute the same value, as long as none of their inputs (and the result)
+ *   have been modified in between. Loaded values survive memory writes that
+ *   can't alias (e.g. stores via other pointers than a restrict pointer).
+ *
+ * Unknown values are tracked within extended basic blocks: The expressions
+ * available at the end of a block (or at a branch) are forwarded to
+ * successors that have no other predecessors (and are therefore dominated
+ * by the block).
+ */
+class ValueNumberingPass : public Pass, public NodeCallback {
+public:
+    ValueNumberingPass(ICFG &icfg, BinaryPool &binaryPool,
+                       const RewriterCfg &cfg, const MemProtCache &memProtCache) :
+        Pass(icfg, binaryPool, cfg, memProtCache, "ValueNumbering",
+             "Remove redundant computations")
+    {
+    }
+
+    bool needsStackAnalysis(void)
+    {
+        /* We need the entry states of all blocks */
+        return true;
+    }
+
+    bool needsLivenessAnalysis(void)
+    {
+        /* We have to know if other outputs are alive */
+        return true;
+    }
+
+    static bool sameOperand(OperandType type, const StaticOperand &lhs,
+                            const StaticOperand &rhs)
+    {
+        switch (type) {
+        case OperandType::Register:
+            return lhs.reg == rhs.reg;
+        case OperandType::MemPtr:
+            if (lhs.mem.type != rhs.mem.type) {
+                return false;
+            } else if (lhs.mem.type == MemPtrType::Direct) {
+                return lhs.mem.addr.val == rhs.mem.addr.val &&
+                       lhs.mem.addr.usrPtrNr == rhs.mem.addr.usrPtrNr;
+            }
+            return lhs.mem.sib.base == rhs.mem.sib.base &&
+                   lhs.mem.sib.index == rhs.mem.sib.index &&
+                   lhs.mem.sib.scale == rhs.mem.sib.scale &&
+                   lhs.mem.sib.disp.val == rhs.mem.sib.disp.val &&
+                   lhs.mem.sib.disp.usrPtrNr == rhs.mem.sib.disp.usrPtrNr;
+        default:
+            /* immediates */
+            return lhs.imm.val == rhs.imm.val &&
+                   lhs.imm.usrPtrNr == rhs.imm.usrPtrNr;
+        }
+    }
+
+    /*
+     * Same opcode and same operands, ignoring the output (operand 0).
+     */
+    static bool sameComputation(const Instruction *lhs, const Instruction *rhs)
+    {
+        if (lhs->getOpcode() != rhs->getOpcode() ||
+            lhs->getNumOperands() != rhs->getNumOperands()) {
+            return false;
+        }
+        for (int i = 1; i < lhs->getNumOperands(); i++) {
+            if (!sameOperand(lhs->getOperandInfo(i)->type, lhs->getOperand(i),
+                             rhs->getOperand(i))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /*
+     * Get the register completely defined by the instruction, if any.
+     * Returns Register::None if the instruction is not a candidate.
+     */
+    static Register getResultRegister(Instruction *instruction)
+    {
+        const InstructionInfo &info = instruction->getInfo();
+        const LivenessData *livenessData;
+
+        if (info.nasty || instruction->isBranch() || instruction->isCall() ||
+            instruction->isRet() || instruction->getPredicate() ||
+            info.mayWriteMem || instruction->getNumOperands() < 1) {
+            return Register::None;
+        }
+
+        for (auto & operand : info.operands) {
+            if (operand.isImpl || operand.nr != 0) {
+                continue;
+            }
+            if (operand.type != OperandType::Register ||
+                operand.r.mode != AccessMode::Write) {
+                return Register::None;
+            }
+
+            const RegisterInfo *ri = arch_get_register_info(operand.r.reg);
+            Register reg = operand.r.reg;
+
+            if (operand.r.w == RegisterAccessType::FullZeroParent) {
+                reg = ri->parent;
+            } else if (operand.r.w != RegisterAccessType::Full ||
+                       ri->parent != Register::None) {
+                return Register::None;
+            }
+            if (arch_get_register_info(reg)->type != RegisterType::Gprs64) {
+                return Register::None;
+            }
+
+            /* All other outputs have to be dead */
+            SubRegisterMask others = info.writtenRegs;
+            others += info.condWrittenRegs;
+            others -= arch_get_register_info(reg)->full;
+            livenessData = instruction->getLivenessData();
+            if (!livenessData || !!(others & livenessData->live_out)) {
+                return Register::None;
+            }
+            return reg;
+        }
+        return Register::None;
+    }
+
+    static bool readsMemory(const Instruction *instruction)
+    {
+        for (auto & operand : instruction->getInfo().operands) {
+            if (operand.type == OperandType::MemPtr &&
+                operand.m.mode != AccessMode::None &&
+                operand.m.mode != AccessMode::Address) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /*
+     * Replace the instruction by a register copy or drop it.
+     */
+    void replace(SuperBlock *block, Instruction *instruction, Register dst,
+                 Register src)
+    {
+        if (dst != src) {
+            std::unique_ptr<Instruction> copy = arch_copy_register(dst, src);
+
+            if (!copy) {
+                return;
+            }
+            drob_info("Replacing instruction %p (%p) by a register copy",
+                      instruction, instruction->getStartAddr());
+            replacements.emplace_back(block, instruction, std::move(copy));
+        } else {
+            drob_info("Dropping redundant instruction %p (%p)", instruction,
+                      instruction->getStartAddr());
+            replacements.emplace_back(block, instruction, nullptr);
+        }
+    }
+
+    typedef struct Expression {
+        /* the instruction that computed the value */
+        Instruction *instruction;
+        /* the register that contains the value */
+        Register reg;
+        /* registers that must not be modified (inputs and the result) */
+        SubRegisterMask regs;
+        /* the value is invalidated by aliasing memory writes */
+        bool readsMemory;
+    } Expression;
+
+    static bool singlePredecessor(SuperBlock *block)
+    {
+        return block->getIncomingEdges().size() + (block->getPrev() ? 1 : 0) == 1;
+    }
+
+    int handleBlock(SuperBlock *block, Function *function)
+    {
+        std::vector<Expression> exprs;
+        (void)function;
+
+        if (!block->getEntryState()) {
+            /* Not executed or not analyzed */
+            return 0;
+        }
+        auto it = available.find(block);
+        if (it != available.end()) {
+            exprs = std::move(it->second);
+            available.erase(it);
+        }
+
+        ProgramState state = ProgramState(*block->getEntryState());
+        for (auto & instr : block->getInstructions()) {
+            const InstructionInfo &info = instr->getInfo();
+            const Register reg = getResultRegister(instr.get());
+            DynamicValue before[(int)Register::MAX];
+            bool replaced = false;
+
+            if (instr->isBranch() && instr->getBranchEdge() &&
+                singlePredecessor(instr->getBranchEdge()->dst)) {
+                available[instr->getBranchEdge()->dst] = exprs;
+            }
+
+            /* We don't model the effects of called functions */
+            if (instr->isCall() || instr->isRet()) {
+                return 0;
+            }
+
+            if (reg != Register::None) {
+                for (int i = 1; i < (int)Register::MAX; i++) {
+                    if (arch_get_register_info((Register)i)->type == RegisterType::Gprs64) {
+                        before[i] = state.getRegister((Register)i);
+                    }
+                }
+            }
+
+            instr->emulate(state, cfg, memProtCache, false);
+
+            if (reg != Register::None) {
+                const DynamicValue value = state.getRegister(reg);
+
+                if (value.isImm() || value.isPtr()) {
+                    /* Known value: is it already contained in a register? */
+                    if (before[(int)reg] == value) {
+                        replace(block, instr.get(), reg, reg);
+                        replaced = true;
+                    } else if (!value.isImm()) {
+                        for (int i = 1; i < (int)Register::MAX && !replaced; i++) {
+                            if (arch_get_register_info((Register)i)->type == RegisterType::Gprs64 &&
+                                before[i] == value) {
+                                replace(block, instr.get(), reg, (Register)i);
+                                replaced = true;
+                            }
+                        }
+                    }
+                } else {
+                    /* Unknown value: was it computed before? */
+                    for (auto & expr : exprs) {
+                        if (sameComputation(expr.instruction, instr.get())) {
+                            replace(block, instr.get(), reg, expr.reg);
+                            replaced = true;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            /* Invalidate all expressions that are affected by this instruction */
+            if (info.nasty) {
+                exprs.clear();
+            } else {
+                SubRegisterMask written = info.writtenRegs;
+
+                written += info.condWrittenRegs;
+                for (auto it = exprs.begin(); it != exprs.end();) {
+                    if (!!(it->regs & written) ||
+                        (info.mayWriteMem && it->readsMemory &&
+                         mayWriteAlias(*instr, *it->instruction, cfg))) {
+                        it = exprs.erase(it);
+                    } else {
+                        it++;
+                    }
+                }
+            }
+
+            if (reg != Register::None && !replaced) {
+                Expression expr = {
+                    .instruction = instr.get(),
+                    .reg = reg,
+                    .regs = info.readRegs,
+                    .readsMemory = readsMemory(instr.get()),
+                };
+
+                /* Instructions that modify their own input can't be reused */
+                if (!(expr.regs & arch_get_register_info(reg)->full)) {
+                    expr.regs += arch_get_register_info(reg)->full;
+                    exprs.push_back(expr);
+                }
+            }
+        }
+
+        if (block->getNext() && singlePredecessor(block->getNext())) {
+            available[block->getNext()] = exprs;
+        }
+        return 0;
+    }
+
+    int handleFunction(Function *function)
+    {
+        /* Predecessors are always processed before their successors */
+        function->for_each_block_dfs(this);
+        available.clear();
+        return 0;
+    }
+
+    bool run(void)
+    {
+        icfg.for_each_function_any(this);
+
+        for (auto & replacement : replacements) {
+            SuperBlock *block = std::get<0>(replacement);
+            Instruction *instr = std::get<1>(replacement);
+            std::unique_ptr<Instruction> &copy = std::get<2>(replacement);
+
+            if (copy) {
+                instr->setOpcode(copy->getOpcode());
+                for (int i = 0; i < copy->getNumOperands(); i++) {
+                    StaticOperand operand = copy->getOperand(i);
+
+                    instr->setOperand(i, operand);
+                }
+                block->invalidateLivenessAnalysis();
+                block->invalidateStackAnalysis();
+            } else {
+                block->removeInstruction(instr);
+            }
+        }
+        replacements.clear();
+        return false;
+    }
+private:
+    /* expressions available when entering a block */
+    std::unordered_map<SuperBlock *, std::vector<Expression>> available;
+    /* instructions to drop/replace */
+    std::vector<std::tuple<SuperBlock *, Instruction *, std::unique_ptr<Instruction>>> replacements;
+};
+
+} /* namespace drob */
+
+#endif /* PASSES_VALUE_NUMBERING_PASS_HPP */
@@ -442,6 +442,25 @@ static void translatePtr(const drob_param_cfg &param, RewriterCfg &cfg,
     ptrCfg.align = param.ptr_align;
 }
 
+static const Register callee_saved_regs[6] {
+    Register::RBX,
+    Register::RBP,
+    Register::R12,
+    Register::R13,
+    Register::R14,
+    Register::R15,
+};
+
+bool arch_is_callee_saved(Register reg)
+{
+    for (unsigned int i = 0; i < ARRAY_SIZE(callee_saved_regs); i++) {
+        if (callee_saved_regs[i] == reg) {
+            return true;
+        }
+    }
+    return false;
+}
+
 /*
  * On Linux, AMD64 System V ABI applies to our entry function.
  */
@@ -475,18 +494,10 @@ void arch_translate_cfg(const drob_cfg &drob_cfg, RewriterCfg &cfg)
     entryState->setRegister(Register::RSP, DynamicValue(DynamicValueType::StackPtr, 0, 0));
 
     /* mark callee-saved registers */
-    entrySpec->reg.preserved += getSubRegisterMask(Register::RBX);
-    entryState->setRegister(Register::RBX, DynamicValueType::Unknown);
-    entrySpec->reg.preserved += getSubRegisterMask(Register::RBP);
-    entryState->setRegister(Register::RBP, DynamicValueType::Unknown);
-    entrySpec->reg.preserved += getSubRegisterMask(Register::R12);
-    entryState->setRegister(Register::R12, DynamicValueType::Unknown);
-    entrySpec->reg.preserved += getSubRegisterMask(Register::R13);
-    entryState->setRegister(Register::R13, DynamicValueType::Unknown);
-    entrySpec->reg.preserved += getSubRegisterMask(Register::R14);
-    entryState->setRegister(Register::R14, DynamicValueType::Unknown);
-    entrySpec->reg.preserved += getSubRegisterMask(Register::R15);
-    entryState->setRegister(Register::R15, DynamicValueType::Unknown);
+    for (i = 0; i < (int)ARRAY_SIZE(callee_saved_regs); i++) {
+        entrySpec->reg.preserved += getSubRegisterMask(callee_saved_regs[i]);
+        entryState->setRegister(callee_saved_regs[i], DynamicValueType::Unknown);
+    }
     /* fixme: direction flag, mxcsr */
 
     if (unlikely(loglevel >= DROB_LOGLEVEL_DEBUG)) {
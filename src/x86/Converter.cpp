@@ -13,11 +13,17 @@
  * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
  * in the COPYING.LESSER files in the top-level directory for more details.
  */
+#include <cassert>
+#include <cstdlib>
+#include <unistd.h>
+
 #include "../Instruction.hpp"
 #include "../RewriterCfg.hpp"
 #include "OpcodeInfo.hpp"
 #include "Converter.hpp"
 
+extern "C" void __stack_chk_fail(void) __attribute__((noreturn));
+
 namespace drob {
 
 static inline const OpcodeInfo *getOpcodeInfo(Opcode oc)
@@ -281,6 +287,17 @@ static bool is_memop(const xed_decoded_inst_t &xedd, int opidx)
            op_name == XED_OPERAND_MEM1;
 }
 
+static bool is_explicit(const xed_decoded_inst_t &xedd, unsigned int opidx)
+{
+    const xed_inst_t *xi = xed_decoded_inst_inst(&xedd);
+
+    if (opidx >= xed_inst_noperands(xi)) {
+        return false;
+    }
+    return xed_operand_operand_visibility(xed_inst_operand(xi, opidx)) ==
+           XED_OPVIS_EXPLICIT;
+}
+
 static void translate_mr(const xed_decoded_inst_t &xedd, ExplicitStaticOperands *operands)
 {
     translate_memop(xedd, 0, operands->op[0]);
@@ -507,6 +524,81 @@ static const OpcodeInfo *convert_cmp(const xed_decoded_inst_t &xedd,
     }
 }
 
+static const OpcodeInfo *convert_div(const xed_decoded_inst_t &xedd,
+                     Opcode *opcode, ExplicitStaticOperands *operands)
+{
+    switch (xed_decoded_inst_get_operand_width(&xedd)) {
+    case 32:
+        return convert_m_r(xedd, opcode, operands, Opcode::DIV32m,
+                           Opcode::DIV32r);
+    case 64:
+        return convert_m_r(xedd, opcode, operands, Opcode::DIV64m,
+                           Opcode::DIV64r);
+    default:
+        return nullptr;
+    }
+}
+
+static const OpcodeInfo *convert_idiv(const xed_decoded_inst_t &xedd,
+                      Opcode *opcode, ExplicitStaticOperands *operands)
+{
+    switch (xed_decoded_inst_get_operand_width(&xedd)) {
+    case 32:
+        return convert_m_r(xedd, opcode, operands, Opcode::IDIV32m,
+                           Opcode::IDIV32r);
+    case 64:
+        return convert_m_r(xedd, opcode, operands, Opcode::IDIV64m,
+                           Opcode::IDIV64r);
+    default:
+        return nullptr;
+    }
+}
+
+static const OpcodeInfo *convert_imul_rmi_rri(const xed_decoded_inst_t &xedd,
+                          Opcode *opcode, ExplicitStaticOperands *operands,
+                          Opcode rmi, Opcode rri)
+{
+    translate_regop(xedd, 0, operands->op[0]);
+    translate_imm(xedd, operands->op[2]);
+    if (is_memop(xedd, 1)) {
+        translate_memop(xedd, 0, operands->op[1]);
+        *opcode = rmi;
+        return getOpcodeInfo(rmi);
+    }
+    translate_regop(xedd, 1, operands->op[1]);
+    *opcode = rri;
+    return getOpcodeInfo(rri);
+}
+
+static const OpcodeInfo *convert_imul(const xed_decoded_inst_t &xedd,
+                      Opcode *opcode, ExplicitStaticOperands *operands)
+{
+    switch (xed_decoded_inst_get_operand_width(&xedd)) {
+    case 32:
+        if (!is_explicit(xedd, 1)) {
+            return convert_m_r(xedd, opcode, operands, Opcode::IMUL32m,
+                               Opcode::IMUL32r);
+        } else if (has_imm(xedd)) {
+            return convert_imul_rmi_rri(xedd, opcode, operands,
+                                        Opcode::IMUL32rmi, Opcode::IMUL32rri);
+        }
+        return convert_rm_rr(xedd, opcode, operands, Opcode::IMUL32rm,
+                             Opcode::IMUL32rr);
+    case 64:
+        if (!is_explicit(xedd, 1)) {
+            return convert_m_r(xedd, opcode, operands, Opcode::IMUL64m,
+                               Opcode::IMUL64r);
+        } else if (has_imm(xedd)) {
+            return convert_imul_rmi_rri(xedd, opcode, operands,
+                                        Opcode::IMUL64rmi, Opcode::IMUL64rri);
+        }
+        return convert_rm_rr(xedd, opcode, operands, Opcode::IMUL64rm,
+                             Opcode::IMUL64rr);
+    default:
+        return nullptr;
+    }
+}
+
 static const OpcodeInfo *convert_jcc(const xed_decoded_inst_t &xedd,
                                      Opcode *opcode, ExplicitStaticOperands *operands)
 {
@@ -631,6 +723,21 @@ static const OpcodeInfo *convert_movups(const xed_decoded_inst_t &xedd,
                 Opcode::MOVUPSrm, Opcode::MOVUPSrr);
 }
 
+static const OpcodeInfo *convert_mul(const xed_decoded_inst_t &xedd,
+                     Opcode *opcode, ExplicitStaticOperands *operands)
+{
+    switch (xed_decoded_inst_get_operand_width(&xedd)) {
+    case 32:
+        return convert_m_r(xedd, opcode, operands, Opcode::MUL32m,
+                           Opcode::MUL32r);
+    case 64:
+        return convert_m_r(xedd, opcode, operands, Opcode::MUL64m,
+                           Opcode::MUL64r);
+    default:
+        return nullptr;
+    }
+}
+
 static const OpcodeInfo *convert_mulpd(const xed_decoded_inst_t &xedd,
                        Opcode *opcode, ExplicitStaticOperands *operands)
 {
@@ -823,6 +930,12 @@ static const OpcodeInfo *convert_simple(const xed_decoded_inst_t &xedd,
         return convert_call(xedd, opcode, operands);
     case XED_ICLASS_CMP:
         return convert_cmp(xedd, opcode, operands);
+    case XED_ICLASS_DIV:
+        return convert_div(xedd, opcode, operands);
+    case XED_ICLASS_IDIV:
+        return convert_idiv(xedd, opcode, operands);
+    case XED_ICLASS_IMUL:
+        return convert_imul(xedd, opcode, operands);
     case XED_ICLASS_JNBE:
     case XED_ICLASS_JNB:
     case XED_ICLASS_JB:
@@ -855,6 +968,8 @@ static const OpcodeInfo *convert_simple(const xed_decoded_inst_t &xedd,
         return convert_movupd(xedd, opcode, operands);
     case XED_ICLASS_MOVUPS:
         return convert_movups(xedd, opcode, operands);
+    case XED_ICLASS_MUL:
+        return convert_mul(xedd, opcode, operands);
     case XED_ICLASS_MULPD:
         return convert_mulpd(xedd, opcode, operands);
     case XED_ICLASS_MULSD:
@@ -980,6 +1095,84 @@ static DecodeRet convert_loop(const xed_decoded_inst_t &xedd,
     return DecodeRet::EOB;
 }
 
+/*
+ * Library functions that never return. Compilers place calls to them at the
+ * very end of a function, followed by padding or the next function.
+ */
+static const void *const noreturn_functions[] = {
+    (const void *)abort,
+    (const void *)exit,
+    (const void *)_exit,
+    (const void *)__assert_fail,
+    (const void *)__stack_chk_fail,
+};
+
+/*
+ * Follow a PLT entry ("jmp *got(%rip)", eventually behind an endbr64) to
+ * the function it jumps to. With lazy binding, this is not the final
+ * function but the resolver.
+ */
+static const uint8_t *resolve_plt(const uint8_t *itext)
+{
+    xed_decoded_inst_t xedd;
+    StaticOperand op;
+
+    for (int i = 0; i < 2; i++) {
+        xed_decoded_inst_zero(&xedd);
+        xed_decoded_inst_set_mode(&xedd, XED_MACHINE_MODE_LONG_64,
+                                  XED_ADDRESS_WIDTH_64b);
+        if (xed_decode(&xedd, itext, ARCH_MAX_ILEN) != XED_ERROR_NONE) {
+            return itext;
+        }
+
+        switch (xed_decoded_inst_get_iclass(&xedd)) {
+        case XED_ICLASS_ENDBR64:
+            itext += xed_decoded_inst_get_length(&xedd);
+            break;
+        case XED_ICLASS_JMP:
+            if (xed_decoded_inst_number_of_memory_operands(&xedd) != 1 ||
+                xed_decoded_inst_get_base_reg(&xedd, 0) != XED_REG_RIP) {
+                return itext;
+            }
+            translate_memop(xedd, 0, op);
+            return *(const uint8_t * const *)op.mem.addr.val;
+        default:
+            return itext;
+        }
+    }
+    return itext;
+}
+
+/*
+ * Check if the call targets one of the known noreturn functions, either
+ * directly, via the PLT or via the GOT.
+ */
+static bool is_noreturn_call(Opcode opcode, const ExplicitStaticOperands &operands)
+{
+    const uint8_t *target;
+
+    switch (opcode) {
+    case Opcode::CALLa:
+        target = resolve_plt((const uint8_t *)operands.op[0].mem.addr.val);
+        break;
+    case Opcode::CALLm:
+        if (operands.op[0].mem.type != MemPtrType::Direct) {
+            return false;
+        }
+        target = *(const uint8_t * const *)operands.op[0].mem.addr.val;
+        break;
+    default:
+        return false;
+    }
+
+    for (auto function : noreturn_functions) {
+        if (target == function) {
+            return true;
+        }
+    }
+    return false;
+}
+
 DecodeRet convert_decoded(const xed_decoded_inst_t &xedd,
                           std::list<std::unique_ptr<Instruction>> &instrs,
                           const RewriterCfg &cfg)
@@ -1004,8 +1197,9 @@ DecodeRet convert_decoded(const xed_decoded_inst_t &xedd,
                 drob_throw("Unmodelled instruction detected");
             }
             if (reencode) {
-                drob_throw("RIP-relative addressing is not supported"
-                           " for unmodelled instructions");
+                drob_info("RIP-relative addressing is not supported"
+                          " for unmodelled instructions");
+                return DecodeRet::UnsupportedInstr;
             }
             opcode = Opcode::NONE;
         }
@@ -1014,16 +1208,28 @@ DecodeRet convert_decoded(const xed_decoded_inst_t &xedd,
                                                           opcodeInfo, reencode));
 
         switch (xed_decoded_inst_get_category(&xedd)) {
-        case XED_CATEGORY_CALL:
         case XED_CATEGORY_UNCOND_BR:
         case XED_CATEGORY_RET:
             if (!opcodeInfo) {
-                drob_throw("Unhandled control flow instruction.");
+                drob_info("Unhandled control flow instruction");
+                return DecodeRet::UnhandledInstr;
             }
             return DecodeRet::EOB;
+        case XED_CATEGORY_CALL:
+            if (!opcodeInfo) {
+                drob_info("Unhandled control flow instruction");
+                return DecodeRet::UnhandledInstr;
+            }
+            /* don't decode whatever follows a call that never returns */
+            if (is_noreturn_call(opcode, operands)) {
+                return DecodeRet::EOB;
+            }
+            /* execution continues after the call returned */
+            return DecodeRet::Ok;
         case XED_CATEGORY_COND_BR:
             if (!opcodeInfo) {
-                drob_throw("Unhandled control flow instruction.");
+                drob_info("Unhandled control flow instruction");
+                return DecodeRet::UnhandledInstr;
             }
             return DecodeRet::Ok;
         default:
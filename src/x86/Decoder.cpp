@@ -37,7 +37,7 @@ void drob::arch_teardown(void)
 {
 }
 
-static void check_segment_override(xed_decoded_inst_t &xedd)
+static bool has_segment_override(xed_decoded_inst_t &xedd)
 {
     int memops = xed_decoded_inst_number_of_memory_operands(&xedd);
     xed_reg_enum_t seg;
@@ -49,9 +49,11 @@ static void check_segment_override(xed_decoded_inst_t &xedd)
     for(int i = 0; i < memops; i++) {
         seg = xed_decoded_inst_get_seg_reg(&xedd ,i);
         if (seg != XED_REG_INVALID) {
-            drob_throw("Segment override is not supported");
+            drob_info("Segment override is not supported");
+            return true;
         }
     }
+    return false;
 }
 
 DecodeRet drob::arch_decode_one(const uint8_t **itext, uint16_t max_ilen,
@@ -78,7 +80,9 @@ DecodeRet drob::arch_decode_one(const uint8_t **itext, uint16_t max_ilen,
     *itext += ilen;
 
     /* for now, segment override is not supported */
-    check_segment_override(xedd);
+    if (has_segment_override(xedd)) {
+        return DecodeRet::UnsupportedInstr;
+    }
 
     /* drop NOPs, we will regenerate if necessary */
     switch (xed_decoded_inst_get_category(&xedd)) {
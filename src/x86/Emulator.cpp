@@ -15,6 +15,7 @@
  */
 #include "../arch.hpp"
 #include "../InstructionInfo.hpp"
+#include "../RewriterCfg.hpp"
 #include "Emulator.hpp"
 #include "x86.hpp"
 
@@ -34,17 +35,140 @@ typedef struct Eflags {
     uint8_t of : 1;
 } Eflags;
 
+static inline void readEflags(Eflags &eflags)
+{
+    uint16_t flags;
+
+    asm volatile ("     lahf\n"
+                  "     seto %%al\n"
+                  : "=a"(flags)
+                  :: "memory" );
+    eflags.cf = (flags >> 8) & 1;
+    eflags.pf = (flags >> 10) & 1;
+    eflags.af = (flags >> 12) & 1;
+    eflags.zf = (flags >> 14) & 1;
+    eflags.sf = (flags >> 15) & 1;
+    eflags.of = flags & 1;
+    drob_assert(flags & 0x200);
+}
+
+typedef enum class EflagsOp : uint8_t {
+    Add,
+    Sub,
+    And,
+    Xor,
+    Shl,
+    Shr,
+} EflagsOp;
+
+/*
+ * Semantic kernels. Each operation is defined exactly once and instantiated
+ * for all operand sizes (T) by the compiler. The result is calculated in C,
+ * the eflags by executing the operation on the host (the operand size is
+ * derived by the assembler from the registers used).
+ */
+template <EflagsOp OP, typename T>
+struct Kernel;
+
+#define DEF_KERNEL(_OP, _INSN, _RESULT) \
+template <typename T> \
+struct Kernel<EflagsOp::_OP, T> { \
+    static inline T result(T a, T b) \
+    { \
+        return _RESULT; \
+    } \
+    static void eflags(uint64_t a64, uint64_t b64, Eflags &eflags) \
+    { \
+        T a = a64, b = b64; \
+\
+        asm volatile ("     " _INSN " %[in], %[inout]\n" \
+                      : [inout] "+r" (a) \
+                      : [in] "r" (b) \
+                      : "memory" ); \
+        readEflags(eflags); \
+    } \
+};
+
+/* the count is masked to 5 bits (6 bits for 64bit operands) by the hardware */
+#define DEF_SH_KERNEL(_OP, _INSN, _SHIFT_OP) \
+template <typename T> \
+struct Kernel<EflagsOp::_OP, T> { \
+    static inline T result(T a, T b) \
+    { \
+        return a _SHIFT_OP (b & (sizeof(T) == 8 ? 0x3f : 0x1f)); \
+    } \
+    static void eflags(uint64_t a64, uint64_t b64, Eflags &eflags) \
+    { \
+        T a = a64; \
+        uint8_t shift = b64; \
+\
+        asm volatile ("     " _INSN " %[shift], %[inout]\n" \
+                      : [inout] "+r" (a) \
+                      : [shift] "c" (shift) \
+                      : "memory" ); \
+        readEflags(eflags); \
+    } \
+};
+
+DEF_KERNEL(Add, "add", a + b)
+DEF_KERNEL(Sub, "sub", a - b)
+DEF_KERNEL(And, "and", a & b)
+DEF_KERNEL(Xor, "xor", a ^ b)
+DEF_SH_KERNEL(Shl, "shl", <<)
+DEF_SH_KERNEL(Shr, "shr", >>)
+
+/*
+ * Most eflags written by instructions are never read (e.g. each ADD/SUB
+ * overwrites all eflags). Instead of always calculating them, only remember
+ * the operation and the inputs. The eflags are calculated (by executing the
+ * operation on the host) only if at least one of them will actually be read,
+ * e.g. by a predicate.
+ */
+typedef struct LazyEflags {
+    void (*calculate)(uint64_t a, uint64_t b, Eflags &eflags);
+    uint64_t a;
+    uint64_t b;
+} LazyEflags;
+
+template <EflagsOp OP, typename T>
+static inline LazyEflags lazyEflags(T a, T b)
+{
+    return LazyEflags{ Kernel<OP, T>::eflags, a, b };
+}
+
 static void setEflags(DynamicInstructionInfo& dynInfo, int startIdx,
-                      Eflags &eflags)
+                      const LazyEflags &lazy)
 {
-    drob_assert(dynInfo.operands[startIdx].type == OperandType::Register);
-    drob_assert(dynInfo.operands[startIdx].regAcc.reg == Register::CF);
-    dynInfo.operands[startIdx++].output = DynamicValue(eflags.cf);
-    dynInfo.operands[startIdx++].output = DynamicValue(eflags.pf);
-    dynInfo.operands[startIdx++].output = DynamicValue(eflags.af);
-    dynInfo.operands[startIdx++].output = DynamicValue(eflags.zf);
-    dynInfo.operands[startIdx++].output = DynamicValue(eflags.sf);
-    dynInfo.operands[startIdx++].output = DynamicValue(eflags.of);
+    DynamicOperandInfo *flags = &dynInfo.operands[startIdx];
+    Eflags eflags;
+    int i;
+
+    drob_assert(flags[0].type == OperandType::Register);
+    drob_assert(flags[0].regAcc.reg == Register::CF);
+
+    for (i = 0; i < 6; i++) {
+        if (!flags[i].isDeadOutput) {
+            break;
+        }
+    }
+    /* Nobody will read the eflags, leave them unknown */
+    if (i == 6) {
+        return;
+    }
+
+    lazy.calculate(lazy.a, lazy.b, eflags);
+    if (!flags[0].isDeadOutput)
+        flags[0].output = DynamicValue((uint8_t)eflags.cf);
+    if (!flags[1].isDeadOutput)
+        flags[1].output = DynamicValue((uint8_t)eflags.pf);
+    if (!flags[2].isDeadOutput)
+        flags[2].output = DynamicValue((uint8_t)eflags.af);
+    if (!flags[3].isDeadOutput)
+        flags[3].output = DynamicValue((uint8_t)eflags.zf);
+    if (!flags[4].isDeadOutput)
+        flags[4].output = DynamicValue((uint8_t)eflags.sf);
+    if (!flags[5].isDeadOutput)
+        flags[5].output = DynamicValue((uint8_t)eflags.of);
 }
 
 static void setAF(DynamicInstructionInfo& dynInfo, int idx, const DynamicValue &data)
@@ -68,70 +192,74 @@ static void setOF(DynamicInstructionInfo& dynInfo, int idx, const DynamicValue &
     dynInfo.operands[idx].output = data;
 }
 
-static inline void readEflags(Eflags &eflags)
+static void setZF(DynamicInstructionInfo& dynInfo, int idx, const DynamicValue &data)
 {
-    uint16_t flags;
+    drob_assert(dynInfo.operands[idx].type == OperandType::Register);
+    drob_assert(dynInfo.operands[idx].regAcc.reg == Register::ZF);
+    dynInfo.operands[idx].output = data;
+}
 
-    asm volatile ("     lahf\n"
-                  "     seto %%al\n"
-                  : "=a"(flags)
-                  :: "memory" );
-    eflags.cf = (flags >> 8) & 1;
-    eflags.pf = (flags >> 10) & 1;
-    eflags.af = (flags >> 12) & 1;
-    eflags.zf = (flags >> 14) & 1;
-    eflags.sf = (flags >> 15) & 1;
-    eflags.of = flags & 1;
-    drob_assert(flags & 0x200);
+/*
+ * Convert user pointers with a known value into immediates, so they can
+ * be used for comparisons.
+ */
+static DynamicValue ptrToImm(const DynamicValue &val, const RewriterCfg &cfg)
+{
+    uint64_t ptrVal;
+
+    if (val.isUsrPtr() && ptrToInt(val, cfg, &ptrVal)) {
+        return DynamicValue(ptrVal);
+    }
+    return val;
 }
 
-#define GEN_ADD(BITS, C) \
-static inline uint##BITS##_t add##BITS(uint##BITS##_t a, uint##BITS##_t b, \
-                                       Eflags &eflags) \
-{ \
-    asm volatile ("     add" #C " %[in], %[inout]\n" \
-                  : [inout] "+g" (a) \
-                  : [in] "r" (b) \
-                  : "memory" ); \
-    readEflags(eflags); \
-    return a; \
-}
-GEN_ADD(8, b)
-GEN_ADD(16, w)
-GEN_ADD(32, l)
-GEN_ADD(64, q)
-
-#define GEN_EMULATE_ADD(BITS) \
-DEF_EMULATE_FN(add##BITS) \
-{ \
-    DynamicOperandInfo &inout = dynInfo.operands[0]; \
-    DynamicOperandInfo &in = dynInfo.operands[1]; \
-    Eflags eflags; \
-\
-    inout.output = add##BITS(inout.input.getImm64(), in.input.getImm64(), eflags);\
-    setEflags(dynInfo, 2, eflags); \
-    return EmuRet::Ok;\
+/*
+ * A user pointer that is never NULL. Only the pointer itself is known to be
+ * non-NULL: with an offset, the value could (in theory) wrap around to 0.
+ */
+static bool isNotNullPtr(const DynamicValue &val, const RewriterCfg &cfg)
+{
+    return val.isUsrPtr() && !val.getPtrOffset() &&
+           cfg.getUsrPtrCfg(val.getNr()).isNotNull;
 }
-GEN_EMULATE_ADD(8)
-GEN_EMULATE_ADD(16)
-GEN_EMULATE_ADD(32)
 
-DEF_EMULATE_FN(add64)
+/*
+ * Emulation kernels, shared by all operand sizes / operand forms of an
+ * instruction. They are instantiated below via GEN_EMULATE_FN().
+ */
+
+/* "a = a OP b", all inputs are immediates (OfEmuImm) */
+template <EflagsOp OP, typename T>
+static inline EmuRet emulateBinaryOp(DynamicInstructionInfo &dynInfo)
+{
+    DynamicOperandInfo &inout = dynInfo.operands[0];
+    DynamicOperandInfo &in = dynInfo.operands[1];
+    const T a = inout.input.getImm64();
+    const T b = in.input.getImm64();
+
+    inout.output = Kernel<OP, T>::result(a, b);
+    setEflags(dynInfo, 2, lazyEflags<OP, T>(a, b));
+    return EmuRet::Ok;
+}
+
+/* "a = a OP b", inputs are immediates or pointers (OfEmuPtr) */
+template <EflagsOp OP, typename T>
+static inline EmuRet emulatePtrBinaryOp(DynamicInstructionInfo &dynInfo)
 {
     DynamicOperandInfo &inout = dynInfo.operands[0];
     DynamicOperandInfo &in = dynInfo.operands[1];
-    Eflags eflags;
 
     /* Outputs (and therefore flags) are marked as unknown as default */
     if (inout.input.isImm() && in.input.isImm()) {
-        inout.output = add64(inout.input.getImm64(), in.input.getImm64(), eflags);
-        setEflags(dynInfo, 2, eflags);
+        return emulateBinaryOp<OP, T>(dynInfo);
     } else if (inout.input.isPtr() && in.input.isImm()) {
-        int64_t offs = add64(inout.input.getPtrOffset(), in.input.getImm64(), eflags);
+        int64_t offs = Kernel<OP, T>::result(inout.input.getPtrOffset(),
+                                             in.input.getImm64());
 
         inout.output = DynamicValue(inout.input.getType(), inout.input.getNr(), offs);
-    } else if (in.input.isPtr() && inout.input.isImm()) {
-        int64_t offs = add64(in.input.getPtrOffset(), inout.input.getImm64(), eflags);
+    } else if (OP == EflagsOp::Add && in.input.isPtr() && inout.input.isImm()) {
+        int64_t offs = Kernel<OP, T>::result(in.input.getPtrOffset(),
+                                             inout.input.getImm64());
 
         inout.output = DynamicValue(in.input.getType(), in.input.getNr(), offs);
     } else if (inout.input.isStackPtr() || in.input.isStackPtr()) {
@@ -142,6 +270,186 @@ DEF_EMULATE_FN(add64)
     return EmuRet::Ok;
 }
 
+/* "a OP b", only eflags are written, all inputs are immediates (OfEmuImm) */
+template <EflagsOp OP, typename T>
+static inline EmuRet emulateCompareOp(DynamicInstructionInfo &dynInfo)
+{
+    DynamicOperandInfo &in0 = dynInfo.operands[0];
+    DynamicOperandInfo &in1 = dynInfo.operands[1];
+
+    setEflags(dynInfo, 2, lazyEflags<OP, T>(in0.input.getImm64(),
+                                            in1.input.getImm64()));
+    return EmuRet::Ok;
+}
+
+/* "a & b", only eflags are written, CF and OF are always cleared (OfEmuFull) */
+template <typename T>
+static inline EmuRet emulateTestOp(DynamicInstructionInfo &dynInfo)
+{
+    DynamicOperandInfo &in0 = dynInfo.operands[0];
+    DynamicOperandInfo &in1 = dynInfo.operands[1];
+
+    if (in0.input.isImm() && in1.input.isImm()) {
+        emulateCompareOp<EflagsOp::And, T>(dynInfo);
+    }
+
+    /* the following flags don't depend on any input values */
+    setCF(dynInfo, 2, DynamicValue((uint8_t)0));
+    setAF(dynInfo, 4, DynamicValue(DynamicValueType::Unknown));
+    setOF(dynInfo, 7, DynamicValue((uint8_t)0));
+    return EmuRet::Ok;
+}
+
+/* "a = a OP count" (OfEmuFull) */
+template <EflagsOp OP, typename T>
+static inline EmuRet emulateShiftOp(DynamicInstructionInfo &dynInfo)
+{
+    DynamicOperandInfo &inout = dynInfo.operands[0];
+    DynamicOperandInfo &shift = dynInfo.operands[1];
+
+    if (inout.input.isImm() && shift.input.isImm()) {
+        emulateBinaryOp<OP, T>(dynInfo);
+    } else if (inout.input.isStackPtr()) {
+        inout.output = DynamicValue(DynamicValueType::Tainted);
+    } else if (inout.input.isPtr()) {
+        inout.output = DynamicValue(DynamicValueType::Unknown);
+    } else {
+        inout.output = inout.input;
+    }
+    /*
+     * TODO: we could make use of UsrPtr information here, e.g. shifting the
+     * actual pointer value.
+     */
+    if (!shift.input.isImm() || shift.input.getImm64() != 1) {
+        /* OF is undefined when not a 1-bit shift */
+        setOF(dynInfo, 7, DynamicValue(DynamicValueType::Unknown));
+    }
+    if (!shift.input.isImm() || shift.input.getImm64() >= sizeof(T) * 8) {
+        /* CF is undefined when count is greater or equal to size in bits */
+        setCF(dynInfo, 2, DynamicValue(DynamicValueType::Unknown));
+    }
+    /* AF is undefined  */
+    setAF(dynInfo, 4, DynamicValue(DynamicValueType::Unknown));
+
+    return EmuRet::Ok;
+}
+
+/*
+ * "RDX:RAX = RAX * src" (unsigned), all inputs are immediates (OfEmuImm).
+ * T is the operand type, W the type of the double-sized result.
+ */
+template <typename T, typename W>
+static inline EmuRet emulateMulOp(DynamicInstructionInfo &dynInfo)
+{
+    DynamicOperandInfo &src = dynInfo.operands[0];
+    DynamicOperandInfo &lo = dynInfo.operands[1];
+    DynamicOperandInfo &hi = dynInfo.operands[2];
+    const W result = (W)(T)lo.input.getImm64() * (T)src.input.getImm64();
+    const T high = result >> (sizeof(T) * 8);
+
+    lo.output = DynamicValue((T)result);
+    hi.output = DynamicValue(high);
+    /* CF and OF are set if the upper half is used, the others are undefined */
+    setCF(dynInfo, 3, DynamicValue((uint8_t)!!high));
+    setOF(dynInfo, 8, DynamicValue((uint8_t)!!high));
+    return EmuRet::Ok;
+}
+
+/*
+ * Signed multiplication, all inputs are immediates (OfEmuImm). Either
+ * "RDX:RAX = RAX * src", "a = a * b" or "a = b * imm", depending on the number
+ * of explicit operands. T is the unsigned operand type, S the signed operand
+ * type and W the signed type of the double-sized result.
+ */
+template <typename T, typename S, typename W>
+static inline EmuRet emulateImulOp(DynamicInstructionInfo &dynInfo)
+{
+    const int numOperands = arch_get_opcode_info(dynInfo.opcode)->numOperands;
+    int aIdx, bIdx, flagsIdx;
+
+    switch (numOperands) {
+    case 1:
+        aIdx = 1;
+        bIdx = 0;
+        flagsIdx = 3;
+        break;
+    case 2:
+        aIdx = 0;
+        bIdx = 1;
+        flagsIdx = 2;
+        break;
+    case 3:
+        aIdx = 1;
+        bIdx = 2;
+        flagsIdx = 3;
+        break;
+    default:
+        drob_assert_not_reached();
+    }
+
+    const W result = (W)(S)dynInfo.operands[aIdx].input.getImm64() *
+                     (S)dynInfo.operands[bIdx].input.getImm64();
+    /* CF and OF are set if the result was truncated */
+    const uint8_t truncated = result != (S)result;
+
+    if (numOperands == 1) {
+        dynInfo.operands[1].output = DynamicValue((T)result);
+        dynInfo.operands[2].output = DynamicValue((T)(result >> (sizeof(T) * 8)));
+    } else {
+        dynInfo.operands[0].output = DynamicValue((T)result);
+    }
+    /* SF, ZF, AF and PF are undefined */
+    setCF(dynInfo, flagsIdx, DynamicValue(truncated));
+    setOF(dynInfo, flagsIdx + 5, DynamicValue(truncated));
+    return EmuRet::Ok;
+}
+
+/*
+ * "RAX = RDX:RAX / src, RDX = RDX:RAX % src", all inputs are immediates
+ * (OfEmuImm). T is the unsigned operand type, S the (signed or unsigned)
+ * operand type and W the type of the double-sized dividend with the same
+ * signedness (UW being the unsigned variant). All eflags are undefined.
+ */
+template <typename T, typename S, typename UW, typename W>
+static inline EmuRet emulateDivOp(DynamicInstructionInfo &dynInfo)
+{
+    const unsigned int bits = sizeof(T) * 8;
+    DynamicOperandInfo &src = dynInfo.operands[0];
+    DynamicOperandInfo &lo = dynInfo.operands[1];
+    DynamicOperandInfo &hi = dynInfo.operands[2];
+    const W dividend = (W)(((UW)(T)hi.input.getImm64() << bits) |
+                           (T)lo.input.getImm64());
+    const W divisor = (S)src.input.getImm64();
+
+    /* Divide error (#DE), leave the outputs unknown */
+    if (!divisor) {
+        return EmuRet::Ok;
+    }
+    /* The quotient of MIN / -1 is not representable (signed only) */
+    if (divisor == (W)-1 && (UW)dividend == (UW)1 << (2 * bits - 1)) {
+        return EmuRet::Ok;
+    }
+
+    const W quotient = dividend / divisor;
+    if (quotient != (S)quotient) {
+        return EmuRet::Ok;
+    }
+    lo.output = DynamicValue((T)quotient);
+    hi.output = DynamicValue((T)(dividend % divisor));
+    return EmuRet::Ok;
+}
+
+#define GEN_EMULATE_FN(_NAME, _BITS, _KERNEL, ...) \
+DEF_EMULATE_FN(_NAME##_BITS) \
+{ \
+    return _KERNEL<__VA_ARGS__>(dynInfo); \
+}
+
+GEN_EMULATE_FN(add, 8, emulateBinaryOp, EflagsOp::Add, uint8_t)
+GEN_EMULATE_FN(add, 16, emulateBinaryOp, EflagsOp::Add, uint16_t)
+GEN_EMULATE_FN(add, 32, emulateBinaryOp, EflagsOp::Add, uint32_t)
+GEN_EMULATE_FN(add, 64, emulatePtrBinaryOp, EflagsOp::Add, uint64_t)
+
 static inline __uint128_t addpd(__uint128_t a,  __uint128_t b)
 {
     asm volatile ("     addpd %[in], %[inout]\n"
@@ -211,102 +519,53 @@ DEF_EMULATE_FN(mov)
     return EmuRet::Mov10;
 }
 
-static inline void cmp8(uint8_t a, uint8_t b, Eflags &eflags)
-{
-    asm volatile ("     cmpb %[in1], %[in0]\n"
-                  :
-                  : [in0] "g" (a),
-                    [in1] "r" (b)
-                  : "memory" );
-    readEflags(eflags);
-}
-
-DEF_EMULATE_FN(cmp8)
-{
-    DynamicOperandInfo &in0 = dynInfo.operands[0];
-    DynamicOperandInfo &in1 = dynInfo.operands[1];
-    Eflags eflags;
-
-    cmp8(in0.input.getImm64(), in1.input.getImm64(), eflags);
-    setEflags(dynInfo, 2, eflags);
-    return EmuRet::Ok;
-}
 
-static inline void cmp16(uint16_t a, uint16_t b, Eflags &eflags)
-{
-    asm volatile ("     cmpw %[in1], %[in0]\n"
-                  :
-                  : [in0] "g" (a),
-                    [in1] "r" (b)
-                  : "memory" );
-    readEflags(eflags);
-}
-
-DEF_EMULATE_FN(cmp16)
-{
-    DynamicOperandInfo &in0 = dynInfo.operands[0];
-    DynamicOperandInfo &in1 = dynInfo.operands[1];
-    Eflags eflags;
-
-    cmp16(in0.input.getImm64(), in1.input.getImm64(), eflags);
-    setEflags(dynInfo, 2, eflags);
-    return EmuRet::Ok;
-}
-
-static inline void cmp32(uint32_t a, uint32_t b, Eflags &eflags)
-{
-    asm volatile ("     cmpl %[in1], %[in0]\n"
-                  :
-                  : [in0] "g" (a),
-                    [in1] "r" (b)
-                  : "memory" );
-    readEflags(eflags);
-}
-
-DEF_EMULATE_FN(cmp32)
-{
-    DynamicOperandInfo &in0 = dynInfo.operands[0];
-    DynamicOperandInfo &in1 = dynInfo.operands[1];
-    Eflags eflags;
-
-    cmp32(in0.input.getImm64(), in1.input.getImm64(), eflags);
-    setEflags(dynInfo, 2, eflags);
-    return EmuRet::Ok;
-}
-
-static inline void cmp64(uint64_t a, uint64_t b, Eflags &eflags)
-{
-    asm volatile ("     cmpq %[in1], %[in0]\n"
-                  :
-                  : [in0] "g" (a),
-                    [in1] "r" (b)
-                  : "memory" );
-    readEflags(eflags);
-}
+GEN_EMULATE_FN(cmp, 8, emulateCompareOp, EflagsOp::Sub, uint8_t)
+GEN_EMULATE_FN(cmp, 16, emulateCompareOp, EflagsOp::Sub, uint16_t)
+GEN_EMULATE_FN(cmp, 32, emulateCompareOp, EflagsOp::Sub, uint32_t)
 
 DEF_EMULATE_FN(cmp64)
 {
     DynamicOperandInfo &in0 = dynInfo.operands[0];
     DynamicOperandInfo &in1 = dynInfo.operands[1];
-    Eflags eflags;
+    const DynamicValue a = ptrToImm(in0.input, cfg);
+    const DynamicValue b = ptrToImm(in1.input, cfg);
 
-    if (in0.input.isImm() && in1.input.isImm()) {
-        cmp64(in0.input.getImm64(), in1.input.getImm64(), eflags);
-        setEflags(dynInfo, 2, eflags);
+    if (a.isImm() && b.isImm()) {
+        setEflags(dynInfo, 2, lazyEflags<EflagsOp::Sub, uint64_t>(a.getImm64(),
+                                                                  b.getImm64()));
     } else if (in0.input.isPtr() && in1.input.isPtr() &&
                in0.input.getType() == in1.input.getType() &&
                in0.input.getNr() == in1.input.getNr()) {
         // FIXME will this result in the right values?
-        cmp64(in0.input.getPtrOffset(), in1.input.getPtrOffset(), eflags);
-        setEflags(dynInfo, 2, eflags);
+        setEflags(dynInfo, 2, lazyEflags<EflagsOp::Sub, uint64_t>(
+                                in0.input.getPtrOffset(),
+                                in1.input.getPtrOffset()));
+    } else if (isNotNullPtr(in0.input, cfg) && b.isImm() && !b.getImm64()) {
+        /* "cmp $0,%rdi": never equal, subtracting 0 never borrows */
+        setCF(dynInfo, 2, DynamicValue((uint8_t)0));
+        setZF(dynInfo, 5, DynamicValue((uint8_t)0));
+        setOF(dynInfo, 7, DynamicValue((uint8_t)0));
+    } else if (a.isImm() && !a.getImm64() && isNotNullPtr(in1.input, cfg)) {
+        /* "cmp %rdi,$0": never equal, always borrows */
+        setCF(dynInfo, 2, DynamicValue((uint8_t)1));
+        setZF(dynInfo, 5, DynamicValue((uint8_t)0));
     }
-    /*
-     * TODO: we could make use of UsrPtr information here, e.g. comparing a
-     * pointer against immediates/zero
-     */
     return EmuRet::Ok;
 }
 
+GEN_EMULATE_FN(div, 32, emulateDivOp, uint32_t, uint32_t, uint64_t, uint64_t)
+GEN_EMULATE_FN(div, 64, emulateDivOp, uint64_t, uint64_t, __uint128_t, __uint128_t)
+
+GEN_EMULATE_FN(idiv, 32, emulateDivOp, uint32_t, int32_t, uint64_t, int64_t)
+GEN_EMULATE_FN(idiv, 64, emulateDivOp, uint64_t, int64_t, __uint128_t, __int128_t)
+
+GEN_EMULATE_FN(imul, 32, emulateImulOp, uint32_t, int32_t, int64_t)
+GEN_EMULATE_FN(imul, 64, emulateImulOp, uint64_t, int64_t, __int128_t)
+
+GEN_EMULATE_FN(mul, 32, emulateMulOp, uint32_t, uint64_t)
+GEN_EMULATE_FN(mul, 64, emulateMulOp, uint64_t, __uint128_t)
+
 static inline __uint128_t mulpd(__uint128_t a,  __uint128_t b)
 {
     asm volatile ("     mulpd %[in], %[inout]\n"
@@ -412,305 +671,42 @@ DEF_EMULATE_FN(ret)
     return EmuRet::Ok;
 }
 
-static uint64_t shl64(uint64_t a, uint8_t shift, Eflags &eflags)
-{
-    asm volatile ("     shlq %[shift], %[inout]\n"
-                  : [inout] "+r" (a)
-                  : [shift] "c" (shift)
-                  : "memory" );
-    readEflags(eflags);
-
-    return a;
-}
-
-DEF_EMULATE_FN(shl64)
-{
-    DynamicOperandInfo &inout = dynInfo.operands[0];
-    DynamicOperandInfo &shift = dynInfo.operands[1];
-    Eflags eflags;
-
-    if (inout.input.isImm() && shift.input.isImm()) {
-        inout.output = shl64(inout.input.getImm64(), shift.input.getImm64(), eflags);
-        setEflags(dynInfo, 2, eflags);
-    } else if (inout.input.isStackPtr()) {
-        inout.output = DynamicValue(DynamicValueType::Tainted);
-    } else if (inout.input.isPtr()) {
-        inout.output = DynamicValue(DynamicValueType::Unknown);
-    } else {
-        inout.output = inout.input;
-    }
-    /*
-     * TODO: we could make use of UsrPtr information here, e.g. shifting the
-     * actual pointer value.
-     */
-    if (!shift.input.isImm() || shift.input.getImm64() != 1) {
-        /* OF is undefined when not a 1-bit shift */
-        setOF(dynInfo, 7, DynamicValue(DynamicValueType::Unknown));
-    }
-    if (!shift.input.isImm() || shift.input.getImm64() >= 64) {
-        /* CF is undefined when count is greater or equal to size in bits */
-        setCF(dynInfo, 2, DynamicValue(DynamicValueType::Unknown));
-    }
-    /* AF is undefined  */
-    setAF(dynInfo, 4, DynamicValue(DynamicValueType::Unknown));
 
-    return EmuRet::Ok;
-}
+GEN_EMULATE_FN(shl, 64, emulateShiftOp, EflagsOp::Shl, uint64_t)
+GEN_EMULATE_FN(shr, 64, emulateShiftOp, EflagsOp::Shr, uint64_t)
 
-static uint64_t shr64(uint64_t a, uint8_t shift, Eflags &eflags)
-{
-    asm volatile ("     shrq %[shift], %[inout]\n"
-                  : [inout] "+r" (a)
-                  : [shift] "c" (shift)
-                  : "memory" );
-    readEflags(eflags);
+GEN_EMULATE_FN(sub, 8, emulateBinaryOp, EflagsOp::Sub, uint8_t)
+GEN_EMULATE_FN(sub, 16, emulateBinaryOp, EflagsOp::Sub, uint16_t)
+GEN_EMULATE_FN(sub, 32, emulateBinaryOp, EflagsOp::Sub, uint32_t)
+GEN_EMULATE_FN(sub, 64, emulatePtrBinaryOp, EflagsOp::Sub, uint64_t)
 
-    return a;
-}
-
-DEF_EMULATE_FN(shr64)
-{
-    DynamicOperandInfo &inout = dynInfo.operands[0];
-    DynamicOperandInfo &shift = dynInfo.operands[1];
-    Eflags eflags;
-
-    if (inout.input.isImm() && shift.input.isImm()) {
-        inout.output = shr64(inout.input.getImm64(), shift.input.getImm64(), eflags);
-        setEflags(dynInfo, 2, eflags);
-    } else if (inout.input.isStackPtr()) {
-        inout.output = DynamicValue(DynamicValueType::Tainted);
-    } else if (inout.input.isPtr()) {
-        inout.output = DynamicValue(DynamicValueType::Unknown);
-    } else {
-        inout.output = inout.input;
-    }
-    /*
-     * TODO: we could make use of UsrPtr information here, e.g. shifting the
-     * actual pointer value.
-     */
-    if (!shift.input.isImm() || shift.input.getImm64() != 1) {
-        /* OF is undefined when not a 1-bit shift */
-        setOF(dynInfo, 7, DynamicValue(DynamicValueType::Unknown));
-    }
-    if (!shift.input.isImm() || shift.input.getImm64() >= 64) {
-        /* CF is undefined when count is greater or equal to size in bits */
-        setCF(dynInfo, 2, DynamicValue(DynamicValueType::Unknown));
-    }
-    /* AF is undefined  */
-    setAF(dynInfo, 4, DynamicValue(DynamicValueType::Unknown));
-
-    return EmuRet::Ok;
-}
-
-#define GEN_SUB(BITS, C) \
-static inline uint##BITS##_t sub##BITS(uint##BITS##_t a, uint##BITS##_t b, \
-                                       Eflags &eflags) \
-{ \
-    asm volatile ("     sub" #C " %[in], %[inout]\n" \
-                  : [inout] "+g" (a) \
-                  : [in] "r" (b) \
-                  : "memory" ); \
-    readEflags(eflags); \
-    return a; \
-}
-GEN_SUB(8, b)
-GEN_SUB(16, w)
-GEN_SUB(32, l)
-GEN_SUB(64, q)
-
-#define GEN_EMULATE_SUB(BITS) \
-DEF_EMULATE_FN(sub##BITS) \
-{ \
-    DynamicOperandInfo &inout = dynInfo.operands[0]; \
-    DynamicOperandInfo &in = dynInfo.operands[1]; \
-    Eflags eflags; \
-\
-    inout.output = sub##BITS(inout.input.getImm64(), in.input.getImm64(), eflags);\
-    setEflags(dynInfo, 2, eflags); \
-    return EmuRet::Ok;\
-}
-GEN_EMULATE_SUB(8)
-GEN_EMULATE_SUB(16)
-GEN_EMULATE_SUB(32)
-
-DEF_EMULATE_FN(sub64)
-{
-    DynamicOperandInfo &inout = dynInfo.operands[0];
-    DynamicOperandInfo &in = dynInfo.operands[1];
-    Eflags eflags;
-
-    /* Outputs (and therefore flags) are marked as unknown as default */
-    if (inout.input.isImm() && in.input.isImm()) {
-        inout.output = sub64(inout.input.getImm64(), in.input.getImm64(), eflags);
-        setEflags(dynInfo, 2, eflags);
-    } else if (inout.input.isPtr() && in.input.isImm()) {
-        int64_t offs = sub64(inout.input.getPtrOffset(), in.input.getImm64(), eflags);
-
-        inout.output = DynamicValue(inout.input.getType(), inout.input.getNr(), offs);
-    } else if (in.input.isPtr() && inout.input.isImm()) {
-        int64_t offs = sub64(in.input.getPtrOffset(), inout.input.getImm64(), eflags);
-
-        inout.output = DynamicValue(in.input.getType(), in.input.getNr(), offs);
-    } else if (inout.input.isStackPtr() || in.input.isStackPtr()) {
-        inout.output = DynamicValue(DynamicValueType::Tainted);
-    } else {
-        inout.output = DynamicValue(DynamicValueType::Unknown);
-    }
-    return EmuRet::Ok;
-}
-
-static inline void test8(uint8_t a, uint8_t b, Eflags &eflags)
-{
-    asm volatile ("     testb %[in1], %[in0]\n"
-                  :
-                  : [in0] "r" (a),
-                    [in1] "r" (b)
-                  : "memory" );
-    readEflags(eflags);
-}
-
-DEF_EMULATE_FN(test8)
-{
-    DynamicOperandInfo &in0 = dynInfo.operands[0];
-    DynamicOperandInfo &in1 = dynInfo.operands[1];
-    Eflags eflags;
-
-    if (in0.input.isImm() && in1.input.isImm()) {
-        test8(in0.input.getImm64(), in1.input.getImm64(), eflags);
-        setEflags(dynInfo, 2, eflags);
-    }
-    /* the following flags don't depend on any input values */
-    setCF(dynInfo, 2, DynamicValue((uint8_t)0));
-    setAF(dynInfo, 4, DynamicValue(DynamicValueType::Unknown));
-    setOF(dynInfo, 7, DynamicValue((uint8_t)0));
-    return EmuRet::Ok;
-}
-
-static inline void test16(uint16_t a, uint16_t b, Eflags &eflags)
-{
-    asm volatile ("     testw %[in1], %[in0]\n"
-                  :
-                  : [in0] "r" (a),
-                    [in1] "r" (b)
-                  : "memory" );
-    readEflags(eflags);
-}
-
-DEF_EMULATE_FN(test16)
-{
-    DynamicOperandInfo &in0 = dynInfo.operands[0];
-    DynamicOperandInfo &in1 = dynInfo.operands[1];
-    Eflags eflags;
-
-    if (in0.input.isImm() && in1.input.isImm()) {
-        test16(in0.input.getImm64(), in1.input.getImm64(), eflags);
-        setEflags(dynInfo, 2, eflags);
-    }
-    /* the following flags don't depend on any input values */
-    setCF(dynInfo, 2, DynamicValue((uint8_t)0));
-    setAF(dynInfo, 4, DynamicValue(DynamicValueType::Unknown));
-    setOF(dynInfo, 7, DynamicValue((uint8_t)0));
-    return EmuRet::Ok;
-}
-
-static inline void test32(uint32_t a, uint32_t b, Eflags &eflags)
-{
-    asm volatile ("     testl %[in1], %[in0]\n"
-                  :
-                  : [in0] "r" (a),
-                    [in1] "r" (b)
-                  : "memory" );
-    readEflags(eflags);
-}
-
-DEF_EMULATE_FN(test32)
-{
-    DynamicOperandInfo &in0 = dynInfo.operands[0];
-    DynamicOperandInfo &in1 = dynInfo.operands[1];
-    Eflags eflags;
-
-    if (in0.input.isImm() && in1.input.isImm()) {
-        test32(in0.input.getImm64(), in1.input.getImm64(), eflags);
-        setEflags(dynInfo, 2, eflags);
-    }
-    /* the following flags don't depend on any input values */
-    setCF(dynInfo, 2, DynamicValue((uint8_t)0));
-    setAF(dynInfo, 4, DynamicValue(DynamicValueType::Unknown));
-    setOF(dynInfo, 7, DynamicValue((uint8_t)0));
-    return EmuRet::Ok;
-}
-
-static inline void test64(uint64_t a, uint64_t b, Eflags &eflags)
-{
-    asm volatile ("     testq %[in1], %[in0]\n"
-                  :
-                  : [in0] "r" (a),
-                    [in1] "r" (b)
-                  : "memory" );
-    readEflags(eflags);
-}
+GEN_EMULATE_FN(test, 8, emulateTestOp, uint8_t)
+GEN_EMULATE_FN(test, 16, emulateTestOp, uint16_t)
+GEN_EMULATE_FN(test, 32, emulateTestOp, uint32_t)
 
 DEF_EMULATE_FN(test64)
 {
     DynamicOperandInfo &in0 = dynInfo.operands[0];
     DynamicOperandInfo &in1 = dynInfo.operands[1];
-    Eflags eflags;
-
-    if (in0.input.isImm() && in1.input.isImm()) {
-        test64(in0.input.getImm64(), in1.input.getImm64(), eflags);
-        setEflags(dynInfo, 2, eflags);
+    const DynamicValue a = ptrToImm(in0.input, cfg);
+    const DynamicValue b = ptrToImm(in1.input, cfg);
+
+    if (a.isImm() && b.isImm()) {
+        setEflags(dynInfo, 2, lazyEflags<EflagsOp::And, uint64_t>(a.getImm64(),
+                                                                  b.getImm64()));
+    } else if (in0.input == in1.input && isNotNullPtr(in0.input, cfg)) {
+        /* "test %rdi,%rdi" on a pointer that is never NULL */
+        setZF(dynInfo, 5, DynamicValue((uint8_t)0));
     }
+
     /* the following flags don't depend on any input values */
     setCF(dynInfo, 2, DynamicValue((uint8_t)0));
     setAF(dynInfo, 4, DynamicValue(DynamicValueType::Unknown));
     setOF(dynInfo, 7, DynamicValue((uint8_t)0));
-    /*
-     * TODO: we could make use of UsrPtr information here, e.g. comparing a
-     * pointer against immediates/zero
-     */
     return EmuRet::Ok;
 }
 
-static inline uint32_t xor32(uint32_t a, uint32_t b, Eflags &eflags)
-{
-    asm volatile ("     xorl %[in], %[inout]\n"
-                  : [inout] "+g" (a)
-                  : [in] "r" (b)
-                  : "memory" );
-    readEflags(eflags);
-    return a;
-}
-
-DEF_EMULATE_FN(xor32)
-{
-    DynamicOperandInfo &inout = dynInfo.operands[0];
-    DynamicOperandInfo &in = dynInfo.operands[1];
-    Eflags eflags;
-
-    inout.output = xor32(inout.input.getImm64(), in.input.getImm64(), eflags);
-    setEflags(dynInfo, 2, eflags);
-    return EmuRet::Ok;
-}
-
-static inline uint64_t xor64(uint64_t a, uint64_t b, Eflags &eflags)
-{
-    asm volatile ("     xorq %[in], %[inout]\n"
-                  : [inout] "+g" (a)
-                  : [in] "r" (b)
-                  : "memory" );
-    readEflags(eflags);
-    return a;
-}
-
-DEF_EMULATE_FN(xor64)
-{
-    DynamicOperandInfo &inout = dynInfo.operands[0];
-    DynamicOperandInfo &in = dynInfo.operands[1];
-    Eflags eflags;
-
-    inout.output = xor64(inout.input.getImm64(), in.input.getImm64(), eflags);
-    setEflags(dynInfo, 2, eflags);
-    return EmuRet::Ok;
-}
+GEN_EMULATE_FN(xor, 32, emulateBinaryOp, EflagsOp::Xor, uint32_t)
+GEN_EMULATE_FN(xor, 64, emulateBinaryOp, EflagsOp::Xor, uint64_t)
 
 } /* namespace drob */
@@ -31,8 +31,16 @@ emulate_f emulate_cmp16;
 emulate_f emulate_cmp32;
 emulate_f emulate_cmp64;
 emulate_f emulate_call;
+emulate_f emulate_div32;
+emulate_f emulate_div64;
+emulate_f emulate_idiv32;
+emulate_f emulate_idiv64;
+emulate_f emulate_imul32;
+emulate_f emulate_imul64;
 emulate_f emulate_lea;
 emulate_f emulate_mov;
+emulate_f emulate_mul32;
+emulate_f emulate_mul64;
 emulate_f emulate_mulpd;
 emulate_f emulate_mulsd;
 emulate_f emulate_pop;
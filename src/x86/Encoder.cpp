@@ -790,6 +790,28 @@ static inline int write_modrm_r_imm32(uint8_t oc, uint8_t reg,
     return ope.write(buf);
 }
 
+/* "reg, r/m, imm" with the immediate being operand 2 */
+static inline int write_modrm_reg_r_imm(uint8_t oc, uint8_t immLen,
+                                        const ExplicitStaticOperands &explOperands,
+                                        EncFlags flags, uint8_t *buf)
+{
+    ModRMEncoding ope(&oc, 1, encodeReg(explOperands.op[0].reg),
+                      explOperands.op[1].reg, explOperands.op[2].imm.val,
+                      immLen, flags);
+    return ope.write(buf);
+}
+
+static inline int write_modrm_reg_m_imm(uint8_t oc, uint8_t immLen,
+                                        const ExplicitStaticOperands &explOperands,
+                                        EncFlags flags, uint8_t *buf,
+                                        uint64_t addr)
+{
+    ModRMEncoding ope(&oc, 1, encodeReg(explOperands.op[0].reg),
+                      explOperands.op[1].mem, explOperands.op[2].imm.val,
+                      immLen, flags, addr);
+    return ope.write(buf);
+}
+
 /* Encode the special "oc + rw/rd" format */
 static inline int write_reg(uint8_t oc, const ExplicitStaticOperands &explOperands,
                             EncFlags flags, uint8_t *buf)
@@ -1108,6 +1130,92 @@ DEF_ENCODE_FN(cmp)
     }
 }
 
+DEF_ENCODE_FN(div)
+{
+    switch (opcode) {
+    case Opcode::DIV32m:
+        return write_modrm_m(0xf7, 6, explOperands, ENC_FLAG_NONE, buf, addr);
+    case Opcode::DIV32r:
+        return write_modrm_r(0xf7, 6, explOperands, ENC_FLAG_NONE, buf);
+    case Opcode::DIV64m:
+        return write_modrm_m(0xf7, 6, explOperands, ENC_FLAG_REXW, buf, addr);
+    case Opcode::DIV64r:
+        return write_modrm_r(0xf7, 6, explOperands, ENC_FLAG_REXW, buf);
+    default:
+        drob_assert_not_reached();
+    }
+}
+
+DEF_ENCODE_FN(idiv)
+{
+    switch (opcode) {
+    case Opcode::IDIV32m:
+        return write_modrm_m(0xf7, 7, explOperands, ENC_FLAG_NONE, buf, addr);
+    case Opcode::IDIV32r:
+        return write_modrm_r(0xf7, 7, explOperands, ENC_FLAG_NONE, buf);
+    case Opcode::IDIV64m:
+        return write_modrm_m(0xf7, 7, explOperands, ENC_FLAG_REXW, buf, addr);
+    case Opcode::IDIV64r:
+        return write_modrm_r(0xf7, 7, explOperands, ENC_FLAG_REXW, buf);
+    default:
+        drob_assert_not_reached();
+    }
+}
+
+DEF_ENCODE_FN(imul)
+{
+    switch (opcode) {
+    case Opcode::IMUL32m:
+        return write_modrm_m(0xf7, 5, explOperands, ENC_FLAG_NONE, buf, addr);
+    case Opcode::IMUL32r:
+        return write_modrm_r(0xf7, 5, explOperands, ENC_FLAG_NONE, buf);
+    case Opcode::IMUL64m:
+        return write_modrm_m(0xf7, 5, explOperands, ENC_FLAG_REXW, buf, addr);
+    case Opcode::IMUL64r:
+        return write_modrm_r(0xf7, 5, explOperands, ENC_FLAG_REXW, buf);
+
+    case Opcode::IMUL32rm:
+        return write_modrm_reg_m(0x0f, 0xaf, explOperands, ENC_FLAG_NONE, buf,
+                                 addr);
+    case Opcode::IMUL64rm:
+        return write_modrm_reg_m(0x0f, 0xaf, explOperands, ENC_FLAG_REXW, buf,
+                                 addr);
+    case Opcode::IMUL32rr:
+        return write_modrm_reg_r(0x0f, 0xaf, explOperands, ENC_FLAG_NONE, buf);
+    case Opcode::IMUL64rr:
+        return write_modrm_reg_r(0x0f, 0xaf, explOperands, ENC_FLAG_REXW, buf);
+
+    case Opcode::IMUL32rmi:
+        if (is_simm8((int32_t)explOperands.op[2].imm.val)) {
+            return write_modrm_reg_m_imm(0x6b, 1, explOperands, ENC_FLAG_NONE,
+                                         buf, addr);
+        }
+        return write_modrm_reg_m_imm(0x69, 4, explOperands, ENC_FLAG_NONE,
+                                     buf, addr);
+    case Opcode::IMUL64rmi:
+        if (is_simm8(explOperands.op[2].imm.val)) {
+            return write_modrm_reg_m_imm(0x6b, 1, explOperands, ENC_FLAG_REXW,
+                                         buf, addr);
+        }
+        return write_modrm_reg_m_imm(0x69, 4, explOperands, ENC_FLAG_REXW,
+                                     buf, addr);
+    case Opcode::IMUL32rri:
+        if (is_simm8((int32_t)explOperands.op[2].imm.val)) {
+            return write_modrm_reg_r_imm(0x6b, 1, explOperands, ENC_FLAG_NONE,
+                                         buf);
+        }
+        return write_modrm_reg_r_imm(0x69, 4, explOperands, ENC_FLAG_NONE, buf);
+    case Opcode::IMUL64rri:
+        if (is_simm8(explOperands.op[2].imm.val)) {
+            return write_modrm_reg_r_imm(0x6b, 1, explOperands, ENC_FLAG_REXW,
+                                         buf);
+        }
+        return write_modrm_reg_r_imm(0x69, 4, explOperands, ENC_FLAG_REXW, buf);
+    default:
+        drob_assert_not_reached();
+    }
+}
+
 DEF_ENCODE_FN(jcc)
 {
     (void)opcode;
@@ -1185,7 +1293,7 @@ DEF_ENCODE_FN(mov)
         return write_modrm_m_imm32(0xc7, 0, explOperands, ENC_FLAG_REXW, buf,
                                    addr);
     case Opcode::MOV64ri:
-        if (is_simm32(explOperands.op[0].imm.val)) {
+        if (is_simm32(explOperands.op[1].imm.val)) {
             return write_modrm_r_imm32(0xc7, 0, explOperands, ENC_FLAG_REXW, buf);
         }
         return write_reg_imm64(0xb8, explOperands, ENC_FLAG_REXW, buf);
@@ -1269,6 +1377,22 @@ DEF_ENCODE_FN(movups)
     }
 }
 
+DEF_ENCODE_FN(mul)
+{
+    switch (opcode) {
+    case Opcode::MUL32m:
+        return write_modrm_m(0xf7, 4, explOperands, ENC_FLAG_NONE, buf, addr);
+    case Opcode::MUL32r:
+        return write_modrm_r(0xf7, 4, explOperands, ENC_FLAG_NONE, buf);
+    case Opcode::MUL64m:
+        return write_modrm_m(0xf7, 4, explOperands, ENC_FLAG_REXW, buf, addr);
+    case Opcode::MUL64r:
+        return write_modrm_r(0xf7, 4, explOperands, ENC_FLAG_REXW, buf);
+    default:
+        drob_assert_not_reached();
+    }
+}
+
 DEF_ENCODE_FN(mulpd)
 {
     switch (opcode) {
@@ -1619,6 +1743,23 @@ void arch_fill_with_nops(uint8_t *start, int size)
     }
 }
 
+bool arch_is_macro_fused(const Instruction &instr, const Instruction &branch)
+{
+    const OpcodeInfo *info = arch_get_opcode_info(instr.getOpcode());
+
+    if (!branch.isBranch() || !branch.getPredicate() || !info ||
+        info->numOperands < 1) {
+        return false;
+    }
+
+    /* CMP/TEST/ADD/SUB fuse, as long as they don't write/compare to memory */
+    if (info->encode != encode_cmp && info->encode != encode_test &&
+        info->encode != encode_add && info->encode != encode_sub) {
+        return false;
+    }
+    return info->opInfo[0].type == OperandType::Register;
+}
+
 void arch_fixup_call(const CallLocation &call, const uint8_t *target,
                      bool write)
 {
@@ -1630,21 +1771,37 @@ void arch_fixup_call(const CallLocation &call, const uint8_t *target,
         return;
     }
 
-    call.itext[0] = 0xe8;
+    /* tail calls use a JMP rel32 */
+    call.itext[0] = call.instr->isTailCall() ? 0xe9 : 0xe8;
     *((int32_t *)&call.itext[1]) = disp;
 }
 
+/*
+ * Sizing run: remember if a short branch can be used. When verifying a layout
+ * that already uses short branches, only fall back to long branches, so the
+ * layout converges.
+ */
+static void sizeBranch(const BranchLocation &branch, const uint8_t *target,
+                       int short_ilen, bool relayout)
+{
+    if (!relayout) {
+        if (is_rel8(target - (branch.itext + short_ilen))) {
+            branch.instr->setUseShortBranch(true);
+        }
+    } else if (branch.instr->getUseShortBranch() &&
+               !is_rel8(target - (branch.itext + branch.ilen))) {
+        branch.instr->setUseShortBranch(false);
+    }
+}
+
 static void fixupBranch(const BranchLocation &branch, const uint8_t *target,
-                        bool write)
+                        bool write, bool relayout)
 {
     int32_t disp;
 
     if (!write) {
         /* can we use a short instruction? remember it for next time */
-        disp = target - (branch.itext + 2);
-        if (is_rel8(disp)) {
-            branch.instr->setUseShortBranch(true);
-        }
+        sizeBranch(branch, target, 2, relayout);
         return;
     }
 
@@ -1662,7 +1819,8 @@ static void fixupBranch(const BranchLocation &branch, const uint8_t *target,
 }
 
 static void fixupSpecialCondBranch(const BranchLocation &branch,
-                                   const uint8_t *target, bool write)
+                                   const uint8_t *target, bool write,
+                                   bool relayout)
 {
     int short_ilen = 2, long_ilen = 9, pos = 0;
     bool addr_prefix = false;
@@ -1686,10 +1844,7 @@ static void fixupSpecialCondBranch(const BranchLocation &branch,
 
     if (!write) {
         /* can we use a short instruction? remember it for next time */
-        disp = target - (branch.itext + short_ilen);
-        if (is_rel8(disp)) {
-            branch.instr->setUseShortBranch(true);
-        }
+        sizeBranch(branch, target, short_ilen, relayout);
         return;
     }
 
@@ -1722,7 +1877,7 @@ static void fixupSpecialCondBranch(const BranchLocation &branch,
 }
 
 void arch_fixup_branch(const BranchLocation &branch, const uint8_t *target,
-                       bool write)
+                       bool write, bool relayout)
 {
     uint8_t opcode;
     int32_t disp;
@@ -1779,10 +1934,10 @@ void arch_fixup_branch(const BranchLocation &branch, const uint8_t *target,
     case Opcode::JMPa:
     case Opcode::JMPr:
     case Opcode::JMPm:
-        return fixupBranch(branch, target, write);
+        return fixupBranch(branch, target, write, relayout);
     case Opcode::JCXZ32a:
     case Opcode::JCXZ64a:
-        return fixupSpecialCondBranch(branch, target, write);
+        return fixupSpecialCondBranch(branch, target, write, relayout);
     default:
         drob_assert_not_reached();
     }
@@ -1790,10 +1945,7 @@ void arch_fixup_branch(const BranchLocation &branch, const uint8_t *target,
     /* handling for simple conditional branches */
     if (!write) {
         /* can we use a short instruction? remember it for next time */
-        disp = target - (branch.itext + 2);
-        if (is_rel8(disp)) {
-            branch.instr->setUseShortBranch(true);
-        }
+        sizeBranch(branch, target, 2, relayout);
         return;
     }
 
@@ -25,6 +25,9 @@ encode_f encode_addpd;
 encode_f encode_addsd;
 encode_f encode_call;
 encode_f encode_cmp;
+encode_f encode_div;
+encode_f encode_idiv;
+encode_f encode_imul;
 encode_f encode_jcc;
 encode_f encode_jmp;
 encode_f encode_lea;
@@ -33,6 +36,7 @@ encode_f encode_movapd;
 encode_f encode_movsd;
 encode_f encode_movupd;
 encode_f encode_movups;
+encode_f encode_mul;
 encode_f encode_mulpd;
 encode_f encode_mulsd;
 encode_f encode_pop;
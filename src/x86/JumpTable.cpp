@@ -0,0 +1,342 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#include <list>
+#include <memory>
+#include <vector>
+
+#include "../arch.hpp"
+#include "../Instruction.hpp"
+#include "../InstructionInfo.hpp"
+#include "../MemProtCache.hpp"
+#include "../RewriterCfg.hpp"
+#include "x86.hpp"
+#include "gen/gen-defs.h"
+
+namespace drob {
+
+static const SubRegisterMask eflags = {
+    .m = { SUBREGISTER_MASK_EFLAGS }
+};
+
+/*
+ * Every range of table entries with the same target costs one compare and
+ * one conditional branch. Don't replace a single indirect branch by too
+ * many of them.
+ */
+#define JUMP_TABLE_MAX_ENTRIES 256
+#define JUMP_TABLE_MAX_RANGES 16
+
+/*
+ * How many instructions to look at when checking if eflags are dead at a
+ * branch target.
+ */
+#define EFLAGS_SCAN_MAX_INSTRS 16
+
+/*
+ * A range of consecutive table entries [.., last] with the same target.
+ */
+typedef struct JumpTableRange {
+    uint64_t last;
+    uint64_t target;
+} JumpTableRange;
+
+static bool writesRegister(const Instruction &instr, Register reg)
+{
+    const InstructionInfo &info = instr.getInfo();
+    const SubRegisterMask &full = arch_get_register_info(reg)->full;
+
+    return !!(info.writtenRegs & full) || !!(info.condWrittenRegs & full);
+}
+
+/*
+ * Writing a 32bit GPRS zeroes the upper half of the 64bit GPRS.
+ */
+static bool zeroExtendsRegister(const Instruction &instr, Register reg)
+{
+    for (auto &op : instr.getInfo().operands) {
+        if (op.type != OperandType::Register || !isWrite(op.r.mode)) {
+            continue;
+        }
+        if (arch_get_register_info(op.r.reg)->parent == reg &&
+            arch_get_register_info(op.r.reg)->type == RegisterType::Gprs32) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Is the memory operand "[table + index * 8]" with a known table address?
+ */
+static bool isTableOperand(const StaticOperand &op)
+{
+    return op.mem.type == MemPtrType::SIB &&
+           op.mem.sib.base == Register::None &&
+           op.mem.sib.index != Register::None &&
+           op.mem.sib.scale == 8 && op.mem.sib.disp.usrPtrNr < 0 &&
+           arch_get_register_info(op.mem.sib.index)->type == RegisterType::Gprs64;
+}
+
+/*
+ * Our dispatch code clobbers eflags. Make sure nobody will read the old
+ * eflags at the target: they have to be overwritten before being read or
+ * the function has to be left (eflags are not preserved across calls and
+ * are no return value).
+ */
+static bool eflagsDeadAt(const uint8_t *itext, const MemProtCache &memProtCache,
+                         const RewriterCfg &cfg)
+{
+    std::list<std::unique_ptr<Instruction>> instrs;
+    int scanned = 0;
+
+    while (scanned < EFLAGS_SCAN_MAX_INSTRS) {
+        const uint64_t addr = (uint64_t)itext;
+        uint16_t max_ilen = ARCH_PAGE_SIZE - (addr & (ARCH_PAGE_SIZE - 1));
+        DecodeRet ret;
+
+        if (max_ilen > ARCH_MAX_ILEN) {
+            max_ilen = ARCH_MAX_ILEN;
+        }
+        instrs.clear();
+        /* first try to decode without crossing page boundaries */
+        ret = arch_decode_one(&itext, max_ilen, instrs, cfg);
+        if (ret == DecodeRet::BrokenInstr && max_ilen < ARCH_MAX_ILEN) {
+            ret = arch_decode_one(&itext, ARCH_MAX_ILEN, instrs, cfg);
+        }
+        if (ret != DecodeRet::Ok && ret != DecodeRet::NOP &&
+            ret != DecodeRet::EOB) {
+            return false;
+        }
+
+        for (auto &instr : instrs) {
+            const InstructionInfo &info = instr->getInfo();
+
+            if (info.nasty || !!(info.readRegs & eflags) ||
+                !!(info.predicateRegs & eflags)) {
+                return false;
+            }
+            if (instr->isRet() || instr->isCall() ||
+                (info.writtenRegs & eflags) == eflags) {
+                return true;
+            }
+            if (instr->isBranch()) {
+                if (instr->getPredicate()) {
+                    return false;
+                }
+                itext = instr->getRawTarget(memProtCache);
+                if (!itext) {
+                    return false;
+                }
+            }
+            scanned++;
+        }
+    }
+    return false;
+}
+
+/*
+ * Find the table operand of "jmp *table(,index,8)" or
+ * "mov reg,table(,index,8); jmp *reg" at the end of the block. Returns the
+ * index of the first instruction to check for the bound.
+ */
+static int findTableOperand(const std::vector<Instruction *> &block,
+                            const StaticOperand **tableOp)
+{
+    const Instruction *branch = block.back();
+    int i = block.size() - 2;
+
+    switch (branch->getOpcode()) {
+    case Opcode::JMPm:
+        *tableOp = &branch->getOperand(0);
+        break;
+    case Opcode::JMPr:
+        for (; i >= 0; i--) {
+            if (writesRegister(*block[i], branch->getOperand(0).reg)) {
+                break;
+            }
+        }
+        if (i < 0 || block[i]->getOpcode() != Opcode::MOV64rm ||
+            block[i]->getOperand(0).reg != branch->getOperand(0).reg) {
+            return -1;
+        }
+        *tableOp = &block[i]->getOperand(1);
+        /* the index must not have been overwritten by the load */
+        if ((*tableOp)->mem.sib.index == branch->getOperand(0).reg) {
+            return -1;
+        }
+        i = block.size() - 2;
+        break;
+    default:
+        return -1;
+    }
+    if (!isTableOperand(**tableOp)) {
+        return -1;
+    }
+    return i;
+}
+
+/*
+ * The index has to be bounded by "cmp index,imm; ja" in this block. As blocks
+ * are single-entry, every path to the branch passes that check. Returns the
+ * number of table entries or 0 if the index is not bounded.
+ */
+static uint64_t getTableEntries(const std::vector<Instruction *> &block,
+                                int i, Register index)
+{
+    bool zeroExtended = false;
+    const Instruction *cmp;
+    uint64_t entries;
+
+    for (; i >= 0; i--) {
+        const Instruction *instr = block[i];
+
+        if (instr->getOpcode() == Opcode::JNBEa) {
+            break;
+        }
+        if (!writesRegister(*instr, index)) {
+            continue;
+        }
+        /* e.g. "mov %edi,%edi" to zero-extend the index */
+        if (instr->getOpcode() != Opcode::MOV32rr ||
+            instr->getOperand(0).reg != instr->getOperand(1).reg ||
+            !zeroExtendsRegister(*instr, index)) {
+            return 0;
+        }
+        zeroExtended = true;
+    }
+    if (i < 1) {
+        return 0;
+    }
+    cmp = block[i - 1];
+    if (cmp->getOperand(1).imm.usrPtrNr >= 0) {
+        return 0;
+    }
+
+    if (cmp->getOpcode() == Opcode::CMP64ri &&
+        cmp->getOperand(0).reg == index) {
+        /* sign-extended, negative values are huge unsigned bounds */
+        entries = (uint64_t)(int64_t)(int32_t)cmp->getOperand(1).imm.val + 1;
+    } else if (cmp->getOpcode() == Opcode::CMP32ri &&
+               arch_get_register_info(cmp->getOperand(0).reg)->parent == index) {
+        entries = (uint64_t)(uint32_t)cmp->getOperand(1).imm.val + 1;
+
+        /* Only bounded if the last write to the index zero-extended */
+        for (i = i - 2; !zeroExtended && i >= 0; i--) {
+            if (writesRegister(*block[i], index)) {
+                if (!zeroExtendsRegister(*block[i], index)) {
+                    return 0;
+                }
+                zeroExtended = true;
+            }
+        }
+        if (!zeroExtended) {
+            return 0;
+        }
+    } else {
+        return 0;
+    }
+
+    if (!entries || entries > JUMP_TABLE_MAX_ENTRIES) {
+        return 0;
+    }
+    return entries;
+}
+
+bool arch_lower_jump_table(const std::list<std::unique_ptr<Instruction>> &blockInstrs,
+                           const MemProtCache &memProtCache,
+                           const RewriterCfg &cfg,
+                           std::list<std::unique_ptr<Instruction>> &instrs)
+{
+    std::vector<Instruction *> block;
+    std::vector<JumpTableRange> ranges;
+    const StaticOperand *tableOp;
+    const Instruction *branch;
+    uint64_t table, entries;
+    const uint8_t *itext;
+    Register index;
+    uint8_t ilen;
+    int i;
+
+    for (auto &instr : blockInstrs) {
+        block.push_back(instr.get());
+    }
+    if (block.size() < 3) {
+        return false;
+    }
+    branch = block.back();
+
+    i = findTableOperand(block, &tableOp);
+    if (i < 0) {
+        return false;
+    }
+    index = tableOp->mem.sib.index;
+    table = (uint64_t)(int64_t)tableOp->mem.sib.disp.val;
+
+    entries = getTableEntries(block, i, index);
+    if (!entries ||
+        !memProtCache.isConstant(table, entries * sizeof(uint64_t))) {
+        return false;
+    }
+
+    for (uint64_t entry = 0; entry < entries; entry++) {
+        const uint64_t target = ((const uint64_t *)table)[entry];
+
+        if (!ranges.empty() && ranges.back().target == target) {
+            ranges.back().last = entry;
+            continue;
+        }
+        if (ranges.size() == JUMP_TABLE_MAX_RANGES ||
+            !eflagsDeadAt((const uint8_t *)target, memProtCache, cfg)) {
+            return false;
+        }
+        ranges.push_back({ .last = entry, .target = target });
+    }
+
+    drob_info("Lowering jump table %p with %d entries (%d ranges)",
+              (const void *)table, (int)entries, (int)ranges.size());
+
+    /*
+     * "cmp index,last; jbe target" for all but the last range, which is
+     * reached via an unconditional branch. The new instructions inherit the
+     * original instruction address.
+     */
+    itext = branch->getStartAddr();
+    ilen = branch->getEndAddr() - itext + 1;
+    for (auto &range : ranges) {
+        ExplicitStaticOperands operands = {};
+        Opcode opcode = Opcode::JMPa;
+
+        if (&range != &ranges.back()) {
+            opcode = Opcode::CMP64ri;
+            operands.op[0].reg = index;
+            operands.op[1].imm.val = range.last;
+            operands.op[1].imm.usrPtrNr = -1;
+            instrs.emplace_back(std::make_unique<Instruction>(itext, ilen,
+                                opcode, operands, arch_get_opcode_info(opcode),
+                                true));
+            opcode = Opcode::JBEa;
+            operands = {};
+        }
+        operands.op[0].mem.type = MemPtrType::Direct;
+        operands.op[0].mem.addr.val = range.target;
+        operands.op[0].mem.addr.usrPtrNr = -1;
+        instrs.emplace_back(std::make_unique<Instruction>(itext, ilen, opcode,
+                            operands, arch_get_opcode_info(opcode), true));
+    }
+    return true;
+}
+
+} /* namespace drob */
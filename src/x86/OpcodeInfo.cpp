@@ -14,6 +14,8 @@
  * in the COPYING.LESSER files in the top-level directory for more details.
  */
 #include "../Instruction.hpp"
+#include "../InstructionInfo.hpp"
+#include "../RewriterCfg.hpp"
 #include "OpcodeInfo.hpp"
 #include "Converter.hpp"
 #include "Predicate.hpp"
@@ -226,6 +228,12 @@ static const Predicate pred_none = {
         _OP0, \
         _OP1, \
     }
+#define DEF_EOI_3(_OP0, _OP1, _OP2) \
+    static const ExplicitStaticOperandInfo eoi_##_OP0##_##_OP1##_##_OP2[3] = { \
+        _OP0, \
+        _OP1, \
+        _OP2, \
+    }
 
 /* Definitions for instructions with 1 explicit memory operand */
 DEF_EOI_1(r16R);
@@ -234,6 +242,10 @@ DEF_EOI_1(r16W);
 DEF_EOI_1(m16R);
 DEF_EOI_1(m16W);
 
+DEF_EOI_1(r32R);
+
+DEF_EOI_1(m32R);
+
 DEF_EOI_1(r64R);
 DEF_EOI_1(r64W);
 DEF_EOI_1(r64RW);
@@ -328,6 +340,13 @@ DEF_EOI_2(x128MRW, x128MR);
 
 DEF_EOI_2(m128W, x128R);
 
+/* Definitions for instructions with 3 explicit memory operands */
+DEF_EOI_3(r32W, r32R, i32);
+DEF_EOI_3(r32W, m32R, i32);
+
+DEF_EOI_3(r64W, r64R, s32);
+DEF_EOI_3(r64W, m64R, s32);
+
 /*
  * Write all eflags.
  */
@@ -422,6 +441,249 @@ static const StaticOperandInfo ioi_eflagsMW[6] = {
          },
 };
 
+/*
+ * MUL/IMUL (one operand form): RDX:RAX = RAX * src. CF and OF are defined,
+ * the other eflags are undefined.
+ */
+static const StaticOperandInfo ioi_mul64[8] = {
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::RAX,
+               .mode = AccessMode::ReadWrite,
+               .r = RegisterAccessType::Full,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::RDX,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::CF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::PF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::AF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::ZF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::SF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::OF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+};
+
+static const StaticOperandInfo ioi_mul32[8] = {
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::EAX,
+               .mode = AccessMode::ReadWrite,
+               .r = RegisterAccessType::Full,
+               .w = RegisterAccessType::FullZeroParent },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::EDX,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::FullZeroParent },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::CF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::PF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::AF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::ZF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::SF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::OF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+};
+
+/*
+ * DIV/IDIV: RAX = RDX:RAX / src, RDX = RDX:RAX % src. All eflags are undefined.
+ */
+static const StaticOperandInfo ioi_div64[8] = {
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::RAX,
+               .mode = AccessMode::ReadWrite,
+               .r = RegisterAccessType::Full,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::RDX,
+               .mode = AccessMode::ReadWrite,
+               .r = RegisterAccessType::Full,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::CF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::PF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::AF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::ZF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::SF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::OF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+};
+
+static const StaticOperandInfo ioi_div32[8] = {
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::EAX,
+               .mode = AccessMode::ReadWrite,
+               .r = RegisterAccessType::Full,
+               .w = RegisterAccessType::FullZeroParent },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::EDX,
+               .mode = AccessMode::ReadWrite,
+               .r = RegisterAccessType::Full,
+               .w = RegisterAccessType::FullZeroParent },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::CF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::PF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::AF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::ZF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::SF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+    {
+        .type = OperandType::Register,
+        .r = { .reg = Register::OF,
+               .mode = AccessMode::Write,
+               .r = RegisterAccessType::None,
+               .w = RegisterAccessType::Full },
+    },
+};
+
 static const StaticOperandInfo ioi_pop64[2] = {
     {
         .type = OperandType::Register,
@@ -767,4 +1029,249 @@ Opcode arch_invert_branch(Opcode opcode)
     }
 }
 
+static void set_rsp_operand(StaticOperand &op, int32_t disp)
+{
+    op.mem.type = MemPtrType::SIB;
+    op.mem.sib.base = Register::RSP;
+    op.mem.sib.index = Register::None;
+    op.mem.sib.scale = 1;
+    op.mem.sib.disp.val = disp;
+    op.mem.sib.disp.usrPtrNr = -1;
+}
+
+void arch_inline_call(const Instruction &call,
+                      std::list<std::unique_ptr<Instruction>> &instrs)
+{
+    const uint64_t retAddr = (uint64_t)call.getEndAddr() + 1;
+    ExplicitStaticOperands operands = {};
+
+    drob_assert(call.isCall() && call.getStartAddr());
+
+    /* Push the original return address, it might be sign-extended */
+    if ((int64_t)(int32_t)retAddr == (int64_t)retAddr) {
+        operands.op[0].imm.val = retAddr;
+        operands.op[0].imm.usrPtrNr = -1;
+        instrs.emplace_back(std::make_unique<Instruction>(Opcode::PUSH64i,
+                                                          operands));
+        return;
+    }
+
+    /* Reserve the stack slot without modifying eflags */
+    operands.op[0].reg = Register::RSP;
+    set_rsp_operand(operands.op[1], -8);
+    instrs.emplace_back(std::make_unique<Instruction>(Opcode::LEA64ra,
+                                                      operands));
+
+    /* Store the original return address in two steps */
+    for (int i = 0; i < 2; i++) {
+        operands = {};
+        set_rsp_operand(operands.op[0], i * 4);
+        operands.op[1].imm.val = (uint32_t)(retAddr >> (i * 32));
+        operands.op[1].imm.usrPtrNr = -1;
+        instrs.emplace_back(std::make_unique<Instruction>(Opcode::MOV32mi,
+                                                          operands));
+    }
+}
+
+void arch_inline_ret(const Instruction &ret,
+                     std::list<std::unique_ptr<Instruction>> &instrs)
+{
+    ExplicitStaticOperands operands = {};
+
+    drob_assert(ret.isRet() && ret.getOpcode() == Opcode::RET);
+
+    /* Drop the return address without modifying eflags */
+    operands.op[0].reg = Register::RSP;
+    set_rsp_operand(operands.op[1], 8);
+    instrs.emplace_back(std::make_unique<Instruction>(Opcode::LEA64ra,
+                                                      operands));
+}
+
+bool arch_devirtualize_call(Instruction &call, const RewriterCfg &cfg)
+{
+    const DynamicInstructionInfo *dynInfo = call.getDynInfo();
+    StaticOperand target = {};
+    uint64_t val;
+
+    if (call.getOpcode() != Opcode::CALLr && call.getOpcode() != Opcode::CALLm) {
+        return false;
+    }
+    /* the target register or the target read from memory */
+    if (!dynInfo || !ptrToInt(dynInfo->operands[0].input, cfg, &val) || !val) {
+        return false;
+    }
+
+    target.mem.type = MemPtrType::Direct;
+    target.mem.addr.val = val;
+    target.mem.addr.usrPtrNr = -1;
+    call.setOpcode(Opcode::CALLa);
+    call.setOperand(0, target);
+    return true;
+}
+
+bool arch_tail_call_epilogue(const std::vector<Instruction *> &epilogue,
+                             std::list<std::unique_ptr<Instruction>> &instrs)
+{
+    ExplicitStaticOperands operands;
+
+    if (epilogue.empty() || epilogue.back()->getOpcode() != Opcode::RET) {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < epilogue.size() - 1; i++) {
+        const Instruction *instr = epilogue[i];
+        const StaticOperand &op1 = instr->getOperand(1);
+
+        switch (instr->getOpcode()) {
+        case Opcode::ADD64ri:
+            /* Release the stack frame without modifying eflags */
+            if (instr->getOperand(0).reg != Register::RSP ||
+                op1.imm.usrPtrNr != -1) {
+                return false;
+            }
+            operands = {};
+            operands.op[0].reg = Register::RSP;
+            set_rsp_operand(operands.op[1], (int32_t)op1.imm.val);
+            instrs.emplace_back(std::make_unique<Instruction>(Opcode::LEA64ra,
+                                                              operands));
+            break;
+        case Opcode::LEA64ra:
+            if (instr->getOperand(0).reg != Register::RSP ||
+                op1.mem.type != MemPtrType::SIB ||
+                op1.mem.sib.base != Register::RSP ||
+                op1.mem.sib.index != Register::None) {
+                return false;
+            }
+            instrs.emplace_back(std::make_unique<Instruction>(*instr));
+            break;
+        case Opcode::POP64r:
+            /* The called function will preserve the restored value */
+            if (!arch_is_callee_saved(instr->getOperand(0).reg)) {
+                return false;
+            }
+            instrs.emplace_back(std::make_unique<Instruction>(*instr));
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<Instruction> arch_copy_register(Register dst, Register src)
+{
+    ExplicitStaticOperands operands = {};
+
+    if (arch_get_register_info(dst)->type != RegisterType::Gprs64 ||
+        arch_get_register_info(src)->type != RegisterType::Gprs64) {
+        return nullptr;
+    }
+
+    operands.op[0].reg = dst;
+    operands.op[1].reg = src;
+    return std::make_unique<Instruction>(Opcode::MOV64rr, operands);
+}
+
+static Register get_gprs32(Register reg)
+{
+    for (int i = 1; i < (int)Register::MAX; i++) {
+        const RegisterInfo *ri = arch_get_register_info((Register)i);
+
+        if (ri->type == RegisterType::Gprs32 && ri->parent == reg) {
+            return (Register)i;
+        }
+    }
+    return Register::None;
+}
+
+bool arch_promote_mem_access(Opcode &opcode, ExplicitStaticOperands &operands,
+                             Register reg)
+{
+    if (arch_get_register_info(reg)->type != RegisterType::Gprs64) {
+        return false;
+    }
+
+    switch (opcode) {
+    case Opcode::MOV64rm:
+        opcode = Opcode::MOV64rr;
+        operands.op[1] = {};
+        operands.op[1].reg = reg;
+        return true;
+    case Opcode::MOV32rm:
+        opcode = Opcode::MOV32rr;
+        operands.op[1] = {};
+        operands.op[1].reg = get_gprs32(reg);
+        return true;
+    case Opcode::MOV64mr:
+        opcode = Opcode::MOV64rr;
+        operands.op[0] = {};
+        operands.op[0].reg = reg;
+        return true;
+    case Opcode::MOV32mr:
+        opcode = Opcode::MOV32rr;
+        operands.op[0] = {};
+        operands.op[0].reg = get_gprs32(reg);
+        return true;
+    case Opcode::MOV64mi:
+        /* the immediate is sign-extended */
+        opcode = Opcode::MOV64ri;
+        operands.op[0] = {};
+        operands.op[0].reg = reg;
+        operands.op[1].imm.val = (uint64_t)(int64_t)(int32_t)operands.op[1].imm.val;
+        return true;
+    case Opcode::MOV32mi:
+        opcode = Opcode::MOV32ri;
+        operands.op[0] = {};
+        operands.op[0].reg = get_gprs32(reg);
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool arch_remove_mem_write(Opcode &opcode, ExplicitStaticOperands &operands)
+{
+    int32_t size;
+
+    switch (opcode) {
+    case Opcode::PUSH64m:
+    case Opcode::PUSH64r:
+    case Opcode::PUSH64i:
+        size = 8;
+        break;
+    case Opcode::PUSH16m:
+    case Opcode::PUSH16r:
+    case Opcode::PUSH16i:
+        size = 2;
+        break;
+    default:
+        return false;
+    }
+
+    /* Adjust the stack pointer without modifying eflags */
+    opcode = Opcode::LEA64ra;
+    operands = {};
+    operands.op[0].reg = Register::RSP;
+    set_rsp_operand(operands.op[1], -size);
+    return true;
+}
+
+bool arch_is_push_register(const Instruction &instr, Register reg)
+{
+    return instr.getOpcode() == Opcode::PUSH64r &&
+           instr.getOperand(0).reg == reg;
+}
+
+bool arch_is_pop_register(const Instruction &instr, Register reg)
+{
+    return instr.getOpcode() == Opcode::POP64r &&
+           instr.getOperand(0).reg == reg;
+}
+
+bool arch_is_copy_register(const Instruction &instr, Register dst, Register src)
+{
+    return instr.getOpcode() == Opcode::MOV64rr &&
+           instr.getOperand(0).reg == dst && instr.getOperand(1).reg == src;
+}
+
 } /* namespace drob */
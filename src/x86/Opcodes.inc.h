@@ -29,21 +29,21 @@
  */
 
 /* ADD */
-DEF_OPC(ADD8mr, m8RW_r8R, eflagsW, none, Other, nullptr, add, add8, nullptr, OfEmuImm)
-DEF_OPC(ADD8rr, r8RW_r8R, eflagsW, none, Other, nullptr, add, add8, nullptr, OfEmuImm)
-DEF_OPC(ADD8rm, r8RW_m8R, eflagsW, none, Other, nullptr, add, add8, nullptr, OfEmuImm)
-DEF_OPC(ADD8mi, m8RW_i8, eflagsW, none, Other, nullptr, add, add8, nullptr, OfEmuImm)
-DEF_OPC(ADD8ri, r8RW_i8, eflagsW, none, Other, nullptr, add, add8, nullptr, OfEmuImm)
-DEF_OPC(ADD16mr, m16RW_r16R, eflagsW, none, Other, nullptr, add, add16, nullptr, OfEmuImm)
-DEF_OPC(ADD16rr, r16RW_r16R, eflagsW, none, Other, nullptr, add, add16, nullptr, OfEmuImm)
-DEF_OPC(ADD16rm, r16RW_m16R, eflagsW, none, Other, nullptr, add, add16, nullptr, OfEmuImm)
-DEF_OPC(ADD16mi, m16RW_i16, eflagsW, none, Other, nullptr, add, add16, nullptr, OfEmuImm)
-DEF_OPC(ADD16ri, r16RW_i16, eflagsW, none, Other, nullptr, add, add16, nullptr, OfEmuImm)
-DEF_OPC(ADD32mr, m32RW_r32R, eflagsW, none, Other, nullptr, add, add32, nullptr, OfEmuImm)
-DEF_OPC(ADD32rr, r32RW_r32R, eflagsW, none, Other, nullptr, add, add32, nullptr, OfEmuImm)
-DEF_OPC(ADD32rm, r32RW_m32R, eflagsW, none, Other, nullptr, add, add32, nullptr, OfEmuImm)
-DEF_OPC(ADD32mi, m32RW_i32, eflagsW, none, Other, nullptr, add, add32, nullptr, OfEmuImm)
-DEF_OPC(ADD32ri, r32RW_i32, eflagsW, none, Other, nullptr, add, add32, nullptr, OfEmuImm)
+DEF_OPC(ADD8mr, m8RW_r8R, eflagsW, none, Other, nullptr, add, add8, add8, OfEmuImm)
+DEF_OPC(ADD8rr, r8RW_r8R, eflagsW, none, Other, nullptr, add, add8, add8, OfEmuImm)
+DEF_OPC(ADD8rm, r8RW_m8R, eflagsW, none, Other, nullptr, add, add8, add8, OfEmuImm)
+DEF_OPC(ADD8mi, m8RW_i8, eflagsW, none, Other, nullptr, add, add8, add8, OfEmuImm)
+DEF_OPC(ADD8ri, r8RW_i8, eflagsW, none, Other, nullptr, add, add8, add8, OfEmuImm)
+DEF_OPC(ADD16mr, m16RW_r16R, eflagsW, none, Other, nullptr, add, add16, add16, OfEmuImm)
+DEF_OPC(ADD16rr, r16RW_r16R, eflagsW, none, Other, nullptr, add, add16, add16, OfEmuImm)
+DEF_OPC(ADD16rm, r16RW_m16R, eflagsW, none, Other, nullptr, add, add16, add16, OfEmuImm)
+DEF_OPC(ADD16mi, m16RW_i16, eflagsW, none, Other, nullptr, add, add16, add16, OfEmuImm)
+DEF_OPC(ADD16ri, r16RW_i16, eflagsW, none, Other, nullptr, add, add16, add16, OfEmuImm)
+DEF_OPC(ADD32mr, m32RW_r32R, eflagsW, none, Other, nullptr, add, add32, add32, OfEmuImm)
+DEF_OPC(ADD32rr, r32RW_r32R, eflagsW, none, Other, nullptr, add, add32, add32, OfEmuImm)
+DEF_OPC(ADD32rm, r32RW_m32R, eflagsW, none, Other, nullptr, add, add32, add32, OfEmuImm)
+DEF_OPC(ADD32mi, m32RW_i32, eflagsW, none, Other, nullptr, add, add32, add32, OfEmuImm)
+DEF_OPC(ADD32ri, r32RW_i32, eflagsW, none, Other, nullptr, add, add32, add32, OfEmuImm)
 DEF_OPC(ADD64mr, m64RW_r64R, eflagsW, none, Other, nullptr, add, add64, add64, OfEmuPtr)
 DEF_OPC(ADD64rr, r64RW_r64R, eflagsW, none, Other, nullptr, add, add64, add64, OfEmuPtr)
 DEF_OPC(ADD64rm, r64RW_m64R, eflagsW, none, Other, nullptr, add, add64, add64, OfEmuPtr)
@@ -66,25 +66,51 @@ DEF_OPC(CALLr, r64R, push64, none, Call, nullptr, call, call, nullptr, OfEmuFull
 
 /* CMP */
 DEF_OPC(CMP8mr, m8R_r8R, eflagsW, none, Other, nullptr, cmp, cmp8, cmp8, OfEmuImm)
-DEF_OPC(CMP8mi, m8R_i8, eflagsW, none, Other, nullptr, cmp, cmp8, nullptr, OfEmuImm)
+DEF_OPC(CMP8mi, m8R_i8, eflagsW, none, Other, nullptr, cmp, cmp8, cmp8, OfEmuImm)
 DEF_OPC(CMP8rm, r8R_m8R, eflagsW, none, Other, nullptr, cmp, cmp8, cmp8, OfEmuImm)
 DEF_OPC(CMP8rr, r8R_r8R, eflagsW, none, Other, nullptr, cmp, cmp8, cmp8, OfEmuImm)
-DEF_OPC(CMP8ri, r8R_i8, eflagsW, none, Other, nullptr, cmp, cmp16, nullptr, OfEmuImm)
+DEF_OPC(CMP8ri, r8R_i8, eflagsW, none, Other, nullptr, cmp, cmp8, cmp8, OfEmuImm)
 DEF_OPC(CMP16mr, m16R_r16R, eflagsW, none, Other, nullptr, cmp, cmp16, cmp16, OfEmuImm)
-DEF_OPC(CMP16mi, m16R_i16, eflagsW, none, Other, nullptr, cmp, cmp16, nullptr, OfEmuImm)
+DEF_OPC(CMP16mi, m16R_i16, eflagsW, none, Other, nullptr, cmp, cmp16, cmp16, OfEmuImm)
 DEF_OPC(CMP16rm, r16R_m16R, eflagsW, none, Other, nullptr, cmp, cmp16, cmp16, OfEmuImm)
 DEF_OPC(CMP16rr, r16R_r16R, eflagsW, none, Other, nullptr, cmp, cmp16, cmp16, OfEmuImm)
-DEF_OPC(CMP16ri, r16R_i16, eflagsW, none, Other, nullptr, cmp, cmp16, nullptr, OfEmuImm)
+DEF_OPC(CMP16ri, r16R_i16, eflagsW, none, Other, nullptr, cmp, cmp16, cmp16, OfEmuImm)
 DEF_OPC(CMP32mr, m32R_r32R, eflagsW, none, Other, nullptr, cmp, cmp32, cmp32, OfEmuImm)
-DEF_OPC(CMP32mi, m32R_i32, eflagsW, none, Other, nullptr, cmp, cmp32, nullptr, OfEmuImm)
+DEF_OPC(CMP32mi, m32R_i32, eflagsW, none, Other, nullptr, cmp, cmp32, cmp32, OfEmuImm)
 DEF_OPC(CMP32rm, r32R_m32R, eflagsW, none, Other, nullptr, cmp, cmp32, cmp32, OfEmuImm)
 DEF_OPC(CMP32rr, r32R_r32R, eflagsW, none, Other, nullptr, cmp, cmp32,cmp32, OfEmuImm)
-DEF_OPC(CMP32ri, r32R_i32, eflagsW, none, Other, nullptr, cmp, cmp32, nullptr, OfEmuImm)
+DEF_OPC(CMP32ri, r32R_i32, eflagsW, none, Other, nullptr, cmp, cmp32, cmp32, OfEmuImm)
 DEF_OPC(CMP64mr, m64R_r64R, eflagsW, none, Other, nullptr, cmp, cmp64, cmp64, OfEmuPtr)
-DEF_OPC(CMP64mi, m64R_s32, eflagsW, none, Other, nullptr, cmp, cmp64, nullptr, OfEmuPtr)
+DEF_OPC(CMP64mi, m64R_s32, eflagsW, none, Other, nullptr, cmp, cmp64, cmp64, OfEmuPtr)
 DEF_OPC(CMP64rm, r64R_m64R, eflagsW, none, Other, nullptr, cmp, cmp64, cmp64, OfEmuPtr)
 DEF_OPC(CMP64rr, r64R_r64R, eflagsW, none, Other, nullptr, cmp, cmp64, cmp64, OfEmuPtr)
-DEF_OPC(CMP64ri, r64R_s32, eflagsW, none, Other, nullptr, cmp, cmp64, nullptr, OfEmuPtr)
+DEF_OPC(CMP64ri, r64R_s32, eflagsW, none, Other, nullptr, cmp, cmp64, cmp64, OfEmuPtr)
+
+/* DIV - on a divide error (#DE), the emulator leaves all outputs unknown */
+DEF_OPC(DIV32m, m32R, div32, none, Other, nullptr, div, div32, div, OfEmuImm)
+DEF_OPC(DIV32r, r32R, div32, none, Other, nullptr, div, div32, div, OfEmuImm)
+DEF_OPC(DIV64m, m64R, div64, none, Other, nullptr, div, div64, div, OfEmuImm)
+DEF_OPC(DIV64r, r64R, div64, none, Other, nullptr, div, div64, div, OfEmuImm)
+
+/* IDIV */
+DEF_OPC(IDIV32m, m32R, div32, none, Other, nullptr, idiv, idiv32, div, OfEmuImm)
+DEF_OPC(IDIV32r, r32R, div32, none, Other, nullptr, idiv, idiv32, div, OfEmuImm)
+DEF_OPC(IDIV64m, m64R, div64, none, Other, nullptr, idiv, idiv64, div, OfEmuImm)
+DEF_OPC(IDIV64r, r64R, div64, none, Other, nullptr, idiv, idiv64, div, OfEmuImm)
+
+/* IMUL - one operand form: RDX:RAX = RAX * src */
+DEF_OPC(IMUL32m, m32R, mul32, none, Other, nullptr, imul, imul32, mul, OfEmuImm)
+DEF_OPC(IMUL32r, r32R, mul32, none, Other, nullptr, imul, imul32, mul, OfEmuImm)
+DEF_OPC(IMUL32rm, r32RW_m32R, eflagsW, none, Other, nullptr, imul, imul32, imul32, OfEmuImm)
+DEF_OPC(IMUL32rr, r32RW_r32R, eflagsW, none, Other, nullptr, imul, imul32, imul32, OfEmuImm)
+DEF_OPC(IMUL32rmi, r32W_m32R_i32, eflagsW, none, Other, nullptr, imul, imul32, imul32, OfEmuImm)
+DEF_OPC(IMUL32rri, r32W_r32R_i32, eflagsW, none, Other, nullptr, imul, imul32, imul32, OfEmuImm)
+DEF_OPC(IMUL64m, m64R, mul64, none, Other, nullptr, imul, imul64, mul, OfEmuImm)
+DEF_OPC(IMUL64r, r64R, mul64, none, Other, nullptr, imul, imul64, mul, OfEmuImm)
+DEF_OPC(IMUL64rm, r64RW_m64R, eflagsW, none, Other, nullptr, imul, imul64, imul64, OfEmuImm)
+DEF_OPC(IMUL64rr, r64RW_r64R, eflagsW, none, Other, nullptr, imul, imul64, imul64, OfEmuImm)
+DEF_OPC(IMUL64rmi, r64W_m64R_s32, eflagsW, none, Other, nullptr, imul, imul64, imul64, OfEmuImm)
+DEF_OPC(IMUL64rri, r64W_r64R_s32, eflagsW, none, Other, nullptr, imul, imul64, imul64, OfEmuImm)
 
 /* Jcc (rel8/32 converted to absolute address) */
 DEF_OPC(JNBEa, mA, none, NBE, Branch, nullptr, jcc, nullptr, nullptr, OfNone)
@@ -121,13 +147,13 @@ DEF_OPC(LEA16ra, r16W_mA, none, none, Other, nullptr, lea, lea, lea16, OfEmuFull
 DEF_OPC(MOV64mr, m64W_r64R, none, none, Other, nullptr, mov, mov, mov64, OfEmuFull)
 DEF_OPC(MOV64rr, r64W_r64R, none, none, Other, nullptr, mov, mov, mov64, OfEmuFull)
 DEF_OPC(MOV64rm, r64W_m64R, none, none, Other, nullptr, mov, mov, mov64, OfEmuFull)
-DEF_OPC(MOV64mi, m64W_s32, none, none, Other, nullptr, mov, mov, nullptr, OfEmuFull)
-DEF_OPC(MOV64ri, r64W_i64, none, none, Other, nullptr, mov, mov, nullptr, OfEmuFull)
+DEF_OPC(MOV64mi, m64W_s32, none, none, Other, nullptr, mov, mov, mov64, OfEmuFull)
+DEF_OPC(MOV64ri, r64W_i64, none, none, Other, nullptr, mov, mov, mov64, OfEmuFull)
 DEF_OPC(MOV32mr, m32W_r32R, none, none, Other, nullptr, mov, mov, mov32, OfEmuFull)
 DEF_OPC(MOV32rr, r32W_r32R, none, none, Other, nullptr, mov, mov, mov32, OfEmuFull)
 DEF_OPC(MOV32rm, r32W_m32R, none, none, Other, nullptr, mov, mov, mov32, OfEmuFull)
-DEF_OPC(MOV32mi, m32W_i32, none, none, Other, nullptr, mov, mov, nullptr, OfEmuFull)
-DEF_OPC(MOV32ri, r32W_i32, none, none, Other, nullptr, mov, mov, nullptr, OfEmuFull)
+DEF_OPC(MOV32mi, m32W_i32, none, none, Other, nullptr, mov, mov, mov32, OfEmuFull)
+DEF_OPC(MOV32ri, r32W_i32, none, none, Other, nullptr, mov, mov, mov32, OfEmuFull)
 
 /* MOVAPD */
 DEF_OPC(MOVAPDrm, x128W_m128R, none, none, Other, nullptr, movapd, mov, movapd, OfEmuFull)
@@ -140,7 +166,7 @@ DEF_OPC(MOVSDrr, x64W_x64R, none, none, Other, nullptr, movsd, mov, movsd, OfEmu
 DEF_OPC(MOVSDmr, m64W_x64R, none, none, Other, nullptr, movsd, mov, movsd, OfEmuFull)
 
 /* MOVUPD */
-DEF_OPC(MOVUPDmr, m128W_x128R, none, none, Other, nullptr, movupd, mov, nullptr, OfEmuFull)
+DEF_OPC(MOVUPDmr, m128W_x128R, none, none, Other, nullptr, movupd, mov, movupd, OfEmuFull)
 DEF_OPC(MOVUPDrr, x128W_x128R, none, none, Other, nullptr, movupd, mov, movupd, OfEmuFull)
 DEF_OPC(MOVUPDrm, x128W_m128R, none, none, Other, nullptr, movupd, mov, movupd, OfEmuFull)
 
@@ -149,6 +175,12 @@ DEF_OPC(MOVUPSmr, m128W_x128R, none, none, Other, nullptr, movups, mov, nullptr,
 DEF_OPC(MOVUPSrr, x128W_x128R, none, none, Other, nullptr, movups, mov, movups, OfEmuFull)
 DEF_OPC(MOVUPSrm, x128W_m128R, none, none, Other, nullptr, movups, mov, movups, OfEmuFull)
 
+/* MUL - RDX:RAX = RAX * src */
+DEF_OPC(MUL32m, m32R, mul32, none, Other, nullptr, mul, mul32, mul, OfEmuImm)
+DEF_OPC(MUL32r, r32R, mul32, none, Other, nullptr, mul, mul32, mul, OfEmuImm)
+DEF_OPC(MUL64m, m64R, mul64, none, Other, nullptr, mul, mul64, mul, OfEmuImm)
+DEF_OPC(MUL64r, r64R, mul64, none, Other, nullptr, mul, mul64, mul, OfEmuImm)
+
 /* MULPD */
 DEF_OPC(MULPDrm, x128RW_m128R, none, none, Other, nullptr, mulpd, mulpd, mulpd, OfEmuImm)
 DEF_OPC(MULPDrr, x128RW_x128R, none, none, Other, nullptr, mulpd, mulpd, mulpd, OfEmuImm)
@@ -196,44 +228,44 @@ DEF_OPC(SHR64mi, m64RW_i8, eflagsMW, none, Other, sh, shr, shr64, shr64, OfEmuFu
 DEF_OPC(SHR64ri, r64RW_i8, eflagsMW, none, Other, sh, shr, shr64, shr64, OfEmuFull)
 
 /* SUB */
-DEF_OPC(SUB8mr, m8RW_r8R, eflagsW, none, Other, nullptr, sub, sub8, nullptr, OfEmuImm)
-DEF_OPC(SUB8rr, r8RW_r8R, eflagsW, none, Other, nullptr, sub, sub8, nullptr, OfEmuImm)
-DEF_OPC(SUB8rm, r8RW_m8R, eflagsW, none, Other, nullptr, sub, sub8, nullptr, OfEmuImm)
-DEF_OPC(SUB8mi, m8RW_i8, eflagsW, none, Other, nullptr, sub, sub8, nullptr, OfEmuImm)
-DEF_OPC(SUB8ri, r8RW_i8, eflagsW, none, Other, nullptr, sub, sub8, nullptr, OfEmuImm)
-DEF_OPC(SUB16mr, m16RW_r16R, eflagsW, none, Other, nullptr, sub, sub16, nullptr, OfEmuImm)
-DEF_OPC(SUB16rr, r16RW_r16R, eflagsW, none, Other, nullptr, sub, sub16, nullptr, OfEmuImm)
-DEF_OPC(SUB16rm, r16RW_m16R, eflagsW, none, Other, nullptr, sub, sub16, nullptr, OfEmuImm)
-DEF_OPC(SUB16mi, m16RW_i16, eflagsW, none, Other, nullptr, sub, sub16, nullptr, OfEmuImm)
-DEF_OPC(SUB16ri, r16RW_i16, eflagsW, none, Other, nullptr, sub, sub16, nullptr, OfEmuImm)
-DEF_OPC(SUB32mr, m32RW_r32R, eflagsW, none, Other, nullptr, sub, sub32, nullptr, OfEmuImm)
-DEF_OPC(SUB32rr, r32RW_r32R, eflagsW, none, Other, nullptr, sub, sub32, nullptr, OfEmuImm)
-DEF_OPC(SUB32rm, r32RW_m32R, eflagsW, none, Other, nullptr, sub, sub32, nullptr, OfEmuImm)
-DEF_OPC(SUB32mi, m32RW_i32, eflagsW, none, Other, nullptr, sub, sub32, nullptr, OfEmuImm)
-DEF_OPC(SUB32ri, r32RW_i32, eflagsW, none, Other, nullptr, sub, sub32, nullptr, OfEmuImm)
-DEF_OPC(SUB64mr, m64RW_r64R, eflagsW, none, Other, nullptr, sub, sub64, nullptr, OfEmuPtr)
-DEF_OPC(SUB64rr, r64RW_r64R, eflagsW, none, Other, nullptr, sub, sub64, nullptr, OfEmuPtr)
-DEF_OPC(SUB64rm, r64RW_m64R, eflagsW, none, Other, nullptr, sub, sub64, nullptr, OfEmuPtr)
-DEF_OPC(SUB64mi, m64RW_s32, eflagsW, none, Other, nullptr, sub, sub64, nullptr, OfEmuPtr)
-DEF_OPC(SUB64ri, r64RW_s32, eflagsW, none, Other, nullptr, sub, sub64, nullptr, OfEmuPtr)
+DEF_OPC(SUB8mr, m8RW_r8R, eflagsW, none, Other, nullptr, sub, sub8, sub8, OfEmuImm)
+DEF_OPC(SUB8rr, r8RW_r8R, eflagsW, none, Other, nullptr, sub, sub8, sub8, OfEmuImm)
+DEF_OPC(SUB8rm, r8RW_m8R, eflagsW, none, Other, nullptr, sub, sub8, sub8, OfEmuImm)
+DEF_OPC(SUB8mi, m8RW_i8, eflagsW, none, Other, nullptr, sub, sub8, sub8, OfEmuImm)
+DEF_OPC(SUB8ri, r8RW_i8, eflagsW, none, Other, nullptr, sub, sub8, sub8, OfEmuImm)
+DEF_OPC(SUB16mr, m16RW_r16R, eflagsW, none, Other, nullptr, sub, sub16, sub16, OfEmuImm)
+DEF_OPC(SUB16rr, r16RW_r16R, eflagsW, none, Other, nullptr, sub, sub16, sub16, OfEmuImm)
+DEF_OPC(SUB16rm, r16RW_m16R, eflagsW, none, Other, nullptr, sub, sub16, sub16, OfEmuImm)
+DEF_OPC(SUB16mi, m16RW_i16, eflagsW, none, Other, nullptr, sub, sub16, sub16, OfEmuImm)
+DEF_OPC(SUB16ri, r16RW_i16, eflagsW, none, Other, nullptr, sub, sub16, sub16, OfEmuImm)
+DEF_OPC(SUB32mr, m32RW_r32R, eflagsW, none, Other, nullptr, sub, sub32, sub32, OfEmuImm)
+DEF_OPC(SUB32rr, r32RW_r32R, eflagsW, none, Other, nullptr, sub, sub32, sub32, OfEmuImm)
+DEF_OPC(SUB32rm, r32RW_m32R, eflagsW, none, Other, nullptr, sub, sub32, sub32, OfEmuImm)
+DEF_OPC(SUB32mi, m32RW_i32, eflagsW, none, Other, nullptr, sub, sub32, sub32, OfEmuImm)
+DEF_OPC(SUB32ri, r32RW_i32, eflagsW, none, Other, nullptr, sub, sub32, sub32, OfEmuImm)
+DEF_OPC(SUB64mr, m64RW_r64R, eflagsW, none, Other, nullptr, sub, sub64, sub64, OfEmuPtr)
+DEF_OPC(SUB64rr, r64RW_r64R, eflagsW, none, Other, nullptr, sub, sub64, sub64, OfEmuPtr)
+DEF_OPC(SUB64rm, r64RW_m64R, eflagsW, none, Other, nullptr, sub, sub64, sub64, OfEmuPtr)
+DEF_OPC(SUB64mi, m64RW_s32, eflagsW, none, Other, nullptr, sub, sub64, sub64, OfEmuPtr)
+DEF_OPC(SUB64ri, r64RW_s32, eflagsW, none, Other, nullptr, sub, sub64, sub64, OfEmuPtr)
 
 /* TEST - full emulation because we can always set some flags */
 DEF_OPC(TEST8mr, m8R_r8R, eflagsW, none, Other, nullptr, test, test8, test8, OfEmuFull)
-DEF_OPC(TEST8mi, m8R_i8, eflagsW, none, Other, nullptr, test, test8, nullptr, OfEmuFull)
+DEF_OPC(TEST8mi, m8R_i8, eflagsW, none, Other, nullptr, test, test8, test8, OfEmuFull)
 DEF_OPC(TEST8rr, r8R_r8R, eflagsW, none, Other, nullptr, test, test8, test8, OfEmuFull)
-DEF_OPC(TEST8ri, r8R_i8, eflagsW, none, Other, nullptr, test, test8, nullptr, OfEmuFull)
+DEF_OPC(TEST8ri, r8R_i8, eflagsW, none, Other, nullptr, test, test8, test8, OfEmuFull)
 DEF_OPC(TEST16mr, m16R_r16R, eflagsW, none, Other, nullptr, test, test16, test16, OfEmuFull)
-DEF_OPC(TEST16mi, m16R_i16, eflagsW, none, Other, nullptr, test, test16, nullptr, OfEmuFull)
+DEF_OPC(TEST16mi, m16R_i16, eflagsW, none, Other, nullptr, test, test16, test16, OfEmuFull)
 DEF_OPC(TEST16rr, r16R_r16R, eflagsW, none, Other, nullptr, test, test16, test16, OfEmuFull)
-DEF_OPC(TEST16ri, r16R_i16, eflagsW, none, Other, nullptr, test, test16, nullptr, OfEmuFull)
+DEF_OPC(TEST16ri, r16R_i16, eflagsW, none, Other, nullptr, test, test16, test16, OfEmuFull)
 DEF_OPC(TEST32mr, m32R_r32R, eflagsW, none, Other, nullptr, test, test32, test32, OfEmuFull)
-DEF_OPC(TEST32mi, m32R_i32, eflagsW, none, Other, nullptr, test, test32, nullptr, OfEmuFull)
+DEF_OPC(TEST32mi, m32R_i32, eflagsW, none, Other, nullptr, test, test32, test32, OfEmuFull)
 DEF_OPC(TEST32rr, r32R_r32R, eflagsW, none, Other, nullptr, test, test32, test32, OfEmuFull)
-DEF_OPC(TEST32ri, r32R_i32, eflagsW, none, Other, nullptr, test, test32, nullptr, OfEmuFull)
+DEF_OPC(TEST32ri, r32R_i32, eflagsW, none, Other, nullptr, test, test32, test32, OfEmuFull)
 DEF_OPC(TEST64mr, m64R_r64R, eflagsW, none, Other, nullptr, test, test64, test64, OfEmuFull)
-DEF_OPC(TEST64mi, m64R_s32, eflagsW, none, Other, nullptr, test, test64, nullptr, OfEmuFull)
+DEF_OPC(TEST64mi, m64R_s32, eflagsW, none, Other, nullptr, test, test64, test64, OfEmuFull)
 DEF_OPC(TEST64rr, r64R_r64R, eflagsW, none, Other, nullptr, test, test64, test64, OfEmuFull)
-DEF_OPC(TEST64ri, r64R_s32, eflagsW, none, Other, nullptr, test, test64, nullptr, OfEmuFull)
+DEF_OPC(TEST64ri, r64R_s32, eflagsW, none, Other, nullptr, test, test64, test64, OfEmuFull)
 
 /* XOR
  * - if r1 == r2, r=0 -> No reads!
@@ -0,0 +1,259 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#include "../arch.hpp"
+#include "../Instruction.hpp"
+#include "x86.hpp"
+
+namespace drob {
+
+typedef SpecRet (peephole_f)(const Instruction *prev, Opcode &opcode,
+                             ExplicitStaticOperands &operands,
+                             const LivenessData &livenessData);
+
+typedef struct PeepholePattern {
+    Opcode prev;
+    Opcode opcode;
+    peephole_f *fn;
+} PeepholePattern;
+
+static bool sameMemPtr(const StaticMemPtr &lhs, const StaticMemPtr &rhs)
+{
+    if (lhs.type != rhs.type) {
+        return false;
+    } else if (lhs.type == MemPtrType::Direct) {
+        return lhs.addr.val == rhs.addr.val;
+    }
+    return lhs.sib.base == rhs.sib.base && lhs.sib.index == rhs.sib.index &&
+           lhs.sib.scale == rhs.sib.scale &&
+           lhs.sib.disp.val == rhs.sib.disp.val;
+}
+
+static bool usesRegister(const StaticMemPtr &ptr, Register reg)
+{
+    const RegisterInfo *info = arch_get_register_info(reg);
+    Register parent = info->parent == Register::None ? reg : info->parent;
+
+    return ptr.type == MemPtrType::SIB &&
+           (ptr.sib.base == parent || ptr.sib.index == parent);
+}
+
+/*
+ * CMP with 0 sets the same flags as TEST of the register with itself, except
+ * AF (undefined for TEST). TEST has a shorter encoding.
+ */
+static SpecRet peephole_cmp_zero(__attribute__((unused)) const Instruction *prev,
+                                 Opcode &opcode, ExplicitStaticOperands &operands,
+                                 const LivenessData &livenessData)
+{
+    if (operands.op[1].imm.val ||
+        !!(livenessData.live_out & getSubRegisterMask(Register::AF))) {
+        return SpecRet::NoChange;
+    }
+
+    switch (opcode) {
+    case Opcode::CMP8ri:
+        opcode = Opcode::TEST8rr;
+        break;
+    case Opcode::CMP16ri:
+        opcode = Opcode::TEST16rr;
+        break;
+    case Opcode::CMP32ri:
+        opcode = Opcode::TEST32rr;
+        break;
+    case Opcode::CMP64ri:
+        opcode = Opcode::TEST64rr;
+        break;
+    default:
+        drob_assert_not_reached();
+    }
+    operands.op[1] = {};
+    operands.op[1].reg = operands.op[0].reg;
+    return SpecRet::Change;
+}
+
+/*
+ * Calculate the address directly based on the inputs of the previous LEA,
+ * so both don't depend on each other anymore. The previous LEA might become
+ * dead.
+ */
+static SpecRet peephole_lea_lea(const Instruction *prev, Opcode &opcode,
+                                ExplicitStaticOperands &operands,
+                                __attribute__((unused)) const LivenessData &livenessData)
+{
+    const Register reg = prev->getOperand(0).reg;
+    const StaticMemPtr &prevPtr = prev->getOperand(1).mem;
+    StaticMemPtr &ptr = operands.op[1].mem;
+    (void)opcode;
+
+    if (prevPtr.type != MemPtrType::SIB || ptr.type != MemPtrType::SIB ||
+        prevPtr.sib.disp.usrPtrNr != -1 || ptr.sib.disp.usrPtrNr != -1 ||
+        usesRegister(prevPtr, reg) || ptr.sib.base != reg ||
+        ptr.sib.index != Register::None) {
+        return SpecRet::NoChange;
+    }
+
+    const int64_t disp = (int64_t)prevPtr.sib.disp.val + ptr.sib.disp.val;
+    if (!isDisp32(disp)) {
+        return SpecRet::NoChange;
+    }
+    ptr = prevPtr;
+    ptr.sib.disp.val = disp;
+    return SpecRet::Change;
+}
+
+/*
+ * Reloading a value we just stored can use the register directly.
+ */
+static SpecRet peephole_store_load(const Instruction *prev, Opcode &opcode,
+                                   ExplicitStaticOperands &operands,
+                                   __attribute__((unused)) const LivenessData &livenessData)
+{
+    const Register reg = prev->getOperand(1).reg;
+
+    if (!sameMemPtr(prev->getOperand(0).mem, operands.op[1].mem)) {
+        return SpecRet::NoChange;
+    }
+
+    /* MOV32 zero-extends, so we cannot simply drop it */
+    if (opcode == Opcode::MOV64rm && operands.op[0].reg == reg) {
+        return SpecRet::Delete;
+    }
+    opcode = opcode == Opcode::MOV64rm ? Opcode::MOV64rr : Opcode::MOV32rr;
+    operands.op[1] = {};
+    operands.op[1].reg = reg;
+    return SpecRet::Change;
+}
+
+/*
+ * Storing a value we just loaded from the same location is a NOP.
+ */
+static SpecRet peephole_load_store(const Instruction *prev, Opcode &opcode,
+                                   ExplicitStaticOperands &operands,
+                                   __attribute__((unused)) const LivenessData &livenessData)
+{
+    const Register reg = prev->getOperand(0).reg;
+    (void)opcode;
+
+    if (operands.op[1].reg != reg || usesRegister(operands.op[0].mem, reg) ||
+        !sameMemPtr(prev->getOperand(1).mem, operands.op[0].mem)) {
+        return SpecRet::NoChange;
+    }
+    return SpecRet::Delete;
+}
+
+/*
+ * Copying a register back (or copying it again) is a NOP.
+ */
+static SpecRet peephole_copy_copy(const Instruction *prev, Opcode &opcode,
+                                  ExplicitStaticOperands &operands,
+                                  __attribute__((unused)) const LivenessData &livenessData)
+{
+    const Register dst = prev->getOperand(0).reg;
+    const Register src = prev->getOperand(1).reg;
+    (void)opcode;
+
+    if ((operands.op[0].reg == src && operands.op[1].reg == dst) ||
+        (operands.op[0].reg == dst && operands.op[1].reg == src)) {
+        return SpecRet::Delete;
+    }
+    return SpecRet::NoChange;
+}
+
+/*
+ * Read the original register instead of the copy, if the copy is not
+ * used afterwards. The copy will become dead.
+ */
+static SpecRet peephole_copy_use(const Instruction *prev, Opcode &opcode,
+                                 ExplicitStaticOperands &operands,
+                                 const LivenessData &livenessData)
+{
+    const Register dst = prev->getOperand(0).reg;
+    const Register src = prev->getOperand(1).reg;
+    (void)opcode;
+
+    if (dst == src || operands.op[1].reg != dst || operands.op[0].reg == dst ||
+        !!(livenessData.live_out & getSubRegisterMask(dst))) {
+        return SpecRet::NoChange;
+    }
+    operands.op[1].reg = src;
+    return SpecRet::Change;
+}
+
+/*
+ * Use the (aligned) memory operand of the previous load directly in a packed
+ * SSE operation, if the loaded register is not used afterwards. The load
+ * will become dead.
+ */
+static SpecRet peephole_load_sse(const Instruction *prev, Opcode &opcode,
+                                 ExplicitStaticOperands &operands,
+                                 const LivenessData &livenessData)
+{
+    const Register reg = prev->getOperand(0).reg;
+
+    if (operands.op[1].reg != reg || operands.op[0].reg == reg ||
+        !!(livenessData.live_out & getSubRegisterMask(reg))) {
+        return SpecRet::NoChange;
+    }
+
+    switch (opcode) {
+    case Opcode::ADDPDrr:
+        opcode = Opcode::ADDPDrm;
+        break;
+    case Opcode::MULPDrr:
+        opcode = Opcode::MULPDrm;
+        break;
+    default:
+        drob_assert_not_reached();
+    }
+    operands.op[1] = {};
+    operands.op[1].mem = prev->getOperand(1).mem;
+    return SpecRet::Change;
+}
+
+static const PeepholePattern patterns[] = {
+#define DEF_PEEPHOLE(_PREV, _OPC, _FN) \
+    { \
+        .prev = Opcode::_PREV, \
+        .opcode = Opcode::_OPC, \
+        .fn = peephole_##_FN, \
+    },
+#include "Peephole.inc.h"
+#undef DEF_PEEPHOLE
+};
+
+SpecRet arch_peephole(const Instruction *prev, Opcode &opcode,
+                      ExplicitStaticOperands &operands,
+                      const LivenessData &livenessData)
+{
+    for (const auto & pattern : patterns) {
+        SpecRet ret;
+
+        if (pattern.opcode != opcode) {
+            continue;
+        } else if (pattern.prev != Opcode::NONE &&
+                   (!prev || prev->getOpcode() != pattern.prev)) {
+            continue;
+        }
+
+        ret = pattern.fn(prev, opcode, operands, livenessData);
+        if (ret != SpecRet::NoChange) {
+            return ret;
+        }
+    }
+    return SpecRet::NoChange;
+}
+
+} /* namespace drob */
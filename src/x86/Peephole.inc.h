@@ -0,0 +1,58 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+
+/*
+ * Peephole patterns. A pattern matches an instruction and (optionally) the
+ * instruction directly preceding it in the same block. Only the matched
+ * instruction will get replaced/dropped.
+ *
+ * General format:
+ * - Opcode of the preceding instruction (NONE for any)
+ * - Opcode of the instruction
+ * - Match and rewrite callback
+ */
+
+/* cmp reg, 0 -> test reg, reg */
+DEF_PEEPHOLE(NONE, CMP8ri, cmp_zero)
+DEF_PEEPHOLE(NONE, CMP16ri, cmp_zero)
+DEF_PEEPHOLE(NONE, CMP32ri, cmp_zero)
+DEF_PEEPHOLE(NONE, CMP64ri, cmp_zero)
+
+/* lea r1, [r2 + d1]; lea r3, [r1 + d2] -> lea r1, [r2 + d1]; lea r3, [r2 + d1 + d2] */
+DEF_PEEPHOLE(LEA64ra, LEA64ra, lea_lea)
+
+/* mov [m], r1; mov r2, [m] -> mov [m], r1; mov r2, r1 */
+DEF_PEEPHOLE(MOV32mr, MOV32rm, store_load)
+DEF_PEEPHOLE(MOV64mr, MOV64rm, store_load)
+
+/* mov r1, [m]; mov [m], r1 -> mov r1, [m] */
+DEF_PEEPHOLE(MOV32rm, MOV32mr, load_store)
+DEF_PEEPHOLE(MOV64rm, MOV64mr, load_store)
+
+/* mov r1, r2; mov r2, r1 -> mov r1, r2 */
+DEF_PEEPHOLE(MOV64rr, MOV64rr, copy_copy)
+
+/* mov r2, r1; op r3, r2 -> mov r2, r1; op r3, r1 (if r2 is dead) */
+DEF_PEEPHOLE(MOV64rr, ADD64rr, copy_use)
+DEF_PEEPHOLE(MOV64rr, CMP64rr, copy_use)
+DEF_PEEPHOLE(MOV64rr, MOV64rr, copy_use)
+DEF_PEEPHOLE(MOV64rr, SUB64rr, copy_use)
+DEF_PEEPHOLE(MOV64rr, TEST64rr, copy_use)
+DEF_PEEPHOLE(MOV64rr, XOR64rr, copy_use)
+
+/* movapd x1, [m]; addpd x2, x1 -> movapd x1, [m]; addpd x2, [m] (if x1 is dead) */
+DEF_PEEPHOLE(MOVAPDrm, ADDPDrr, load_sse)
+DEF_PEEPHOLE(MOVAPDrm, MULPDrr, load_sse)
@@ -13,7 +13,11 @@
  * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
  * in the COPYING.LESSER files in the top-level directory for more details.
  */
+#include <list>
+#include <memory>
+
 #include "Specialize.hpp"
+#include "../arch.hpp"
 #include "../InstructionInfo.hpp"
 #include "../RewriterCfg.hpp"
 #include "../BinaryPool.hpp"
@@ -78,89 +82,624 @@ static bool getImm(const DynamicValue &data, Immediate64 &imm, const RewriterCfg
  * But as we use a constant pool, loading from memory might not be that bad?
  */
 
-DEF_SPECIALIZE_FN(add64)
+
+/*
+ * The different operand forms of one operation with a given operand size.
+ * Opcode::NONE if a form does not exist. This allows to share the
+ * specialization logic between all operand sizes of an operation.
+ */
+typedef struct OpcodeForms {
+    Opcode rr;
+    Opcode rm;
+    Opcode mr;
+    Opcode ri;
+    Opcode mi;
+    /* Immediates are sign-extended 32bit values */
+    bool simm32;
+    /* Writing the register zeroes the upper half of the parent register */
+    bool zeroExtends;
+} OpcodeForms;
+
+#define DEF_FORMS(_OPC, _SIMM32, _ZEXT) \
+static const OpcodeForms forms_##_OPC = { \
+    .rr = Opcode::_OPC##rr, \
+    .rm = Opcode::_OPC##rm, \
+    .mr = Opcode::_OPC##mr, \
+    .ri = Opcode::_OPC##ri, \
+    .mi = Opcode::_OPC##mi, \
+    .simm32 = _SIMM32, \
+    .zeroExtends = _ZEXT, \
+}
+
+#define DEF_FORMS_NO_RM(_OPC, _SIMM32, _ZEXT) \
+static const OpcodeForms forms_##_OPC = { \
+    .rr = Opcode::_OPC##rr, \
+    .rm = Opcode::NONE, \
+    .mr = Opcode::_OPC##mr, \
+    .ri = Opcode::_OPC##ri, \
+    .mi = Opcode::_OPC##mi, \
+    .simm32 = _SIMM32, \
+    .zeroExtends = _ZEXT, \
+}
+
+DEF_FORMS(ADD8, false, false);
+DEF_FORMS(ADD16, false, false);
+DEF_FORMS(ADD32, false, true);
+DEF_FORMS(ADD64, true, false);
+DEF_FORMS(CMP8, false, false);
+DEF_FORMS(CMP16, false, false);
+DEF_FORMS(CMP32, false, false);
+DEF_FORMS(CMP64, true, false);
+/* MOV64ri takes a full 64bit immediate, only MOV64mi is sign-extended */
+DEF_FORMS(MOV32, false, true);
+DEF_FORMS(MOV64, true, false);
+DEF_FORMS(SUB8, false, false);
+DEF_FORMS(SUB16, false, false);
+DEF_FORMS(SUB32, false, true);
+DEF_FORMS(SUB64, true, false);
+DEF_FORMS_NO_RM(TEST8, false, false);
+DEF_FORMS_NO_RM(TEST16, false, false);
+DEF_FORMS_NO_RM(TEST32, false, false);
+DEF_FORMS_NO_RM(TEST64, true, false);
+DEF_FORMS(XOR32, false, true);
+DEF_FORMS(XOR64, true, false);
+
+/*
+ * Shifts have a register (CL) or an immediate as count.
+ */
+typedef struct ShiftForms {
+    Opcode r;
+    Opcode m;
+    Opcode ri;
+    Opcode mi;
+} ShiftForms;
+
+#define DEF_SHIFT_FORMS(_OPC) \
+static const ShiftForms forms_##_OPC = { \
+    .r = Opcode::_OPC##r, \
+    .m = Opcode::_OPC##m, \
+    .ri = Opcode::_OPC##ri, \
+    .mi = Opcode::_OPC##mi, \
+}
+
+DEF_SHIFT_FORMS(SHL64);
+DEF_SHIFT_FORMS(SHR64);
+
+/*
+ * Two and three operand forms of signed multiplications. Strength reduction
+ * replaces them by LEA/MOV of the same operand size.
+ */
+typedef struct MultiplyForms {
+    Opcode rr;
+    Opcode rm;
+    Opcode rri;
+    Opcode rmi;
+    Opcode lea;
+    const OpcodeForms *movForms;
+    /* Immediates are sign-extended 32bit values */
+    bool simm32;
+} MultiplyForms;
+
+#define DEF_MULTIPLY_FORMS(_OPC, _LEA, _MOV_FORMS, _SIMM32) \
+static const MultiplyForms forms_##_OPC = { \
+    .rr = Opcode::_OPC##rr, \
+    .rm = Opcode::_OPC##rm, \
+    .rri = Opcode::_OPC##rri, \
+    .rmi = Opcode::_OPC##rmi, \
+    .lea = Opcode::_LEA, \
+    .movForms = &_MOV_FORMS, \
+    .simm32 = _SIMM32, \
+}
+
+DEF_MULTIPLY_FORMS(IMUL32, LEA32ra, forms_MOV32, false);
+DEF_MULTIPLY_FORMS(IMUL64, LEA64ra, forms_MOV64, true);
+
+/*
+ * Translate a 64bit GPRS into the 32bit GPRS (e.g. RAX -> EAX).
+ */
+static inline Register gprs64To32(Register reg)
+{
+    const Register reg32 = static_cast<Register>(static_cast<uint8_t>(reg) + 1);
+
+    drob_assert(arch_get_register_info(reg)->type == RegisterType::Gprs64);
+    drob_assert(arch_get_register_info(reg32)->type == RegisterType::Gprs32);
+    return reg32;
+}
+
+/*
+ * Translate a 32bit GPRS into the 64bit GPRS (e.g. EAX -> RAX), required when
+ * used for addressing.
+ */
+static inline Register gprsTo64(Register reg)
+{
+    const RegisterInfo *info = arch_get_register_info(reg);
+
+    if (info->type == RegisterType::Gprs64) {
+        return reg;
+    }
+    drob_assert(info->type == RegisterType::Gprs32);
+    return info->parent;
+}
+
+/*
+ * Set an LEA address operand "[base + index * scale]".
+ */
+static void setLeaOperand(StaticOperand &op, Register base, Register index,
+                          uint8_t scale)
+{
+    op.mem.type = MemPtrType::SIB;
+    op.mem.sib.base = base;
+    op.mem.sib.index = index;
+    op.mem.sib.scale = scale;
+    op.mem.sib.disp.val = 0;
+    op.mem.sib.disp.usrPtrNr = -1;
+}
+
+/*
+ * The RHS (operand 1) of an rr/rm/mr form is known. Encode it as an immediate
+ * or, if that is not possible, load it from the constant pool.
+ */
+static SpecRet specializeRhsImm(const OpcodeForms &forms, Opcode &opcode,
+                                ExplicitStaticOperands &explOperands,
+                                const Immediate64 &imm, BinaryPool &binaryPool)
+{
+    if (opcode == forms.ri || opcode == forms.mi) {
+        return SpecRet::NoChange;
+    }
+
+    if (!forms.simm32 || is_simm32(imm.val)) {
+        opcode = opcode == forms.mr ? forms.mi : forms.ri;
+        explOperands.op[1].imm = imm;
+        return SpecRet::Change;
+    } else if (imm.usrPtrNr < 0 && forms.rm != Opcode::NONE &&
+               (opcode == forms.rr || opcode == forms.rm)) {
+        /* don't move UsrPtr to the constant pool */
+        opcode = forms.rm;
+        explOperands.op[1].mem.type = MemPtrType::Direct;
+        explOperands.op[1].mem.addr.val = (uint64_t)binaryPool.allocConstant(imm.val);
+        explOperands.op[1].mem.addr.usrPtrNr = -1;
+        return SpecRet::Change;
+    }
+    return SpecRet::NoChange;
+}
+
+/*
+ * The result (operand 0) of an instruction is known and eflags are not
+ * relevant. Replace the instruction by a MOV (or XOR for 0).
+ */
+static SpecRet specializeKnownResult(const OpcodeForms &movForms, bool isMem,
+                                     Opcode &opcode,
+                                     ExplicitStaticOperands &explOperands,
+                                     const Immediate64 &imm)
+{
+    if (isMem) {
+        if (movForms.simm32 && !is_simm32(imm.val)) {
+            return SpecRet::NoChange;
+        }
+        opcode = movForms.mi;
+        explOperands.op[1].imm = imm;
+        return SpecRet::Change;
+    }
+
+    /* result is 0 - use XOR32rr (zeroes the upper half) */
+    if (imm.usrPtrNr < 0 && !imm.val) {
+        if (!movForms.zeroExtends) {
+            explOperands.op[0].reg = gprs64To32(explOperands.op[0].reg);
+        }
+        opcode = Opcode::XOR32rr;
+        explOperands.op[1].reg = explOperands.op[0].reg;
+        return SpecRet::Change;
+    }
+    opcode = movForms.ri;
+    explOperands.op[1].imm = imm;
+    return SpecRet::Change;
+}
+
+/*
+ * "a = a OP b" (ADD, SUB, XOR) with "b == 0" being a NOP and - if lhsZeroIsMov -
+ * "a == 0" resulting in a simple move. movForms are the MOV forms of the same
+ * operand size, if available.
+ */
+static SpecRet specializeBinaryOp(const OpcodeForms &forms,
+                                  const OpcodeForms *movForms,
+                                  bool lhsZeroIsMov, Opcode &opcode,
+                                  ExplicitStaticOperands &explOperands,
+                                  const DynamicInstructionInfo &dynInfo,
+                                  const LivenessData &livenessData,
+                                  const RewriterCfg &cfg,
+                                  BinaryPool &binaryPool)
 {
     const bool eflagsRead = registersWillBeRead(livenessData, eflags);
+    const bool isMem = opcode == forms.mr || opcode == forms.mi;
     Immediate64 imm;
 
-    /* TODO:
-     * we could convert to LEA if eflags not read -> might harm performance?
-     * we could convert to INC if eflags are not read -> also bad for performance?
-     */
-
     /* If eflags are not of interest, we can do some nice optimizations */
     if (!eflagsRead) {
-        /* RHS is 0 -> the instruction has no effect */
-        if (getImm(dynInfo.operands[1].input, imm, cfg) && !imm.val) {
+        /*
+         * RHS is 0 -> the instruction has no effect. Careful, writing
+         * 32bit registers zeroes the upper half.
+         */
+        if (getImm(dynInfo.operands[1].input, imm, cfg) && !imm.val &&
+            (isMem || !forms.zeroExtends)) {
             return SpecRet::Delete;
         }
 
+        if (!movForms) {
+            goto rhs;
+        }
+
         /* Output known ? */
-        if (getImm(dynInfo.operands[0].output, imm, cfg)) {
-            if (opcode == Opcode::ADD64mr || opcode == Opcode::ADD64mi) {
-                if (is_simm32(imm.val)) {
-                    opcode = Opcode::MOV64mi;
-                    explOperands.op[1].imm = imm;
-                    return SpecRet::Change;
-                }
-            } else {
-                /* result is 0 - use XORrr */
-                if (imm.val == 0) {
-                    /* TODO: use XOR32rr -> have to translate register */
-                    opcode = Opcode::XOR64rr;
-                    explOperands.op[1].reg = explOperands.op[0].reg;
-                    return SpecRet::Change;
-                }
-                opcode = Opcode::MOV64ri;
-                explOperands.op[1].imm = imm;
-                return SpecRet::Change;
-            }
+        if (getImm(dynInfo.operands[0].output, imm, cfg) &&
+            specializeKnownResult(*movForms, isMem, opcode, explOperands,
+                                  imm) == SpecRet::Change) {
+            return SpecRet::Change;
         }
 
         /* LHS is 0 -> simple MOV */
-        if (getImm(dynInfo.operands[0].input, imm, cfg) && !imm.val) {
-            if (opcode == Opcode::ADD64rr) {
-                opcode = Opcode::MOV64rr;
+        if (lhsZeroIsMov && getImm(dynInfo.operands[0].input, imm, cfg) &&
+            !imm.val) {
+            if (opcode == forms.rr) {
+                opcode = movForms->rr;
                 return SpecRet::Change;
-            } else if (opcode == Opcode::ADD64mr) {
-                opcode = Opcode::MOV64mr;
+            } else if (opcode == forms.mr) {
+                opcode = movForms->mr;
                 return SpecRet::Change;
-            } else if (opcode == Opcode::ADD64rm) {
-                opcode = Opcode::MOV64rm;
+            } else if (opcode == forms.rm) {
+                opcode = movForms->rm;
                 return SpecRet::Change;
             }
         }
     }
 
-    if (opcode == Opcode::ADD64mi || opcode == Opcode::ADD64ri) {
+rhs:
+    /* RHS known and eflags relevant */
+    if (getImm(dynInfo.operands[1].input, imm, cfg)) {
+        return specializeRhsImm(forms, opcode, explOperands, imm, binaryPool);
+    }
+    return SpecRet::NoChange;
+}
+
+/*
+ * "a CMP b" - only eflags are written.
+ */
+static SpecRet specializeCompareOp(const OpcodeForms &forms, Opcode &opcode,
+                                   ExplicitStaticOperands &explOperands,
+                                   const DynamicInstructionInfo &dynInfo,
+                                   const RewriterCfg &cfg,
+                                   BinaryPool &binaryPool)
+{
+    Immediate64 imm;
+
+    if (getImm(dynInfo.operands[1].input, imm, cfg)) {
+        return specializeRhsImm(forms, opcode, explOperands, imm, binaryPool);
+    }
+    return SpecRet::NoChange;
+}
+
+/*
+ * "a TEST b" - only eflags are written, operands are interchangeable.
+ */
+static SpecRet specializeTestOp(const OpcodeForms &forms, Opcode &opcode,
+                                ExplicitStaticOperands &explOperands,
+                                const DynamicInstructionInfo &dynInfo,
+                                const RewriterCfg &cfg,
+                                BinaryPool &binaryPool)
+{
+    Immediate64 imm;
+
+    if (opcode == forms.rr &&
+        explOperands.op[0].reg == explOperands.op[1].reg) {
+        return SpecRet::NoChange;
+    }
+
+    if (getImm(dynInfo.operands[1].input, imm, cfg) &&
+        specializeRhsImm(forms, opcode, explOperands, imm,
+                         binaryPool) == SpecRet::Change) {
+        return SpecRet::Change;
+    }
+
+    /* We can switch operand positions to encode the LHS as an immediate */
+    if ((opcode == forms.rr || opcode == forms.mr) &&
+        getImm(dynInfo.operands[0].input, imm, cfg)) {
+        if (!forms.simm32 || is_simm32(imm.val)) {
+            opcode = forms.ri;
+            explOperands.op[0].reg = explOperands.op[1].reg;
+            explOperands.op[1].imm = imm;
+            return SpecRet::Change;
+        }
+    }
+    return SpecRet::NoChange;
+}
+
+/*
+ * "reg = imm" - use a shorter encoding if possible. ret is returned if nothing
+ * changed.
+ */
+static SpecRet specializeMovImm(const OpcodeForms &forms,
+                                const OpcodeForms *narrowForms, Opcode &opcode,
+                                ExplicitStaticOperands &explOperands,
+                                const LivenessData &livenessData, SpecRet ret)
+{
+    const Immediate64 imm = explOperands.op[1].imm;
+
+    if (imm.usrPtrNr >= 0) {
+        return ret;
+    }
+    /* XOR is shorter, but writes eflags */
+    if (!imm.val && !registersWillBeRead(livenessData, eflags)) {
+        if (!forms.zeroExtends) {
+            explOperands.op[0].reg = gprs64To32(explOperands.op[0].reg);
+        }
+        opcode = Opcode::XOR32rr;
+        explOperands.op[1].reg = explOperands.op[0].reg;
+        return SpecRet::Change;
+    }
+    /* Shorter encoding, the upper half will be zeroed */
+    if (narrowForms && is_imm32(imm.val)) {
+        opcode = narrowForms->ri;
+        explOperands.op[0].reg = gprs64To32(explOperands.op[0].reg);
+        return SpecRet::Change;
+    }
+    return ret;
+}
+
+/*
+ * "a = b" - narrowForms are the forms of the next smaller operand size that
+ * zero extend, if available.
+ */
+static SpecRet specializeMovOp(const OpcodeForms &forms,
+                               const OpcodeForms *narrowForms, Opcode &opcode,
+                               ExplicitStaticOperands &explOperands,
+                               const DynamicInstructionInfo &dynInfo,
+                               const LivenessData &livenessData,
+                               const RewriterCfg &cfg)
+{
+    Immediate64 imm;
+
+    /* Careful, writing 32bit registers zeroes the upper half. */
+    if (unlikely(opcode == forms.rr && !forms.zeroExtends &&
+                 explOperands.op[0].reg == explOperands.op[1].reg)) {
+        return SpecRet::Delete;
+    }
+
+    if (opcode == forms.ri) {
+        return specializeMovImm(forms, narrowForms, opcode, explOperands,
+                                livenessData, SpecRet::NoChange);
+    } else if (opcode == forms.mi) {
         return SpecRet::NoChange;
     }
 
-    /* RHS known and eflags relevant */
     if (getImm(dynInfo.operands[1].input, imm, cfg)) {
-        if (opcode == Opcode::ADD64mr) {
-            if (is_simm32(imm.val)) {
-                opcode = Opcode::ADD64mi;
+        if (opcode == forms.mr) {
+            if (!forms.simm32 || is_simm32(imm.val)) {
+                opcode = forms.mi;
                 explOperands.op[1].imm = imm;
                 return SpecRet::Change;
             }
-        } else if (is_simm32(imm.val)) {
-            opcode = Opcode::ADD64ri;
+        } else {
+            /*
+             * Also a load from constant memory: the value is folded, the
+             * memory access is gone. Try to shorten the immediate right away.
+             */
+            opcode = forms.ri;
             explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        } else if (imm.usrPtrNr < 0) {
-            /* don't move UsrPtr to the constant pool */
-            opcode = Opcode::ADD64rm;
-            explOperands.op[1].mem.type = MemPtrType::Direct;
-            explOperands.op[1].mem.addr.val = (uint64_t)binaryPool.allocConstant(imm.val);
-            explOperands.op[1].mem.addr.usrPtrNr = -1;;
-            return SpecRet::Change;
+            return specializeMovImm(forms, narrowForms, opcode, explOperands,
+                                    livenessData, SpecRet::Change);
+        }
+    }
+    return SpecRet::NoChange;
+}
+
+/*
+ * "a = a SHIFT count"
+ */
+static SpecRet specializeShiftOp(const ShiftForms &forms, Opcode &opcode,
+                                 ExplicitStaticOperands &explOperands,
+                                 const DynamicInstructionInfo &dynInfo,
+                                 const LivenessData &livenessData,
+                                 const RewriterCfg &cfg)
+{
+    const bool eflagsRead = registersWillBeRead(livenessData, eflags);
+    const bool isMem = opcode == forms.m || opcode == forms.mi;
+    Immediate64 imm;
+
+    /* zero shifts can be dropped - eflags are not set for shift==0 */
+    if (getImm(dynInfo.operands[1].input, imm, cfg) && !(imm.val & 0x3f)) {
+        return SpecRet::Delete;
+    }
+
+    /* result known and eflags not relevant? */
+    if (getImm(dynInfo.operands[0].output, imm, cfg) && !eflagsRead &&
+        specializeKnownResult(forms_MOV64, isMem, opcode, explOperands,
+                              imm) == SpecRet::Change) {
+        return SpecRet::Change;
+    }
+
+    /* RHS (CL register) can be encoded as immediate? */
+    if ((opcode == forms.m || opcode == forms.r) &&
+        getImm(dynInfo.operands[1].input, imm, cfg)) {
+        opcode = isMem ? forms.mi : forms.ri;
+        explOperands.op[1].imm = imm;
+        return SpecRet::Change;
+    }
+    return SpecRet::NoChange;
+}
+
+/*
+ * "dst = src * factor" with eflags not being relevant. Some factors can be
+ * handled by a single XOR, MOV, LEA or SHL instead of a multiplication.
+ */
+static SpecRet specializeMultiplyByConst(const MultiplyForms &forms,
+                                         Opcode &opcode,
+                                         ExplicitStaticOperands &explOperands,
+                                         Register dst, Register src,
+                                         uint64_t factor)
+{
+    const bool is64 = forms.lea == Opcode::LEA64ra;
+    const Register src64 = gprsTo64(src);
+    ExplicitStaticOperands operands = {};
+
+    if (!is64) {
+        factor = (uint32_t)factor;
+    }
+
+    operands.op[0].reg = dst;
+    switch (factor) {
+    case 0:
+        opcode = Opcode::XOR32rr;
+        operands.op[0].reg = is64 ? gprs64To32(dst) : dst;
+        operands.op[1].reg = operands.op[0].reg;
+        break;
+    case 1:
+        /* Careful, writing 32bit registers zeroes the upper half. */
+        if (is64 && dst == src) {
+            return SpecRet::Delete;
+        }
+        opcode = forms.movForms->rr;
+        operands.op[1].reg = src;
+        break;
+    case 2:
+    case 3:
+    case 5:
+    case 9:
+        /* [src + src * (factor - 1)] */
+        opcode = forms.lea;
+        setLeaOperand(operands.op[1], src64, src64,
+                      factor == 2 ? 1 : factor - 1);
+        break;
+    default:
+        if (factor & (factor - 1)) {
+            return SpecRet::NoChange;
+        } else if (is64 && dst == src) {
+            opcode = Opcode::SHL64ri;
+            operands.op[1].imm.val = __builtin_ctzll(factor);
+            operands.op[1].imm.usrPtrNr = -1;
+        } else if (factor == 4 || factor == 8) {
+            opcode = forms.lea;
+            setLeaOperand(operands.op[1], Register::None, src64, factor);
+        } else {
+            return SpecRet::NoChange;
         }
     }
+    explOperands = operands;
+    return SpecRet::Change;
+}
 
+/*
+ * "a = a * b" or "a = b * imm" (signed, the lower half is the same for
+ * unsigned multiplications).
+ */
+static SpecRet specializeMultiplyOp(const MultiplyForms &forms, Opcode &opcode,
+                                    ExplicitStaticOperands &explOperands,
+                                    const DynamicInstructionInfo &dynInfo,
+                                    const LivenessData &livenessData,
+                                    const RewriterCfg &cfg)
+{
+    const bool eflagsRead = registersWillBeRead(livenessData, eflags);
+    Immediate64 imm;
+    SpecRet ret;
+
+    /* Only CF and OF are defined - if they are not of interest ... */
+    if (!eflagsRead) {
+        /* Output known ? */
+        if (getImm(dynInfo.operands[0].output, imm, cfg)) {
+            return specializeKnownResult(*forms.movForms, false, opcode,
+                                         explOperands, imm);
+        }
+
+        if (opcode == forms.rri && explOperands.op[2].imm.usrPtrNr < 0) {
+            return specializeMultiplyByConst(forms, opcode, explOperands,
+                                             explOperands.op[0].reg,
+                                             explOperands.op[1].reg,
+                                             explOperands.op[2].imm.val);
+        } else if (opcode == forms.rr || opcode == forms.rm) {
+            /* The factor might also be loaded from constant memory */
+            if (getImm(dynInfo.operands[1].input, imm, cfg) &&
+                imm.usrPtrNr < 0) {
+                ret = specializeMultiplyByConst(forms, opcode, explOperands,
+                                                explOperands.op[0].reg,
+                                                explOperands.op[0].reg,
+                                                imm.val);
+                if (ret != SpecRet::NoChange) {
+                    return ret;
+                }
+            }
+            if (opcode == forms.rr && getImm(dynInfo.operands[0].input, imm, cfg) &&
+                imm.usrPtrNr < 0) {
+                ret = specializeMultiplyByConst(forms, opcode, explOperands,
+                                                explOperands.op[0].reg,
+                                                explOperands.op[1].reg,
+                                                imm.val);
+                if (ret != SpecRet::NoChange) {
+                    return ret;
+                }
+            }
+        }
+    }
+
+    if (opcode == forms.rri || opcode == forms.rmi) {
+        return SpecRet::NoChange;
+    }
+
+    /* Encode a known factor as immediate, eflags are the same */
+    if (getImm(dynInfo.operands[1].input, imm, cfg) &&
+        (!forms.simm32 || is_simm32(imm.val))) {
+        opcode = forms.rri;
+        explOperands.op[1].reg = explOperands.op[0].reg;
+        explOperands.op[2].imm = imm;
+        return SpecRet::Change;
+    } else if (opcode == forms.rr &&
+               getImm(dynInfo.operands[0].input, imm, cfg) &&
+               (!forms.simm32 || is_simm32(imm.val))) {
+        opcode = forms.rri;
+        explOperands.op[2].imm = imm;
+        return SpecRet::Change;
+    }
     return SpecRet::NoChange;
 }
 
+#define GEN_SPECIALIZE_BINARY_FN(_NAME, _FORMS, _MOV_FORMS, _LHS_ZERO_IS_MOV) \
+DEF_SPECIALIZE_FN(_NAME) \
+{ \
+    return specializeBinaryOp(_FORMS, _MOV_FORMS, _LHS_ZERO_IS_MOV, opcode, \
+                              explOperands, dynInfo, livenessData, cfg, \
+                              binaryPool); \
+}
+
+#define GEN_SPECIALIZE_COMPARE_FN(_NAME, _FORMS) \
+DEF_SPECIALIZE_FN(_NAME) \
+{ \
+    return specializeCompareOp(_FORMS, opcode, explOperands, dynInfo, cfg, \
+                               binaryPool); \
+}
+
+#define GEN_SPECIALIZE_TEST_FN(_NAME, _FORMS) \
+DEF_SPECIALIZE_FN(_NAME) \
+{ \
+    return specializeTestOp(_FORMS, opcode, explOperands, dynInfo, cfg, \
+                            binaryPool); \
+}
+
+#define GEN_SPECIALIZE_MOV_FN(_NAME, _FORMS, _NARROW_FORMS) \
+DEF_SPECIALIZE_FN(_NAME) \
+{ \
+    return specializeMovOp(_FORMS, _NARROW_FORMS, opcode, explOperands, \
+                           dynInfo, livenessData, cfg); \
+}
+
+#define GEN_SPECIALIZE_SHIFT_FN(_NAME, _FORMS) \
+DEF_SPECIALIZE_FN(_NAME) \
+{ \
+    return specializeShiftOp(_FORMS, opcode, explOperands, dynInfo, \
+                             livenessData, cfg); \
+}
+
+/* TODO: we could convert ADD to LEA/INC if eflags are not read */
+GEN_SPECIALIZE_BINARY_FN(add8, forms_ADD8, nullptr, false)
+GEN_SPECIALIZE_BINARY_FN(add16, forms_ADD16, nullptr, false)
+GEN_SPECIALIZE_BINARY_FN(add32, forms_ADD32, &forms_MOV32, true)
+GEN_SPECIALIZE_BINARY_FN(add64, forms_ADD64, &forms_MOV64, true)
+
 DEF_SPECIALIZE_FN(addpd)
 {
     __uint128_t imm;
@@ -230,86 +769,68 @@ DEF_SPECIALIZE_FN(addsd)
     return SpecRet::NoChange;
 }
 
-DEF_SPECIALIZE_FN(cmp8)
+GEN_SPECIALIZE_COMPARE_FN(cmp8, forms_CMP8)
+GEN_SPECIALIZE_COMPARE_FN(cmp16, forms_CMP16)
+GEN_SPECIALIZE_COMPARE_FN(cmp32, forms_CMP32)
+GEN_SPECIALIZE_COMPARE_FN(cmp64, forms_CMP64)
+
+/*
+ * DIV/IDIV: all eflags are undefined afterwards.
+ */
+DEF_SPECIALIZE_FN(div)
 {
+    const bool is64 = opcode == Opcode::DIV64r || opcode == Opcode::DIV64m ||
+                      opcode == Opcode::IDIV64r || opcode == Opcode::IDIV64m;
+    const bool rdxRead = registersWillBeRead(livenessData,
+                                             getSubRegisterMask(Register::RDX));
     Immediate64 imm;
 
-    if (getImm(dynInfo.operands[1].input, imm, cfg)) {
-        if (opcode == Opcode::CMP8mr) {
-            opcode = Opcode::CMP8mi;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        } else {
-            opcode = Opcode::CMP8ri;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        }
+    if (registersWillBeRead(livenessData, eflags)) {
+        return SpecRet::NoChange;
     }
-    return SpecRet::NoChange;
-}
 
-DEF_SPECIALIZE_FN(cmp16)
-{
-    Immediate64 imm;
+    /* Only the quotient is of interest and it is known */
+    if (!rdxRead && getImm(dynInfo.operands[1].output, imm, cfg)) {
+        explOperands.op[0] = {};
+        explOperands.op[0].reg = is64 ? Register::RAX : Register::EAX;
+        return specializeKnownResult(is64 ? forms_MOV64 : forms_MOV32, false,
+                                     opcode, explOperands, imm);
+    }
 
-    if (getImm(dynInfo.operands[1].input, imm, cfg)) {
-        if (opcode == Opcode::CMP16mr) {
-            opcode = Opcode::CMP16mi;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        } else {
-            opcode = Opcode::CMP16ri;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        }
+    /* Unsigned division of RAX (RDX is 0) by a power of two */
+    if ((opcode != Opcode::DIV64r && opcode != Opcode::DIV64m) ||
+        !dynInfo.operands[2].input.isImm() ||
+        dynInfo.operands[2].input.getImm64() ||
+        !getImm(dynInfo.operands[0].input, imm, cfg) || imm.usrPtrNr >= 0 ||
+        !imm.val || (imm.val & (imm.val - 1))) {
+        return SpecRet::NoChange;
     }
-    return SpecRet::NoChange;
+    if (imm.val == 1) {
+        /* the remainder (RDX) stays 0 */
+        return SpecRet::Delete;
+    } else if (rdxRead) {
+        return SpecRet::NoChange;
+    }
+    opcode = Opcode::SHR64ri;
+    explOperands.op[0] = {};
+    explOperands.op[0].reg = Register::RAX;
+    explOperands.op[1].imm.val = __builtin_ctzll(imm.val);
+    explOperands.op[1].imm.usrPtrNr = -1;
+    return SpecRet::Change;
 }
 
-DEF_SPECIALIZE_FN(cmp32)
+DEF_SPECIALIZE_FN(imul32)
 {
-    Immediate64 imm;
-
-    if (getImm(dynInfo.operands[1].input, imm, cfg)) {
-        if (opcode == Opcode::CMP32mr) {
-            opcode = Opcode::CMP32mi;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        } else {
-            opcode = Opcode::CMP32ri;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        }
-    }
-    return SpecRet::NoChange;
+    (void)binaryPool;
+    return specializeMultiplyOp(forms_IMUL32, opcode, explOperands, dynInfo,
+                                livenessData, cfg);
 }
 
-DEF_SPECIALIZE_FN(cmp64)
+DEF_SPECIALIZE_FN(imul64)
 {
-    Immediate64 imm;
-
-    if (getImm(dynInfo.operands[1].input, imm, cfg)) {
-        if (is_simm32(imm.val)) {
-            if (opcode == Opcode::CMP64mr) {
-                opcode = Opcode::CMP64mi;
-                explOperands.op[1].imm = imm;
-                return SpecRet::Change;
-            } else {
-                opcode = Opcode::CMP64ri;
-                explOperands.op[1].imm = imm;
-                return SpecRet::Change;
-            }
-        } else if (imm.usrPtrNr < 0 &&
-                   (opcode == Opcode::CMP64rr || opcode == Opcode::CMP64rm)) {
-            /* don't move UsrPtr to the constant pool */
-            opcode = Opcode::CMP64rm;
-            explOperands.op[1].mem.type = MemPtrType::Direct;
-            explOperands.op[1].mem.addr.val = (uint64_t)binaryPool.allocConstant(imm.val);
-            explOperands.op[1].mem.addr.usrPtrNr = -1;
-            return SpecRet::Change;
-        }
-    }
-    return SpecRet::NoChange;
+    (void)binaryPool;
+    return specializeMultiplyOp(forms_IMUL64, opcode, explOperands, dynInfo,
+                                livenessData, cfg);
 }
 
 DEF_SPECIALIZE_FN(lea64)
@@ -319,12 +840,17 @@ DEF_SPECIALIZE_FN(lea64)
     if (getImm(dynInfo.operands[0].output, imm, cfg)) {
         if (imm.usrPtrNr < 0 && !imm.val &&
             !registersWillBeRead(livenessData, eflags)) {
-            /* TODO use XOR32rr -> convert register */
-            opcode = Opcode::XOR64rr;
+            opcode = Opcode::XOR32rr;
+            explOperands.op[0].reg = gprs64To32(explOperands.op[0].reg);
             explOperands.op[1].reg = explOperands.op[0].reg;
             return SpecRet::Change;
+        } else if (imm.usrPtrNr < 0 && is_imm32(imm.val)) {
+            /* shorter encoding, the upper half will be zeroed */
+            opcode = Opcode::MOV32ri;
+            explOperands.op[0].reg = gprs64To32(explOperands.op[0].reg);
+            explOperands.op[1].imm = imm;
+            return SpecRet::Change;
         } else {
-            /* TODO use MOV32ri if is_imm(imm) -> convert register */
             /*
              * This properly makes sure that some addresses from new code
              * (e.g. LEA %RAX, [%RIP + X]) suddenly become reachable :)
@@ -337,71 +863,27 @@ DEF_SPECIALIZE_FN(lea64)
     return SpecRet::NoChange;
 }
 
-DEF_SPECIALIZE_FN(lea32)
-{
-    Immediate64 imm;
-
-    if (getImm(dynInfo.operands[0].output, imm, cfg)) {
-        opcode = Opcode::MOV32ri;
-        explOperands.op[1].imm = imm;
-        return SpecRet::Change;
-    }
-    return SpecRet::NoChange;
-}
-
-DEF_SPECIALIZE_FN(lea16)
-{
-    /* TODO: Implement MOV16ri */
-    return SpecRet::NoChange;
-}
-
-DEF_SPECIALIZE_FN(mov32)
-{
-    Immediate64 imm;
-
-    if (unlikely(opcode == Opcode::MOV32rr &&
-                 explOperands.op[0].reg == explOperands.op[1].reg)) {
-        return SpecRet::Delete;
-    }
-
-    if (getImm(dynInfo.operands[1].input, imm, cfg)) {
-        explOperands.op[1].imm = imm;
-        if (opcode == Opcode::MOV32mr) {
-            opcode = Opcode::MOV32mi;
-            return SpecRet::Change;
-        } else {
-            opcode = Opcode::MOV32ri;
-            return SpecRet::Change;
-        }
-    }
-    return SpecRet::NoChange;
-}
-
-DEF_SPECIALIZE_FN(mov64)
+DEF_SPECIALIZE_FN(lea32)
 {
     Immediate64 imm;
 
-    if (unlikely(opcode == Opcode::MOV64rr &&
-                 explOperands.op[0].reg == explOperands.op[1].reg)) {
-        return SpecRet::Delete;
+    if (getImm(dynInfo.operands[0].output, imm, cfg)) {
+        opcode = Opcode::MOV32ri;
+        explOperands.op[1].imm = imm;
+        return SpecRet::Change;
     }
+    return SpecRet::NoChange;
+}
 
-    if (getImm(dynInfo.operands[1].input, imm, cfg)) {
-        if (opcode == Opcode::MOV64mr) {
-            if (is_simm32(imm.val)) {
-                opcode = Opcode::MOV64mi;
-                explOperands.op[1].imm = imm;
-                return SpecRet::Change;
-            }
-        } else {
-            opcode = Opcode::MOV64ri;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        }
-    }
+DEF_SPECIALIZE_FN(lea16)
+{
+    /* TODO: Implement MOV16ri */
     return SpecRet::NoChange;
 }
 
+GEN_SPECIALIZE_MOV_FN(mov32, forms_MOV32, nullptr)
+GEN_SPECIALIZE_MOV_FN(mov64, forms_MOV64, &forms_MOV32)
+
 /*
  * "In older processors, there was a significant performance penalty for using
  *  the unaligned versions, even when the data was actually aligned.
@@ -474,6 +956,19 @@ DEF_SPECIALIZE_FN(movupd)
         return SpecRet::Delete;
     }
 
+    /*
+     * Aligned accesses don't make a difference performance-wise, however,
+     * MOVAPD loads can be folded into SSE arithmetic instructions (which
+     * require aligned memory operands), see arch_peephole().
+     */
+    if (opcode == Opcode::MOVUPDmr) {
+        if (isPtrAligned(dynInfo.operands[0].memAcc.ptrVal, cfg, 16)) {
+            opcode = Opcode::MOVAPDmr;
+            return SpecRet::Change;
+        }
+        return SpecRet::NoChange;
+    }
+
     if (dynInfo.operands[0].output.isImm()) {
         imm = dynInfo.operands[0].output.getImm128();
         if (!imm) {
@@ -489,19 +984,11 @@ DEF_SPECIALIZE_FN(movupd)
         }
     }
 
-    /*
-     * TODO: Convert to MOVAPD if possible - although it might not matter for
-     * performance, it allows us to easily convert
-     *
-     * movupd xmm0, xmmword ptr [r9+rax*1]
-     * addpd xmm0, xmm4
-     *
-     * into
-     *
-     * addpd xmm0, xmmword ptr [r9+rax*1]
-     *
-     * ... or detect this via memory pointers somehow "last one writing xmm0" :)
-     */
+    if (opcode == Opcode::MOVUPDrm &&
+        isPtrAligned(dynInfo.operands[1].memAcc.ptrVal, cfg, 16)) {
+        opcode = Opcode::MOVAPDrm;
+        return SpecRet::Change;
+    }
     return SpecRet::NoChange;
 }
 
@@ -524,6 +1011,71 @@ DEF_SPECIALIZE_FN(movups)
     return SpecRet::NoChange;
 }
 
+/*
+ * MUL/IMUL (one operand form): "RDX:RAX = RAX * src". If only the lower half
+ * (RAX) is of interest, this is a two/three operand IMUL.
+ */
+DEF_SPECIALIZE_FN(mul)
+{
+    const bool is64 = opcode == Opcode::MUL64r || opcode == Opcode::MUL64m ||
+                      opcode == Opcode::IMUL64r || opcode == Opcode::IMUL64m;
+    const bool isMem = dynInfo.operands[0].type == OperandType::MemPtr;
+    const MultiplyForms &forms = is64 ? forms_IMUL64 : forms_IMUL32;
+    const Register rax = is64 ? Register::RAX : Register::EAX;
+    Immediate64 imm;
+    SpecRet ret;
+
+    (void)binaryPool;
+
+    if (registersWillBeRead(livenessData, eflags) ||
+        registersWillBeRead(livenessData, getSubRegisterMask(Register::RDX))) {
+        return SpecRet::NoChange;
+    }
+
+    /* Output known ? */
+    if (getImm(dynInfo.operands[1].output, imm, cfg)) {
+        explOperands.op[0] = {};
+        explOperands.op[0].reg = rax;
+        return specializeKnownResult(*forms.movForms, false, opcode,
+                                     explOperands, imm);
+    }
+
+    if (getImm(dynInfo.operands[0].input, imm, cfg) && imm.usrPtrNr < 0) {
+        /* "RAX = RAX * imm" */
+        ret = specializeMultiplyByConst(forms, opcode, explOperands, rax, rax,
+                                        imm.val);
+        if (ret != SpecRet::NoChange) {
+            return ret;
+        } else if (!forms.simm32 || is_simm32(imm.val)) {
+            opcode = forms.rri;
+            explOperands.op[0] = {};
+            explOperands.op[0].reg = rax;
+            explOperands.op[1].reg = rax;
+            explOperands.op[2].imm = imm;
+            return SpecRet::Change;
+        }
+    } else if (getImm(dynInfo.operands[1].input, imm, cfg) &&
+               imm.usrPtrNr < 0) {
+        /* "RAX = src * imm" */
+        if (!isMem) {
+            ret = specializeMultiplyByConst(forms, opcode, explOperands, rax,
+                                            explOperands.op[0].reg, imm.val);
+            if (ret != SpecRet::NoChange) {
+                return ret;
+            }
+        }
+        if (!forms.simm32 || is_simm32(imm.val)) {
+            opcode = isMem ? forms.rmi : forms.rri;
+            explOperands.op[1] = explOperands.op[0];
+            explOperands.op[0] = {};
+            explOperands.op[0].reg = rax;
+            explOperands.op[2].imm = imm;
+            return SpecRet::Change;
+        }
+    }
+    return SpecRet::NoChange;
+}
+
 DEF_SPECIALIZE_FN(mulpd)
 {
     __uint128_t imm;
@@ -649,301 +1201,258 @@ DEF_SPECIALIZE_FN(pxor)
     return SpecRet::NoChange;
 }
 
-DEF_SPECIALIZE_FN(shl64)
-{
-    const bool eflagsRead = registersWillBeRead(livenessData, eflags);
-    Immediate64 imm;
 
-    /* zero shifts can be dropped - eflags are not set for shift==0 */
-    if (getImm(dynInfo.operands[1].input, imm, cfg) && !(imm.val & 0x3f)) {
-        return SpecRet::Delete;
-    }
+GEN_SPECIALIZE_SHIFT_FN(shl64, forms_SHL64)
+GEN_SPECIALIZE_SHIFT_FN(shr64, forms_SHR64)
 
-    /* result known and eflags not relevant? */
-    if (getImm(dynInfo.operands[0].output, imm, cfg) && !eflagsRead) {
-        if (opcode == Opcode::SHL64m || opcode == Opcode::SHL64mi) {
-            if (is_simm32(imm.val)) {
-                opcode = Opcode::MOV64mi;
-                explOperands.op[1].imm = imm;
-                return SpecRet::Change;
-            }
-        } else {
-            /* result is 0 - use XORrr */
-            if (imm.val == 0) {
-                /* TODO: use XOR32rr -> have to translate register */
-                opcode = Opcode::XOR64rr;
-                explOperands.op[1].reg = explOperands.op[0].reg;
-                return SpecRet::Change;
-            }
-            opcode = Opcode::MOV64ri;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        }
-    }
+GEN_SPECIALIZE_BINARY_FN(sub8, forms_SUB8, nullptr, false)
+GEN_SPECIALIZE_BINARY_FN(sub16, forms_SUB16, nullptr, false)
+GEN_SPECIALIZE_BINARY_FN(sub32, forms_SUB32, &forms_MOV32, false)
+GEN_SPECIALIZE_BINARY_FN(sub64, forms_SUB64, &forms_MOV64, false)
 
-    if (opcode == Opcode::SHL64m || opcode == Opcode::SHL64r) {
-        /* RHS (CL register) can be encoded as immediate? */
-        if (getImm(dynInfo.operands[1].input, imm, cfg)) {
+GEN_SPECIALIZE_TEST_FN(test8, forms_TEST8)
+GEN_SPECIALIZE_TEST_FN(test16, forms_TEST16)
+GEN_SPECIALIZE_TEST_FN(test32, forms_TEST32)
+GEN_SPECIALIZE_TEST_FN(test64, forms_TEST64)
 
-            if (opcode == Opcode::SHL64m) {
-                opcode = Opcode::SHL64mi;
-                explOperands.op[1].imm = imm;
-                return SpecRet::Change;
-            } else {
-                opcode = Opcode::SHL64ri;
-                explOperands.op[1].imm = imm;
-                return SpecRet::Change;
-            }
-        }
+DEF_SPECIALIZE_FN(xor32)
+{
+    /* XOR32rr with identical registers is already the best way to zero */
+    if (opcode == Opcode::XOR32rr &&
+        explOperands.op[0].reg == explOperands.op[1].reg) {
+        return SpecRet::NoChange;
     }
-    return SpecRet::NoChange;
+    return specializeBinaryOp(forms_XOR32, &forms_MOV32, true, opcode,
+                              explOperands, dynInfo, livenessData, cfg,
+                              binaryPool);
 }
 
-DEF_SPECIALIZE_FN(shr64)
+DEF_SPECIALIZE_FN(xor64)
 {
-    const bool eflagsRead = registersWillBeRead(livenessData, eflags);
-    Immediate64 imm;
-
-    /* zero shifts can be dropped - eflags are not set for shift==0 */
-    if (getImm(dynInfo.operands[1].input, imm, cfg) && !(imm.val & 0x3f)) {
-        return SpecRet::Delete;
-    }
-
-    /* result known and eflags not relevant? */
-    if (getImm(dynInfo.operands[0].output, imm, cfg) && !eflagsRead) {
-        if (opcode == Opcode::SHR64m || opcode == Opcode::SHR64mi) {
-            if (is_simm32(imm.val)) {
-                opcode = Opcode::MOV64mi;
-                explOperands.op[1].imm = imm;
-                return SpecRet::Change;
-            }
-        } else {
-            /* result is 0 - use XORrr */
-            if (imm.val == 0) {
-                /* TODO: use XOR32rr -> have to translate register */
-                opcode = Opcode::XOR64rr;
-                explOperands.op[1].reg = explOperands.op[0].reg;
-                return SpecRet::Change;
-            }
-            opcode = Opcode::MOV64ri;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        }
+    if (opcode == Opcode::XOR64rr &&
+        explOperands.op[0].reg == explOperands.op[1].reg) {
+        /*
+         * XOR32rr has a shorter encoding, also zeroes the upper half and
+         * results in the same eflags.
+         */
+        opcode = Opcode::XOR32rr;
+        explOperands.op[0].reg = gprs64To32(explOperands.op[0].reg);
+        explOperands.op[1].reg = explOperands.op[0].reg;
+        return SpecRet::Change;
     }
+    return specializeBinaryOp(forms_XOR64, &forms_MOV64, true, opcode,
+                              explOperands, dynInfo, livenessData, cfg,
+                              binaryPool);
+}
 
-    if (opcode == Opcode::SHR64m || opcode == Opcode::SHR64r) {
-        /* RHS (CL register) can be encoded as immediate? */
-        if (getImm(dynInfo.operands[1].input, imm, cfg)) {
+/*
+ * Strength reduction that requires multiple instructions - used by the
+ * StrengthReductionPass. Single instruction replacements are already handled
+ * by the specialize callbacks above.
+ */
 
-            if (opcode == Opcode::SHR64m) {
-                opcode = Opcode::SHR64mi;
-                explOperands.op[1].imm = imm;
-                return SpecRet::Change;
-            } else {
-                opcode = Opcode::SHR64ri;
-                explOperands.op[1].imm = imm;
-                return SpecRet::Change;
-            }
-        }
-    }
-    return SpecRet::NoChange;
+static void addInstruction(std::list<std::unique_ptr<Instruction>> &instrs,
+                           Opcode opcode, const ExplicitStaticOperands &operands)
+{
+    instrs.emplace_back(std::make_unique<Instruction>(opcode, operands));
 }
 
-DEF_SPECIALIZE_FN(test8)
+static void addLea(std::list<std::unique_ptr<Instruction>> &instrs,
+                   Opcode lea, Register dst, Register base, Register index,
+                   uint8_t scale)
 {
-    Immediate64 imm;
+    ExplicitStaticOperands operands = {};
 
-    if (opcode == Opcode::TEST8rr &&
-        explOperands.op[0].reg == explOperands.op[1].reg) {
-        return SpecRet::NoChange;
-    }
-
-    if (getImm(dynInfo.operands[1].input, imm, cfg)) {
-        if (opcode == Opcode::TEST8mr) {
-            opcode = Opcode::TEST8mi;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        } else {
-            opcode = Opcode::TEST8ri;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        }
-    }
-
-    /* We can switch operand positions to encode the LHS as an immediate */
-    if (getImm(dynInfo.operands[0].input, imm, cfg)) {
-        opcode = Opcode::TEST8ri;
-        explOperands.op[0].reg = explOperands.op[1].reg;
-        explOperands.op[1].imm = imm;
-        return SpecRet::Change;
-    }
-    return SpecRet::NoChange;
+    operands.op[0].reg = dst;
+    setLeaOperand(operands.op[1], base, index, scale);
+    addInstruction(instrs, lea, operands);
 }
 
-DEF_SPECIALIZE_FN(test16)
+static void addRegImm(std::list<std::unique_ptr<Instruction>> &instrs,
+                      Opcode opcode, Register reg, uint64_t val)
 {
-    Immediate64 imm;
+    ExplicitStaticOperands operands = {};
 
-    if (opcode == Opcode::TEST16rr &&
-        explOperands.op[0].reg == explOperands.op[1].reg) {
-        return SpecRet::NoChange;
-    }
+    operands.op[0].reg = reg;
+    operands.op[1].imm.val = val;
+    operands.op[1].imm.usrPtrNr = -1;
+    addInstruction(instrs, opcode, operands);
+}
 
-    if (getImm(dynInfo.operands[1].input, imm, cfg)) {
-        if (opcode == Opcode::TEST16mr) {
-            opcode = Opcode::TEST16mi;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        } else {
-            opcode = Opcode::TEST16ri;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        }
-    }
+static void addRegReg(std::list<std::unique_ptr<Instruction>> &instrs,
+                      Opcode opcode, Register dst, Register src)
+{
+    ExplicitStaticOperands operands = {};
 
-    /* We can switch operand positions to encode the LHS as an immediate */
-    if (getImm(dynInfo.operands[0].input, imm, cfg)) {
-        opcode = Opcode::TEST16ri;
-        explOperands.op[0].reg = explOperands.op[1].reg;
-        explOperands.op[1].imm = imm;
-        return SpecRet::Change;
-    }
-    return SpecRet::NoChange;
+    operands.op[0].reg = dst;
+    operands.op[1].reg = src;
+    addInstruction(instrs, opcode, operands);
 }
 
-DEF_SPECIALIZE_FN(test32)
+/*
+ * "dst = src * factor" via two LEA/SHL/MOV, e.g. "factor = 3 * 5" or
+ * "factor = 9 * 8".
+ */
+static bool strengthReduceMultiply(const MultiplyForms &forms, Register dst,
+                                   Register src, uint64_t factor,
+                                   std::list<std::unique_ptr<Instruction>> &instrs)
 {
-    Immediate64 imm;
-
-    if (opcode == Opcode::TEST32rr &&
-        explOperands.op[0].reg == explOperands.op[1].reg) {
-        return SpecRet::NoChange;
-    }
+    const bool is64 = forms.lea == Opcode::LEA64ra;
+    const Register src64 = gprsTo64(src);
+    const Register dst64 = gprsTo64(dst);
+    static const uint8_t leaFactors[] = { 9, 5, 3 };
 
-    if (getImm(dynInfo.operands[1].input, imm, cfg)) {
-        if (opcode == Opcode::TEST32mr) {
-            opcode = Opcode::TEST32mi;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        } else {
-            opcode = Opcode::TEST32ri;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        }
+    if (!is64) {
+        factor = (uint32_t)factor;
     }
-
-    /* We can switch operand positions to encode the LHS as an immediate */
-    if (getImm(dynInfo.operands[0].input, imm, cfg)) {
-        opcode = Opcode::TEST32ri;
-        explOperands.op[0].reg = explOperands.op[1].reg;
-        explOperands.op[1].imm = imm;
-        return SpecRet::Change;
+    if (!factor) {
+        return false;
     }
-    return SpecRet::NoChange;
-}
 
-DEF_SPECIALIZE_FN(test64)
-{
-    Immediate64 imm;
+    for (const uint8_t first : leaFactors) {
+        uint64_t second = factor / first;
 
-    if (opcode == Opcode::TEST64rr &&
-        explOperands.op[0].reg == explOperands.op[1].reg) {
-        return SpecRet::NoChange;
-    }
+        if (factor % first) {
+            continue;
+        }
 
-    if (getImm(dynInfo.operands[1].input, imm, cfg)) {
-        if (is_simm32(imm.val)) {
-            if (opcode == Opcode::TEST64mr) {
-                opcode = Opcode::TEST64mi;
-                explOperands.op[1].imm = imm;
-                return SpecRet::Change;
+        switch (second) {
+        case 1:
+            addLea(instrs, forms.lea, dst, src64, src64, first - 1);
+            return true;
+        case 2:
+        case 3:
+        case 5:
+        case 9:
+            addLea(instrs, forms.lea, dst, src64, src64, first - 1);
+            addLea(instrs, forms.lea, dst, dst64, dst64,
+                   second == 2 ? 1 : second - 1);
+            return true;
+        case 4:
+        case 8:
+            addLea(instrs, forms.lea, dst, src64, src64, first - 1);
+            if (is64) {
+                addRegImm(instrs, Opcode::SHL64ri, dst,
+                          __builtin_ctzll(second));
             } else {
-                opcode = Opcode::TEST64ri;
-                explOperands.op[1].imm = imm;
-                return SpecRet::Change;
+                addLea(instrs, forms.lea, dst, Register::None, dst64, second);
+            }
+            return true;
+        default:
+            if (is64 && !(second & (second - 1))) {
+                addLea(instrs, forms.lea, dst, src64, src64, first - 1);
+                addRegImm(instrs, Opcode::SHL64ri, dst,
+                          __builtin_ctzll(second));
+                return true;
             }
+            break;
         }
     }
 
-    /* We can switch operand positions to encode the LHS as an immediate */
-    if (getImm(dynInfo.operands[0].input, imm, cfg)) {
-        if (is_simm32(imm.val)) {
-            opcode = Opcode::TEST64ri;
-            explOperands.op[0].reg = explOperands.op[1].reg;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        }
+    /* Powers of two are handled via SHL if dst == src */
+    if (is64 && dst != src && !(factor & (factor - 1))) {
+        addRegReg(instrs, Opcode::MOV64rr, dst, src);
+        addRegImm(instrs, Opcode::SHL64ri, dst, __builtin_ctzll(factor));
+        return true;
     }
-    return SpecRet::NoChange;
+    return false;
 }
 
-DEF_SPECIALIZE_FN(xor32)
+/*
+ * Find the magic number m and the shift s, such that for all 64bit n:
+ *  "n / d == (n * m) >> (64 + s)"
+ * ("Division by Invariant Integers using Multiplication", Granlund and
+ * Montgomery). Divisors requiring a 65bit magic number are not supported.
+ */
+static bool getDivisionMagic(uint64_t d, uint64_t &magic, uint8_t &shift)
 {
-    const bool eflagsRead = registersWillBeRead(livenessData, eflags);
-    Immediate64 imm;
-
-    if (opcode == Opcode::XOR32rr &&
-        explOperands.op[0].reg == explOperands.op[1].reg) {
-        return SpecRet::NoChange;
+    for (int p = 64; p < 128; p++) {
+        const __uint128_t pow = (__uint128_t)1 << p;
+        const __uint128_t m = (pow + d - 1) / d;
+
+        if (m >> 64) {
+            return false;
+        } else if (m * d - pow <= (__uint128_t)1 << (p - 64)) {
+            magic = m;
+            shift = p - 64;
+            return true;
+        }
     }
+    return false;
+}
 
-    if (getImm(dynInfo.operands[1].input, imm, cfg)) {
-        /* XOR with 0 and eflags not read -> we can drop it */
-        if (!imm.val && !eflagsRead) {
-            return SpecRet::Delete;
-        }
+/*
+ * "RAX = RAX / d" (unsigned, RDX is 0) via multiply-high and shift:
+ *  MUL64m [m]        ; RDX = (RAX * m) >> 64
+ *  SHR64ri RDX, s
+ *  MOV64rr RAX, RDX
+ * The remainder is not calculated, RDX has to be dead.
+ */
+static bool strengthReduceDivide(uint64_t divisor, BinaryPool &binaryPool,
+                                 std::list<std::unique_ptr<Instruction>> &instrs)
+{
+    ExplicitStaticOperands operands = {};
+    uint64_t magic;
+    uint8_t shift;
+
+    /* Powers of two are handled via SHR */
+    if (!(divisor & (divisor - 1)) ||
+        !getDivisionMagic(divisor, magic, shift)) {
+        return false;
+    }
 
-        if (opcode == Opcode::XOR32mr) {
-            opcode = Opcode::XOR32mi;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        } else if (opcode == Opcode::XOR32rr || opcode == Opcode::XOR32rm) {
-            opcode = Opcode::XOR32ri;
-            explOperands.op[1].imm = imm;
-            return SpecRet::Change;
-        }
+    operands.op[0].mem.type = MemPtrType::Direct;
+    operands.op[0].mem.addr.val = (uint64_t)binaryPool.allocConstant(magic);
+    operands.op[0].mem.addr.usrPtrNr = -1;
+    addInstruction(instrs, Opcode::MUL64m, operands);
+    if (shift) {
+        addRegImm(instrs, Opcode::SHR64ri, Register::RDX, shift);
     }
-    return SpecRet::NoChange;
+    addRegReg(instrs, Opcode::MOV64rr, Register::RAX, Register::RDX);
+    return true;
 }
 
-DEF_SPECIALIZE_FN(xor64)
+bool arch_strength_reduce(Opcode opcode, const ExplicitStaticOperands &operands,
+                          const DynamicInstructionInfo &dynInfo,
+                          const LivenessData &livenessData,
+                          const RewriterCfg &cfg, BinaryPool &binaryPool,
+                          std::list<std::unique_ptr<Instruction>> &instrs)
 {
-    const bool eflagsRead = registersWillBeRead(livenessData, eflags);
     Immediate64 imm;
 
-    if (opcode == Opcode::XOR64rr &&
-        explOperands.op[0].reg == explOperands.op[1].reg) {
-        return SpecRet::NoChange;
+    /* Multiplications and divisions leave (some) eflags undefined */
+    if (registersWillBeRead(livenessData, eflags)) {
+        return false;
     }
 
-    if (getImm(dynInfo.operands[1].input, imm, cfg)) {
-
-        /* XOR with 0 and eflags not read -> we can drop it */
-        if (!imm.val && !eflagsRead) {
-            return SpecRet::Delete;
+    switch (opcode) {
+    case Opcode::IMUL32rri:
+        return operands.op[2].imm.usrPtrNr < 0 &&
+               strengthReduceMultiply(forms_IMUL32, operands.op[0].reg,
+                                      operands.op[1].reg,
+                                      operands.op[2].imm.val, instrs);
+    case Opcode::IMUL64rri:
+        return operands.op[2].imm.usrPtrNr < 0 &&
+               strengthReduceMultiply(forms_IMUL64, operands.op[0].reg,
+                                      operands.op[1].reg,
+                                      operands.op[2].imm.val, instrs);
+    case Opcode::DIV64m:
+    case Opcode::DIV64r:
+        /* RDX has to be 0, the remainder must not be of interest */
+        if (!dynInfo.operands[2].input.isImm() ||
+            dynInfo.operands[2].input.getImm64() ||
+            registersWillBeRead(livenessData,
+                                getSubRegisterMask(Register::RDX))) {
+            return false;
         }
-
-        if (is_simm32(imm.val)) {
-            if (opcode == Opcode::XOR64mr) {
-                opcode = Opcode::XOR64mi;
-                explOperands.op[1].imm = imm;
-                return SpecRet::Change;
-            } else if (opcode == Opcode::XOR64rr || opcode == Opcode::XOR64rm) {
-                opcode = Opcode::XOR64ri;
-                explOperands.op[1].imm = imm;
-                return SpecRet::Change;
-            }
-        } else if (imm.usrPtrNr < 0 &&
-                   (opcode == Opcode::XOR64rr || opcode == Opcode::XOR64rm)) {
-            /* don't move UsrPtr to the constant pool */
-            opcode = Opcode::XOR64rm;
-            explOperands.op[1].mem.type = MemPtrType::Direct;
-            explOperands.op[1].mem.addr.val = (uint64_t)binaryPool.allocConstant(imm.val);
-            explOperands.op[1].mem.addr.usrPtrNr = -1;
-            return SpecRet::Change;
+        if (!getImm(dynInfo.operands[0].input, imm, cfg) ||
+            imm.usrPtrNr >= 0 || !imm.val) {
+            return false;
         }
+        return strengthReduceDivide(imm.val, binaryPool, instrs);
+    default:
+        return false;
     }
-    return SpecRet::NoChange;
 }
 
 } /* namespace drob */
@@ -20,6 +20,9 @@
 
 namespace drob {
 
+specialize_f specialize_add8;
+specialize_f specialize_add16;
+specialize_f specialize_add32;
 specialize_f specialize_add64;
 specialize_f specialize_addpd;
 specialize_f specialize_addsd;
@@ -29,6 +32,11 @@ specialize_f specialize_cmp16;
 specialize_f specialize_cmp32;
 specialize_f specialize_cmp64;
 
+specialize_f specialize_div;
+
+specialize_f specialize_imul32;
+specialize_f specialize_imul64;
+
 specialize_f specialize_lea64;
 specialize_f specialize_lea32;
 specialize_f specialize_lea16;
@@ -41,6 +49,7 @@ specialize_f specialize_movsd;
 specialize_f specialize_movupd;
 specialize_f specialize_movups;
 
+specialize_f specialize_mul;
 specialize_f specialize_mulpd;
 specialize_f specialize_mulsd;
 
@@ -54,6 +63,11 @@ specialize_f specialize_pxor;
 specialize_f specialize_shl64;
 specialize_f specialize_shr64;
 
+specialize_f specialize_sub8;
+specialize_f specialize_sub16;
+specialize_f specialize_sub32;
+specialize_f specialize_sub64;
+
 specialize_f specialize_test8;
 specialize_f specialize_test16;
 specialize_f specialize_test32;
@@ -0,0 +1,257 @@
+/*
+ * This file is part of Drob.
+ *
+ * Copyright 2019 David Hildenbrand <davidhildenbrand@gmail.com>
+ *
+ * Drob is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * Drob is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * in the COPYING.LESSER files in the top-level directory for more details.
+ */
+#include "../arch.hpp"
+#include "../Instruction.hpp"
+#include "x86.hpp"
+
+namespace drob {
+
+/*
+ * Scalar double operations with a memory operand and the packed operations
+ * we use to replace them. As legacy SSE requires aligned memory operands for
+ * packed operations, the second operand is always loaded via MOVUPD into a
+ * temporary register first.
+ */
+typedef struct PackedOp {
+    Opcode scalar;
+    Opcode packed;
+} PackedOp;
+
+static const PackedOp packedOps[] = {
+    { Opcode::ADDSDrm, Opcode::ADDPDrr },
+    { Opcode::MULSDrm, Opcode::MULPDrr },
+};
+
+static Opcode getPackedOpcode(Opcode opcode)
+{
+    for (unsigned int i = 0; i < ARRAY_SIZE(packedOps); i++) {
+        if (packedOps[i].scalar == opcode) {
+            return packedOps[i].packed;
+        }
+    }
+    return Opcode::NONE;
+}
+
+/*
+ * Match a chain "MOVSD reg,[mem]; (ADDSD|MULSD reg,[mem])*; MOVSD [mem],reg"
+ * starting at the given index. Returns the number of instructions in the
+ * chain or 0 if there is no chain.
+ */
+static unsigned int matchChain(const std::vector<Instruction *> &instrs,
+                               unsigned int start)
+{
+    Register reg;
+
+    if (instrs[start]->getOpcode() != Opcode::MOVSDrm) {
+        return 0;
+    }
+    reg = instrs[start]->getOperands().op[0].reg;
+
+    for (unsigned int i = start + 1; i < instrs.size(); i++) {
+        const Instruction *instr = instrs[i];
+
+        if (instr->getOpcode() == Opcode::MOVSDmr) {
+            if (instr->getOperands().op[1].reg != reg) {
+                return 0;
+            }
+            return i - start + 1;
+        }
+        if (getPackedOpcode(instr->getOpcode()) == Opcode::NONE ||
+            instr->getOperands().op[0].reg != reg) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+/*
+ * The memory operand of an instruction of a chain.
+ */
+static const StaticMemPtr &getMemPtr(const Instruction *instr)
+{
+    if (instr->getOpcode() == Opcode::MOVSDmr) {
+        return instr->getOperands().op[0].mem;
+    }
+    return instr->getOperands().op[1].mem;
+}
+
+static const MemAccess *getMemAccess(const Instruction *instr)
+{
+    const DynamicInstructionInfo *dynInfo = instr->getDynInfo();
+
+    if (!dynInfo) {
+        return nullptr;
+    }
+    for (const auto &operand : dynInfo->operands) {
+        if (!operand.isImpl && operand.type == OperandType::MemPtr) {
+            return &operand.memAcc;
+        }
+    }
+    return nullptr;
+}
+
+/*
+ * Does hi point at the 8 bytes right after lo?
+ */
+static bool isAdjacent(const StaticMemPtr &lo, const StaticMemPtr &hi)
+{
+    if (lo.type != hi.type) {
+        return false;
+    } else if (lo.type == MemPtrType::Direct) {
+        return hi.addr.usrPtrNr == lo.addr.usrPtrNr &&
+               hi.addr.val == lo.addr.val + 8;
+    }
+    return hi.sib.base == lo.sib.base && hi.sib.index == lo.sib.index &&
+           hi.sib.scale == lo.sib.scale &&
+           hi.sib.disp.usrPtrNr == lo.sib.disp.usrPtrNr &&
+           (int64_t)hi.sib.disp.val == (int64_t)lo.sib.disp.val + 8;
+}
+
+static bool disjoint(int64_t lhs, int64_t rhs)
+{
+    return lhs + 8 <= rhs || rhs + 8 <= lhs;
+}
+
+/*
+ * Can we prove that the 8 byte accesses of both instructions don't overlap?
+ * Either they use the same base/index registers, or stack analysis computed
+ * pointers into the same object.
+ */
+static bool isDisjoint(const Instruction *lhs, const Instruction *rhs)
+{
+    const StaticMemPtr &lhsPtr = getMemPtr(lhs);
+    const StaticMemPtr &rhsPtr = getMemPtr(rhs);
+    const MemAccess *lhsAcc, *rhsAcc;
+
+    if (lhsPtr.type == MemPtrType::Direct && rhsPtr.type == MemPtrType::Direct &&
+        lhsPtr.addr.usrPtrNr == rhsPtr.addr.usrPtrNr) {
+        return disjoint(lhsPtr.addr.val, rhsPtr.addr.val);
+    } else if (lhsPtr.type == MemPtrType::SIB && rhsPtr.type == MemPtrType::SIB &&
+               lhsPtr.sib.base == rhsPtr.sib.base &&
+               lhsPtr.sib.index == rhsPtr.sib.index &&
+               lhsPtr.sib.scale == rhsPtr.sib.scale &&
+               lhsPtr.sib.disp.usrPtrNr == rhsPtr.sib.disp.usrPtrNr) {
+        return disjoint(lhsPtr.sib.disp.val, rhsPtr.sib.disp.val);
+    }
+
+    lhsAcc = getMemAccess(lhs);
+    rhsAcc = getMemAccess(rhs);
+    if (!lhsAcc || !rhsAcc || !lhsAcc->ptrVal.isPtr() ||
+        lhsAcc->ptrVal.getType() != rhsAcc->ptrVal.getType() ||
+        lhsAcc->ptrVal.getNr() != rhsAcc->ptrVal.getNr()) {
+        return false;
+    }
+    return disjoint(lhsAcc->ptrVal.getPtrOffset(),
+                    rhsAcc->ptrVal.getPtrOffset());
+}
+
+/*
+ * Find a XMM register we can use as temporary register: not used by the
+ * chains and dead after them.
+ */
+static Register getTmpRegister(Register reg, const LivenessData &livenessData)
+{
+    for (int i = (int)Register::XMM0; i <= (int)Register::XMM15; i++) {
+        const Register tmpReg = (Register)i;
+
+        if (tmpReg != reg &&
+            !(livenessData.live_out & getSubRegisterMask(tmpReg))) {
+            return tmpReg;
+        }
+    }
+    return Register::None;
+}
+
+unsigned int arch_slp_vectorize(const std::vector<Instruction *> &instrs,
+                                unsigned int start,
+                                std::list<std::unique_ptr<Instruction>> &packed)
+{
+    const unsigned int len = matchChain(instrs, start);
+    ExplicitStaticOperands operands = {};
+    const LivenessData *livenessData;
+    Register reg, hiReg, tmpReg;
+
+    if (!len || start + 2 * len > instrs.size() ||
+        matchChain(instrs, start + len) != len) {
+        return 0;
+    }
+
+    /* The second chain has to be isomorphic, operating on the next 8 bytes */
+    for (unsigned int i = 0; i < len; i++) {
+        const Instruction *lo = instrs[start + i];
+        const Instruction *hi = instrs[start + len + i];
+
+        if (lo->getOpcode() != hi->getOpcode() ||
+            !isAdjacent(getMemPtr(lo), getMemPtr(hi))) {
+            return 0;
+        }
+    }
+
+    /*
+     * The loads of the second chain will be performed before the store of
+     * the first chain. They must not read what the first chain stores.
+     */
+    for (unsigned int i = 0; i < len - 1; i++) {
+        if (!isDisjoint(instrs[start + len - 1], instrs[start + len + i])) {
+            return 0;
+        }
+    }
+
+    /* Both lanes end up in the first register, clobbering it */
+    livenessData = instrs[start + 2 * len - 1]->getLivenessData();
+    if (!livenessData) {
+        return 0;
+    }
+    reg = instrs[start]->getOperands().op[0].reg;
+    hiReg = instrs[start + len]->getOperands().op[0].reg;
+    if (!!(livenessData->live_out & getSubRegisterMask(reg)) ||
+        !!(livenessData->live_out & getSubRegisterMask(hiReg))) {
+        return 0;
+    }
+
+    tmpReg = hiReg;
+    if (len > 2 && hiReg == reg) {
+        tmpReg = getTmpRegister(reg, *livenessData);
+        if (tmpReg == Register::None) {
+            return 0;
+        }
+    }
+
+    operands.op[0].reg = reg;
+    operands.op[1].mem = getMemPtr(instrs[start]);
+    packed.emplace_back(std::make_unique<Instruction>(Opcode::MOVUPDrm, operands));
+    for (unsigned int i = 1; i < len - 1; i++) {
+        const Instruction *instr = instrs[start + i];
+
+        operands = {};
+        operands.op[0].reg = tmpReg;
+        operands.op[1].mem = getMemPtr(instr);
+        packed.emplace_back(std::make_unique<Instruction>(Opcode::MOVUPDrm, operands));
+        operands = {};
+        operands.op[0].reg = reg;
+        operands.op[1].reg = tmpReg;
+        packed.emplace_back(std::make_unique<Instruction>(getPackedOpcode(instr->getOpcode()),
+                                                          operands));
+    }
+    operands = {};
+    operands.op[0].mem = getMemPtr(instrs[start + len - 1]);
+    operands.op[1].reg = reg;
+    packed.emplace_back(std::make_unique<Instruction>(Opcode::MOVUPDmr, operands));
+
+    return 2 * len;
+}
+
+} /* namespace drob */
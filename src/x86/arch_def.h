@@ -22,6 +22,8 @@ namespace drob {
 #define ARCH_MAX_MMAP_SIZE (1ull << 31)
 /* Align to 16 bytes, recommended by Intel */
 #define ARCH_BLOCK_ALIGN 16
+/* Branches should not cross or end on such a boundary (JCC erratum) */
+#define ARCH_BRANCH_BOUNDARY 32
 #define ARCH_PAGE_SIZE 4096
 #define ARCH_MAX_ILEN 15
 /* No AVX/VEX support yet. E.g. IMUL has a version with three operands */
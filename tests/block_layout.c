@@ -0,0 +1,58 @@
+#include "common.h"
+
+/*
+ * long clamp_add(long x, long y)
+ * {
+ *     if (x < 0)
+ *         return y - x * 4;
+ *     return x + y;
+ * }
+ */
+long clamp_add(long x, long y);
+extern const char clamp_add_branch[];
+asm(".text\n"
+    ".type clamp_add, @function\n"
+    "clamp_add:\n"
+    "    test %rdi, %rdi\n"
+    "clamp_add_branch:\n"
+    "    js 1f\n"
+    "    lea (%rdi,%rsi), %rax\n"
+    "    ret\n"
+    "1:\n"
+    "    shl $2, %rdi\n"
+    "    mov %rsi, %rax\n"
+    "    sub %rdi, %rax\n"
+    "    ret\n"
+    ".size clamp_add, .-clamp_add\n");
+
+static long call_clamp_add(drob_f func, long x)
+{
+    return ((typeof(clamp_add)*)func)(x, 77);
+}
+
+int main(void)
+{
+    drob_cfg *cfg;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    /* usually taken: the branch gets inverted */
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    drob_cfg_add_branch_profile(cfg, clamp_add_branch, 100000, 1);
+    ret |= test_specialize("clamp_add (taken)", clamp_add, cfg,
+                           call_clamp_add, -500, 500);
+
+    /* rarely taken: the target gets moved out of line */
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    drob_cfg_add_branch_profile(cfg, clamp_add_branch, 1, 100000);
+    ret |= test_specialize("clamp_add (not taken)", clamp_add, cfg,
+                           call_clamp_add, -500, 500);
+
+    drob_teardown();
+    return ret;
+}
@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include "common.h"
+
+int test_setup(void)
+{
+    if (drob_setup()) {
+        fprintf(stderr, "Cannot setup drob\n");
+        return 1;
+    }
+    return 0;
+}
+
+int test_specialize(const char *name, drob_f func, drob_cfg *cfg,
+                    test_call_fn call, long first, long last)
+{
+    drob_f specialized;
+    long arg, expected, result;
+    int ret = 0;
+
+    specialized = drob_optimize(func, cfg);
+    if (!specialized) {
+        fprintf(stderr, "%s: Optimizing failed\n", name);
+        drob_cfg_free(cfg);
+        return 1;
+    }
+
+    for (arg = first; arg <= last; arg++) {
+        expected = call(func, arg);
+        result = call(specialized, arg);
+        if (result != expected) {
+            fprintf(stderr, "%s: Mismatch for %ld: %ld != %ld\n", name, arg,
+                    result, expected);
+            ret = 1;
+        }
+    }
+    drob_free(specialized);
+    drob_cfg_free(cfg);
+    return ret;
+}
@@ -0,0 +1,25 @@
+#ifndef TESTS_COMMON_H
+#define TESTS_COMMON_H
+
+#include "drob.h"
+
+/*
+ * Call the original or the specialized function with parameters derived
+ * from "arg". The result is compared between both functions.
+ */
+typedef long (*test_call_fn)(drob_f func, long arg);
+
+/*
+ * Setup drob. Returns 0 on success.
+ */
+int test_setup(void);
+
+/*
+ * Specialize "func" using "cfg" and compare the results of "call" for all
+ * arguments in [first, last] against the original function. "cfg" is freed.
+ * Returns 0 on success.
+ */
+int test_specialize(const char *name, drob_f func, drob_cfg *cfg,
+                    test_call_fn call, long first, long last);
+
+#endif /* TESTS_COMMON_H */
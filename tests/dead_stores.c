@@ -0,0 +1,76 @@
+#include "common.h"
+
+/*
+ * The first store is overwritten before being read and is dead. The second
+ * one is only overwritten on one path and stays alive. The shift reads the
+ * slot, so the store before it stays alive.
+ *
+ * long stack_stores(long x, long y)
+ * {
+ *     long a = y, b = x, c = x;
+ *
+ *     if (y < 0)
+ *         b = y;
+ *     c <<= y & 7;
+ *     return a + b * 3 + c;
+ * }
+ */
+long stack_stores(long x, long y);
+asm(".text\n"
+    ".type stack_stores, @function\n"
+    "stack_stores:\n"
+    "    sub $24, %rsp\n"
+    "    mov %rdi, (%rsp)\n"
+    "    mov %rsi, (%rsp)\n"
+    "    mov %rdi, 8(%rsp)\n"
+    "    test %rsi, %rsi\n"
+    "    jns 1f\n"
+    "    mov %rsi, 8(%rsp)\n"
+    "1:\n"
+    "    mov %rdi, 16(%rsp)\n"
+    "    mov %esi, %ecx\n"
+    "    and $7, %ecx\n"
+    "    shlq %cl, 16(%rsp)\n"
+    "    mov 8(%rsp), %rax\n"
+    "    lea (%rax,%rax,2), %rax\n"
+    "    add (%rsp), %rax\n"
+    "    add 16(%rsp), %rax\n"
+    "    add $24, %rsp\n"
+    "    ret\n"
+    ".size stack_stores, .-stack_stores\n");
+
+static long y;
+
+static long call_stack_stores(drob_f func, long x)
+{
+    return ((typeof(stack_stores)*)func)(x, y);
+}
+
+int main(void)
+{
+    drob_cfg *cfg;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    for (y = -9; y <= 9; y++) {
+        cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                            DROB_PARAM_TYPE_LONG);
+        ret |= test_specialize("stack_stores", stack_stores, cfg,
+                               call_stack_stores, -500, 500);
+    }
+
+    /* With a known y, the branch and the shift count are known */
+    for (y = -9; y <= 9; y++) {
+        cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                            DROB_PARAM_TYPE_LONG);
+        drob_cfg_set_param_long(cfg, 1, y);
+        ret |= test_specialize("stack_stores (known)", stack_stores, cfg,
+                               call_stack_stores, -500, 500);
+    }
+
+    drob_teardown();
+    return ret;
+}
@@ -0,0 +1,53 @@
+#include "common.h"
+
+static long __attribute__((noinline))
+poly(long x, long k)
+{
+    if (k > 0) {
+        return x * x + k * x - 17;
+    }
+    return (x - k) * 3;
+}
+
+static long k;
+
+static long call_poly(drob_f func, long x)
+{
+    return ((typeof(poly)*)func)(x, k);
+}
+
+/* The ICFG of the first rewrite is reused for the following ones */
+static int specialize_poly(long val, bool known)
+{
+    drob_cfg *cfg;
+
+    k = val;
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    if (known) {
+        drob_cfg_set_param_long(cfg, 1, k);
+    }
+    return test_specialize("poly", poly, cfg, call_poly, -500, 500);
+}
+
+int main(void)
+{
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    ret |= specialize_poly(5, true);
+    ret |= specialize_poly(-9, true);
+    ret |= specialize_poly(5, false);
+    ret |= specialize_poly(-9, false);
+
+    /* Decode again after dropping the cached ICFG */
+    drob_invalidate(poly);
+    ret |= specialize_poly(23, true);
+    ret |= specialize_poly(-23, false);
+
+    drob_teardown();
+    return ret;
+}
@@ -0,0 +1,52 @@
+#include "common.h"
+
+static int __attribute__((noinline))
+triple(int x)
+{
+    return x * 3;
+}
+
+static int __attribute__((noinline))
+negate(int x)
+{
+    return -x;
+}
+
+/* The indirect call becomes a direct one once fn is known */
+static int __attribute__((noinline))
+apply(int (*fn)(int), int x)
+{
+    return fn(x) + 1;
+}
+
+static int (*cur_fn)(int);
+
+static long call_apply(drob_f func, long x)
+{
+    return ((typeof(apply)*)func)(cur_fn, x);
+}
+
+int main(void)
+{
+    drob_cfg *cfg;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    cur_fn = triple;
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_INT, DROB_PARAM_TYPE_PTR,
+                        DROB_PARAM_TYPE_INT);
+    drob_cfg_set_param_ptr(cfg, 0, (const void *)cur_fn);
+    ret |= test_specialize("apply(triple)", apply, cfg, call_apply, -500, 500);
+
+    cur_fn = negate;
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_INT, DROB_PARAM_TYPE_PTR,
+                        DROB_PARAM_TYPE_INT);
+    drob_cfg_set_param_ptr(cfg, 0, (const void *)cur_fn);
+    ret |= test_specialize("apply(negate)", apply, cfg, call_apply, -500, 500);
+
+    drob_teardown();
+    return ret;
+}
@@ -0,0 +1,64 @@
+#include "common.h"
+
+/* Stack arguments are accessed relative to the frame pointer */
+static long __attribute__((noinline, optimize("no-omit-frame-pointer")))
+sum8(long a, long b, long c, long d, long e, long f, long g, long h)
+{
+    return a - b + c - d + e - f + g * 3 - h * 5;
+}
+
+/*
+ * "pop [rbp - 16]" computes its address after incrementing the stack pointer
+ * long pop_frame(long a, long b) { return a + b; }
+ */
+long pop_frame(long a, long b);
+asm(".text\n"
+    ".type pop_frame, @function\n"
+    "pop_frame:\n"
+    "    push %rbp\n"
+    "    mov %rsp, %rbp\n"
+    "    sub $16, %rsp\n"
+    "    mov %rdi, -8(%rbp)\n"
+    "    push -8(%rbp)\n"
+    "    pop -16(%rbp)\n"
+    "    mov -16(%rbp), %rax\n"
+    "    add %rsi, %rax\n"
+    "    mov %rbp, %rsp\n"
+    "    pop %rbp\n"
+    "    ret\n"
+    ".size pop_frame, .-pop_frame\n");
+
+static long call_sum8(drob_f func, long i)
+{
+    return ((typeof(sum8)*)func)(i, 2, 3, i * 7, 5, 6, i - 3, i * i);
+}
+
+static long call_pop_frame(drob_f func, long i)
+{
+    return ((typeof(pop_frame)*)func)(i, 1000 - i * 3);
+}
+
+int main(void)
+{
+    drob_cfg *cfg;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    cfg = drob_cfg_new(DROB_PARAM_TYPE_LONG, 8, DROB_PARAM_TYPE_LONG,
+                       DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                       DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                       DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                       DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("sum8", sum8, cfg, call_sum8, -50, 50);
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("pop_frame", pop_frame, cfg, call_pop_frame, -50,
+                           50);
+
+    drob_teardown();
+    return ret;
+}
@@ -0,0 +1,54 @@
+#include "common.h"
+
+/* Each call site passes a different constant, so the callee gets cloned */
+static long __attribute__((noipa))
+weight(long x, long factor)
+{
+    if (factor > 4) {
+        return x * factor - 7;
+    }
+    return x + factor;
+}
+
+static long __attribute__((noinline))
+weigh_twice(long x, long factor)
+{
+    return weight(x, 3) * 2 + weight(x, factor);
+}
+
+static long factor;
+
+static long call_weigh_twice(drob_f func, long x)
+{
+    return ((typeof(weigh_twice)*)func)(x, factor);
+}
+
+int main(void)
+{
+    static const long factors[] = { -3, 3, 9 };
+    drob_cfg *cfg;
+    unsigned int i;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(factors) / sizeof(factors[0]); i++) {
+        factor = factors[i];
+        cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                            DROB_PARAM_TYPE_LONG);
+        drob_cfg_set_param_long(cfg, 1, factor);
+        ret |= test_specialize("weigh_twice", weigh_twice, cfg,
+                               call_weigh_twice, -500, 500);
+    }
+
+    /* Only the first call site passes a constant */
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("weigh_twice (unknown)", weigh_twice, cfg,
+                           call_weigh_twice, -500, 500);
+
+    drob_teardown();
+    return ret;
+}
@@ -0,0 +1,56 @@
+#include "common.h"
+
+/* Lots of short forward branches, densely packed */
+static int __attribute__((noinline)) classify(int x)
+{
+    int ret = x;
+
+    if (x < -100) {
+        return x * 3;
+    }
+    if (x & 1) {
+        ret += x / 7;
+    }
+    if (x == 42) {
+        return 1;
+    }
+    if (x & 4) {
+        ret -= x / 5;
+    }
+    if (x > 150) {
+        ret -= x / 3;
+    }
+    if (x & 16) {
+        ret += x / 11;
+    }
+    if (x & 32) {
+        ret -= x / 13;
+    }
+    if (ret == 0) {
+        return -1;
+    }
+    return ret;
+}
+
+static long call_classify(drob_f func, long x)
+{
+    return ((typeof(classify)*)func)(x);
+}
+
+int main(void)
+{
+    drob_cfg *cfg;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    cfg = drob_cfg_new1(DROB_PARAM_TYPE_INT, DROB_PARAM_TYPE_INT);
+    drob_cfg_set_code_align(cfg, DROB_CODE_ALIGN_NONE);
+    drob_cfg_mitigate_jcc_erratum(cfg, true);
+    ret |= test_specialize("classify", classify, cfg, call_classify, -300, 300);
+
+    drob_teardown();
+    return ret;
+}
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include "common.h"
+
+/* Has to be built without -fpie to get an absolute jump table */
+static int __attribute__((noinline))
+dispatch(unsigned int op, int a)
+{
+    switch (op) {
+    case 0:
+        return a + 3;
+    case 1:
+        return a * 7;
+    case 2:
+        return a - 11;
+    case 3:
+        return a / 5;
+    case 4:
+        return a ^ 0x55;
+    case 5:
+        return a << 3;
+    case 6:
+        return a % 9;
+    case 7:
+        return 42 - a;
+    default:
+        return -1;
+    }
+}
+
+static unsigned int cur_op;
+
+static long call_dispatch(drob_f func, long a)
+{
+    return ((typeof(dispatch)*)func)(cur_op, a);
+}
+
+int main(void)
+{
+    drob_cfg *cfg;
+    char name[32];
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    for (cur_op = 0; cur_op <= 10; cur_op++) {
+        /* unknown op: the jump table is decoded but kept */
+        snprintf(name, sizeof(name), "dispatch(%u)", cur_op);
+        cfg = drob_cfg_new2(DROB_PARAM_TYPE_INT, DROB_PARAM_TYPE_INT,
+                            DROB_PARAM_TYPE_INT);
+        ret |= test_specialize(name, dispatch, cfg, call_dispatch, -500, 500);
+
+        /* known op: the indirect jump is resolved to a single case */
+        snprintf(name, sizeof(name), "dispatch(%u) (known)", cur_op);
+        cfg = drob_cfg_new2(DROB_PARAM_TYPE_INT, DROB_PARAM_TYPE_INT,
+                            DROB_PARAM_TYPE_INT);
+        drob_cfg_set_param_int(cfg, 0, cur_op);
+        ret |= test_specialize(name, dispatch, cfg, call_dispatch, -500, 500);
+    }
+
+    drob_teardown();
+    return ret;
+}
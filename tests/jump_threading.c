@@ -0,0 +1,41 @@
+#include "common.h"
+
+/* The second branch is decided by the path taken through the first one */
+static int __attribute__((noinline, optimize("no-thread-jumps,no-tree-dominator-opts,no-tree-vrp")))
+scale(int x, int factor)
+{
+    int neg = 0;
+
+    if (x < 0) {
+        neg = 1;
+        x = factor - x;
+    }
+    x = x * 3 + factor;
+    if (neg) {
+        return x / 7;
+    }
+    return x + 5;
+}
+
+static long call_scale(drob_f func, long x)
+{
+    return ((typeof(scale)*)func)(x, 11);
+}
+
+int main(void)
+{
+    drob_cfg *cfg;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_INT, DROB_PARAM_TYPE_INT,
+                        DROB_PARAM_TYPE_INT);
+    drob_cfg_set_param_int(cfg, 1, 11);
+    ret |= test_specialize("scale", scale, cfg, call_scale, -500, 500);
+
+    drob_teardown();
+    return ret;
+}
@@ -0,0 +1,62 @@
+#include "common.h"
+
+/*
+ * Eflags of the ADD are read after other instructions that don't modify
+ * them: the emulator has to calculate them from the deferred operation.
+ *
+ * long add_flags(long x, long y)
+ * {
+ *     long sum = x + y;
+ *
+ *     return sum ^ ((OF | SF << 1) << 1 | CF) << 60;
+ * }
+ */
+long add_flags(long x, long y);
+asm(".text\n"
+    ".type add_flags, @function\n"
+    "add_flags:\n"
+    "    mov %rdi, %rax\n"
+    "    add %rsi, %rax\n"
+    "    seto %cl\n"
+    "    sets %dl\n"
+    "    movzbl %cl, %ecx\n"
+    "    movzbl %dl, %edx\n"
+    "    lea (%rcx,%rdx,2), %rcx\n"
+    "    adc %rcx, %rcx\n"
+    "    shl $60, %rcx\n"
+    "    xor %rcx, %rax\n"
+    "    ret\n"
+    ".size add_flags, .-add_flags\n");
+
+static long y;
+
+static long call_add_flags(drob_f func, long x)
+{
+    return ((typeof(add_flags)*)func)(x, y);
+}
+
+int main(void)
+{
+    static const long values[] = {
+        0, 1, -1, 500, 0x7fffffffffffffffl, -0x7fffffffffffffffl - 1,
+    };
+    drob_cfg *cfg;
+    unsigned int i;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        y = values[i];
+        cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                            DROB_PARAM_TYPE_LONG);
+        drob_cfg_set_param_long(cfg, 1, y);
+        ret |= test_specialize("add_flags", add_flags, cfg, call_add_flags,
+                               -500, 500);
+    }
+
+    drob_teardown();
+    return ret;
+}
@@ -0,0 +1,104 @@
+#include "common.h"
+
+/*
+ * The LEA only depends on y, which is not modified in the loop, so it can
+ * be hoisted out of the loop.
+ *
+ * long sum_invariant(long n, long y)
+ * {
+ *     long sum = 0, i;
+ *
+ *     for (i = 0; i < n; i++)
+ *         sum += y * 3 + 3 + i;
+ *     return sum;
+ * }
+ */
+long sum_invariant(long n, long y);
+asm(".text\n"
+    ".type sum_invariant, @function\n"
+    "sum_invariant:\n"
+    "    xor %eax, %eax\n"
+    "    xor %ecx, %ecx\n"
+    "    test %rdi, %rdi\n"
+    "    jle 2f\n"
+    "1:\n"
+    "    lea 3(%rsi,%rsi,2), %rdx\n"
+    "    add %rdx, %rax\n"
+    "    add %rcx, %rax\n"
+    "    inc %rcx\n"
+    "    cmp %rdi, %rcx\n"
+    "    jl 1b\n"
+    "2:\n"
+    "    ret\n"
+    ".size sum_invariant, .-sum_invariant\n");
+
+/*
+ * The load reads memory that is written in the loop, so it must stay in
+ * the loop.
+ *
+ * long sum_written(long n, long *p)
+ * {
+ *     long sum = 0, i;
+ *
+ *     for (i = 0; i < n; i++) {
+ *         sum += *p + i;
+ *         *p += 1;
+ *     }
+ *     return sum;
+ * }
+ */
+long sum_written(long n, long *p);
+asm(".text\n"
+    ".type sum_written, @function\n"
+    "sum_written:\n"
+    "    xor %eax, %eax\n"
+    "    xor %ecx, %ecx\n"
+    "    test %rdi, %rdi\n"
+    "    jle 2f\n"
+    "1:\n"
+    "    mov (%rsi), %rdx\n"
+    "    add %rdx, %rax\n"
+    "    add %rcx, %rax\n"
+    "    addq $1, (%rsi)\n"
+    "    inc %rcx\n"
+    "    cmp %rdi, %rcx\n"
+    "    jl 1b\n"
+    "2:\n"
+    "    ret\n"
+    ".size sum_written, .-sum_written\n");
+
+static long call_sum_invariant(drob_f func, long n)
+{
+    return ((typeof(sum_invariant)*)func)(n, 13);
+}
+
+static long call_sum_written(drob_f func, long n)
+{
+    long val = 13, sum;
+
+    sum = ((typeof(sum_written)*)func)(n, &val);
+    return sum * 1000 + val;
+}
+
+int main(void)
+{
+    drob_cfg *cfg;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("sum_invariant", sum_invariant, cfg,
+                           call_sum_invariant, -10, 300);
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_PTR);
+    ret |= test_specialize("sum_written", sum_written, cfg, call_sum_written,
+                           -10, 300);
+
+    drob_teardown();
+    return ret;
+}
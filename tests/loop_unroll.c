@@ -0,0 +1,46 @@
+#include "common.h"
+
+static const int vals[] = { 3, -1, 4, 1, -5, 9, 2, -6, 5, 3, -5, 8 };
+
+static int __attribute__((noinline)) weighted_sum(const int *data, int count)
+{
+    int i, ret = 0;
+
+    for (i = 0; i < count; i++) {
+        ret += data[i] * (i + 1);
+    }
+    return ret;
+}
+
+static long call_weighted_sum(drob_f func, long count)
+{
+    return ((typeof(weighted_sum)*)func)(vals, count);
+}
+
+int main(void)
+{
+    const int count = sizeof(vals) / sizeof(vals[0]);
+    drob_cfg *cfg;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    /* Known trip count: complete unrolling */
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_INT, DROB_PARAM_TYPE_PTR,
+                        DROB_PARAM_TYPE_INT);
+    drob_cfg_set_param_int(cfg, 1, 7);
+    ret |= test_specialize("known trip count", weighted_sum, cfg,
+                           call_weighted_sum, 7, 7);
+
+    /* Unknown trip count: partial unrolling */
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_INT, DROB_PARAM_TYPE_PTR,
+                        DROB_PARAM_TYPE_INT);
+    drob_cfg_set_simple_loop_unroll_count(cfg, 3);
+    ret |= test_specialize("unknown trip count", weighted_sum, cfg,
+                           call_weighted_sum, 0, count);
+
+    drob_teardown();
+    return ret;
+}
@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include "common.h"
+
+static void __attribute__((noinline, noreturn, used))
+fail(void)
+{
+    abort();
+}
+
+/*
+ * The calls don't return, so the bytes following them are not code (here:
+ * an instruction that is invalid in 64bit mode).
+ *
+ * long checked_add(long x, long y)
+ * {
+ *     if (y == 0)
+ *         abort();
+ *     if (y < 0)
+ *         fail();
+ *     return x + y;
+ * }
+ */
+long checked_add(long x, long y);
+asm(".text\n"
+    ".type checked_add, @function\n"
+    "checked_add:\n"
+    "    test %rsi, %rsi\n"
+    "    je 1f\n"
+    "    js 2f\n"
+    "    lea (%rdi,%rsi), %rax\n"
+    "    ret\n"
+    "1:\n"
+    "    call abort@PLT\n"
+    "    .byte 0x06\n"
+    "2:\n"
+    "    call fail\n"
+    "    .byte 0x06\n"
+    ".size checked_add, .-checked_add\n");
+
+static long __attribute__((noinline))
+square_plus(long x, long y)
+{
+    return x * x + y;
+}
+
+/* The small callee can be inlined */
+static long __attribute__((noinline))
+sum_squares(long x, long y)
+{
+    return square_plus(x, y) + square_plus(y, 3);
+}
+
+static long call_checked_add(drob_f func, long x)
+{
+    return ((typeof(checked_add)*)func)(x, 42);
+}
+
+static long call_sum_squares(drob_f func, long x)
+{
+    return ((typeof(sum_squares)*)func)(x, 11);
+}
+
+int main(void)
+{
+    drob_cfg *cfg;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("checked_add", checked_add, cfg, call_checked_add,
+                           -500, 500);
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("sum_squares", sum_squares, cfg, call_sum_squares,
+                           -500, 500);
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    drob_cfg_set_param_long(cfg, 1, 11);
+    ret |= test_specialize("sum_squares (known)", sum_squares, cfg,
+                           call_sum_squares, -500, 500);
+
+    drob_teardown();
+    return ret;
+}
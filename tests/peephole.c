@@ -0,0 +1,181 @@
+#include "common.h"
+
+/* cmp $0 -> test */
+long cmp_zero(long x, long y);
+asm(".text\n"
+    ".type cmp_zero, @function\n"
+    "cmp_zero:\n"
+    "    lea (%rdi,%rsi), %rax\n"
+    "    cmp $0, %rdi\n"
+    "    jle 1f\n"
+    "    ret\n"
+    "1:\n"
+    "    cmp $0, %esi\n"
+    "    jne 2f\n"
+    "    lea 1(%rax), %rax\n"
+    "2:\n"
+    "    lea 5(%rax,%rax,2), %rax\n"
+    "    ret\n"
+    ".size cmp_zero, .-cmp_zero\n");
+
+/*
+ * The second LEA can use the inputs of the first one. The last LEA can't,
+ * as the first one overwrites its own input.
+ */
+long lea_lea(long x, long y);
+asm(".text\n"
+    ".type lea_lea, @function\n"
+    "lea_lea:\n"
+    "    lea 7(%rdi,%rsi,2), %rax\n"
+    "    lea -3(%rax), %rdx\n"
+    "    imul %rdx, %rax\n"
+    "    lea 11(%rdi,%rsi), %rdi\n"
+    "    lea 13(%rdi), %rdx\n"
+    "    add %rdx, %rax\n"
+    "    ret\n"
+    ".size lea_lea, .-lea_lea\n");
+
+/* Reloading the stored values can use the registers. MOV32 zero-extends. */
+long store_load(long *p, long x);
+asm(".text\n"
+    ".type store_load, @function\n"
+    "store_load:\n"
+    "    mov %rsi, (%rdi)\n"
+    "    mov (%rdi), %rax\n"
+    "    mov %esi, 8(%rdi)\n"
+    "    mov 8(%rdi), %edx\n"
+    "    add %rdx, %rax\n"
+    "    mov %rax, 16(%rdi)\n"
+    "    mov 16(%rdi), %rax\n"
+    "    ret\n"
+    ".size store_load, .-store_load\n");
+
+/* Storing the loaded values again is a NOP */
+long load_store(long *p, long x);
+asm(".text\n"
+    ".type load_store, @function\n"
+    "load_store:\n"
+    "    mov (%rdi), %rax\n"
+    "    mov %rax, (%rdi)\n"
+    "    mov 8(%rdi), %edx\n"
+    "    mov %edx, 8(%rdi)\n"
+    "    add %rdx, %rax\n"
+    "    add %rsi, %rax\n"
+    "    mov %rax, 16(%rdi)\n"
+    "    ret\n"
+    ".size load_store, .-load_store\n");
+
+/* Copying back (or copying again) is a NOP */
+long copy_copy(long x, long y);
+asm(".text\n"
+    ".type copy_copy, @function\n"
+    "copy_copy:\n"
+    "    mov %rdi, %rax\n"
+    "    mov %rax, %rdi\n"
+    "    mov %rsi, %rdx\n"
+    "    mov %rsi, %rdx\n"
+    "    imul %rdx, %rax\n"
+    "    add %rdi, %rax\n"
+    "    ret\n"
+    ".size copy_copy, .-copy_copy\n");
+
+/*
+ * The first copy is dead after the ADD, so the ADD can read the original
+ * register. The second copy is still used afterwards, and the XOR writes
+ * the copy itself.
+ */
+long copy_use(long x, long y);
+asm(".text\n"
+    ".type copy_use, @function\n"
+    "copy_use:\n"
+    "    mov %rsi, %rax\n"
+    "    mov %rdi, %rdx\n"
+    "    add %rdx, %rax\n"
+    "    mov %rdi, %rcx\n"
+    "    sub %rcx, %rax\n"
+    "    imul %rcx, %rax\n"
+    "    mov %rsi, %rdx\n"
+    "    xor %rdx, %rdx\n"
+    "    add %rdx, %rax\n"
+    "    ret\n"
+    ".size copy_use, .-copy_use\n");
+
+static long call_cmp_zero(drob_f func, long x)
+{
+    return ((typeof(cmp_zero)*)func)(x, x % 3);
+}
+
+static long call_lea_lea(drob_f func, long x)
+{
+    return ((typeof(lea_lea)*)func)(x, 17);
+}
+
+static long call_store_load(drob_f func, long x)
+{
+    long mem[3] = { 1, -1, 1 };
+    long ret;
+
+    ret = ((typeof(store_load)*)func)(mem, x);
+    return ret ^ mem[0] ^ mem[1] ^ mem[2];
+}
+
+static long call_load_store(drob_f func, long x)
+{
+    long mem[3] = { x * 3, -x, 0 };
+    long ret;
+
+    ret = ((typeof(load_store)*)func)(mem, x);
+    return ret ^ mem[0] ^ mem[1] ^ mem[2];
+}
+
+static long call_copy_copy(drob_f func, long x)
+{
+    return ((typeof(copy_copy)*)func)(x, 23);
+}
+
+static long call_copy_use(drob_f func, long x)
+{
+    return ((typeof(copy_use)*)func)(x, 23);
+}
+
+int main(void)
+{
+    drob_cfg *cfg;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("cmp_zero", cmp_zero, cfg, call_cmp_zero, -500,
+                           500);
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("lea_lea", lea_lea, cfg, call_lea_lea, -500, 500);
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_PTR,
+                        DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("store_load", store_load, cfg, call_store_load,
+                           -500, 500);
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_PTR,
+                        DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("load_store", load_store, cfg, call_load_store,
+                           -500, 500);
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("copy_copy", copy_copy, cfg, call_copy_copy, -500,
+                           500);
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("copy_use", copy_use, cfg, call_copy_use, -500,
+                           500);
+
+    drob_teardown();
+    return ret;
+}
@@ -0,0 +1,141 @@
+#include "common.h"
+
+/*
+ * If p is restrict, the store via q can't modify *p and the second load
+ * can reuse the first one.
+ *
+ * long reload_after_store(long *p, long *q, long x)
+ * {
+ *     long val = *p;
+ *
+ *     *q = x;
+ *     return val + *p;
+ * }
+ */
+long reload_after_store(long *p, long *q, long x);
+asm(".text\n"
+    ".type reload_after_store, @function\n"
+    "reload_after_store:\n"
+    "    mov (%rdi), %rax\n"
+    "    mov %rdx, (%rsi)\n"
+    "    add (%rdi), %rax\n"
+    "    ret\n"
+    ".size reload_after_store, .-reload_after_store\n");
+
+/*
+ * If p is notnull, both null checks can be dropped.
+ *
+ * long null_checks(long *p, long x)
+ * {
+ *     if (!p)
+ *         return -1;
+ *     x += *p;
+ *     if (!p)
+ *         return -2;
+ *     return x;
+ * }
+ */
+long null_checks(long *p, long x);
+asm(".text\n"
+    ".type null_checks, @function\n"
+    "null_checks:\n"
+    "    test %rdi, %rdi\n"
+    "    je 1f\n"
+    "    mov %rsi, %rax\n"
+    "    add (%rdi), %rax\n"
+    "    cmp $0, %rdi\n"
+    "    je 2f\n"
+    "    ret\n"
+    "1:\n"
+    "    mov $-1, %rax\n"
+    "    ret\n"
+    "2:\n"
+    "    mov $-2, %rax\n"
+    "    ret\n"
+    ".size null_checks, .-null_checks\n");
+
+/*
+ * p + 8 could (in theory) be NULL even if p is notnull, so this check has
+ * to stay.
+ */
+long offset_null_check(long *p, long x);
+asm(".text\n"
+    ".type offset_null_check, @function\n"
+    "offset_null_check:\n"
+    "    lea 8(%rdi), %rdx\n"
+    "    test %rdx, %rdx\n"
+    "    je 1f\n"
+    "    mov %rsi, %rax\n"
+    "    add (%rdx), %rax\n"
+    "    ret\n"
+    "1:\n"
+    "    mov $-1, %rax\n"
+    "    ret\n"
+    ".size offset_null_check, .-offset_null_check\n");
+
+static long call_reload_distinct(drob_f func, long x)
+{
+    long p = x * 3, q = 0, ret;
+
+    ret = ((typeof(reload_after_store)*)func)(&p, &q, x);
+    return ret * 10000 + q;
+}
+
+static long call_reload_same(drob_f func, long x)
+{
+    long p = x * 3, ret;
+
+    ret = ((typeof(reload_after_store)*)func)(&p, &p, x);
+    return ret * 10000 + p;
+}
+
+static long call_null_checks(drob_f func, long x)
+{
+    long val = 77;
+
+    return ((typeof(null_checks)*)func)(&val, x);
+}
+
+static long call_offset_null_check(drob_f func, long x)
+{
+    long val[2] = { 77, 99 };
+
+    return ((typeof(offset_null_check)*)func)(val, x);
+}
+
+int main(void)
+{
+    drob_cfg *cfg;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    cfg = drob_cfg_new3(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_PTR,
+                        DROB_PARAM_TYPE_PTR, DROB_PARAM_TYPE_LONG);
+    drob_cfg_set_ptr_flag(cfg, 0, DROB_PTR_FLAG_RESTRICT);
+    ret |= test_specialize("reload_after_store (restrict)", reload_after_store,
+                           cfg, call_reload_distinct, -500, 500);
+
+    /* Without restrict, both pointers may alias */
+    cfg = drob_cfg_new3(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_PTR,
+                        DROB_PARAM_TYPE_PTR, DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("reload_after_store", reload_after_store, cfg,
+                           call_reload_same, -500, 500);
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_PTR,
+                        DROB_PARAM_TYPE_LONG);
+    drob_cfg_set_ptr_flag(cfg, 0, DROB_PTR_FLAG_NOTNULL);
+    ret |= test_specialize("null_checks", null_checks, cfg, call_null_checks,
+                           -500, 500);
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_PTR,
+                        DROB_PARAM_TYPE_LONG);
+    drob_cfg_set_ptr_flag(cfg, 0, DROB_PTR_FLAG_NOTNULL);
+    ret |= test_specialize("offset_null_check", offset_null_check, cfg,
+                           call_offset_null_check, -500, 500);
+
+    drob_teardown();
+    return ret;
+}
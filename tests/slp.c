@@ -0,0 +1,144 @@
+#include "common.h"
+
+/*
+ * All accesses are based on the same register and don't overlap, so both
+ * chains can be packed.
+ *
+ * void add_pairs(double *p)
+ * {
+ *     p[4] = p[0] + p[2];
+ *     p[5] = p[1] + p[3];
+ * }
+ */
+void add_pairs(double *p);
+asm(".text\n"
+    ".type add_pairs, @function\n"
+    "add_pairs:\n"
+    "    movsd (%rdi), %xmm0\n"
+    "    addsd 16(%rdi), %xmm0\n"
+    "    movsd %xmm0, 32(%rdi)\n"
+    "    movsd 8(%rdi), %xmm1\n"
+    "    addsd 24(%rdi), %xmm1\n"
+    "    movsd %xmm1, 40(%rdi)\n"
+    "    ret\n"
+    ".size add_pairs, .-add_pairs\n");
+
+/*
+ * The first store modifies the input of the second chain, so the chains
+ * must not be packed.
+ *
+ * void mul_shifted(double *p)
+ * {
+ *     p[1] = p[0] * p[2];
+ *     p[2] = p[1] * p[3];
+ * }
+ */
+void mul_shifted(double *p);
+asm(".text\n"
+    ".type mul_shifted, @function\n"
+    "mul_shifted:\n"
+    "    movsd (%rdi), %xmm0\n"
+    "    mulsd 16(%rdi), %xmm0\n"
+    "    movsd %xmm0, 8(%rdi)\n"
+    "    movsd 8(%rdi), %xmm1\n"
+    "    mulsd 24(%rdi), %xmm1\n"
+    "    movsd %xmm1, 16(%rdi)\n"
+    "    ret\n"
+    ".size mul_shifted, .-mul_shifted\n");
+
+/*
+ * The destination might alias the sources, so the chains must not be
+ * packed.
+ *
+ * void add_other(double *dst, const double *src)
+ * {
+ *     dst[0] = src[0] + src[2];
+ *     dst[1] = src[1] + src[3];
+ * }
+ */
+void add_other(double *dst, const double *src);
+asm(".text\n"
+    ".type add_other, @function\n"
+    "add_other:\n"
+    "    movsd (%rsi), %xmm0\n"
+    "    addsd 16(%rsi), %xmm0\n"
+    "    movsd %xmm0, (%rdi)\n"
+    "    movsd 8(%rsi), %xmm1\n"
+    "    addsd 24(%rsi), %xmm1\n"
+    "    movsd %xmm1, 8(%rdi)\n"
+    "    ret\n"
+    ".size add_other, .-add_other\n");
+
+static void init(double *p, unsigned int count, long x)
+{
+    unsigned int i;
+
+    for (i = 0; i < count; i++) {
+        p[i] = x * 0.5 + i * 1.25;
+    }
+}
+
+static long sum(const double *p, unsigned int count)
+{
+    unsigned int i;
+    long ret = 0;
+
+    for (i = 0; i < count; i++) {
+        ret = ret * 31 + (long)(p[i] * 1024);
+    }
+    return ret;
+}
+
+static long call_add_pairs(drob_f func, long x)
+{
+    double p[6];
+
+    init(p, 6, x);
+    ((typeof(add_pairs)*)func)(p);
+    return sum(p, 6);
+}
+
+static long call_mul_shifted(drob_f func, long x)
+{
+    double p[4];
+
+    init(p, 4, x);
+    ((typeof(mul_shifted)*)func)(p);
+    return sum(p, 4);
+}
+
+static long call_add_other(drob_f func, long x)
+{
+    double p[5];
+
+    /* The destination overlaps the second half of the source */
+    init(p, 5, x);
+    ((typeof(add_other)*)func)(p + 1, p);
+    return sum(p, 5);
+}
+
+int main(void)
+{
+    drob_cfg *cfg;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    cfg = drob_cfg_new1(DROB_PARAM_TYPE_VOID, DROB_PARAM_TYPE_PTR);
+    ret |= test_specialize("add_pairs", add_pairs, cfg, call_add_pairs, -500,
+                           500);
+
+    cfg = drob_cfg_new1(DROB_PARAM_TYPE_VOID, DROB_PARAM_TYPE_PTR);
+    ret |= test_specialize("mul_shifted", mul_shifted, cfg, call_mul_shifted,
+                           -500, 500);
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_VOID, DROB_PARAM_TYPE_PTR,
+                        DROB_PARAM_TYPE_PTR);
+    ret |= test_specialize("add_other", add_other, cfg, call_add_other, -500,
+                           500);
+
+    drob_teardown();
+    return ret;
+}
@@ -0,0 +1,68 @@
+#include "common.h"
+
+/*
+ * void add_vec(double *dst, const double *src)
+ * {
+ *     dst[0] += src[0];
+ *     dst[1] += src[1];
+ * }
+ */
+void add_vec(double *dst, const double *src);
+asm(".text\n"
+    ".type add_vec, @function\n"
+    "add_vec:\n"
+    "    movupd (%rdi), %xmm0\n"
+    "    movupd (%rsi), %xmm1\n"
+    "    addpd %xmm1, %xmm0\n"
+    "    movupd %xmm0, (%rdi)\n"
+    "    ret\n"
+    ".size add_vec, .-add_vec\n");
+
+/* src + 8 is only 8-byte aligned, so this load must stay MOVUPD */
+void mul_vec_offset(double *dst, const double *src);
+asm(".text\n"
+    ".type mul_vec_offset, @function\n"
+    "mul_vec_offset:\n"
+    "    movupd 8(%rsi), %xmm1\n"
+    "    movupd (%rdi), %xmm0\n"
+    "    mulpd %xmm1, %xmm0\n"
+    "    movupd %xmm0, (%rdi)\n"
+    "    ret\n"
+    ".size mul_vec_offset, .-mul_vec_offset\n");
+
+static long call_vec(drob_f func, long x)
+{
+    double dst[2] __attribute__((aligned(16))) = { x * 0.25, x * -1.5 };
+    double src[3] __attribute__((aligned(16))) = { 1.5, x * 2.0, 3.25 };
+
+    ((typeof(add_vec)*)func)(dst, src);
+    return (long)(dst[0] * 1024) * 31 + (long)(dst[1] * 1024);
+}
+
+int main(void)
+{
+    drob_cfg *cfg;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    /* Both pointers are aligned: MOVUPD can become MOVAPD */
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_VOID, DROB_PARAM_TYPE_PTR,
+                        DROB_PARAM_TYPE_PTR);
+    drob_cfg_set_ptr_align(cfg, 0, 16);
+    drob_cfg_set_ptr_align(cfg, 1, 16);
+    ret |= test_specialize("add_vec", add_vec, cfg, call_vec, -500, 500);
+
+    /* src + 8 is not 16-byte aligned */
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_VOID, DROB_PARAM_TYPE_PTR,
+                        DROB_PARAM_TYPE_PTR);
+    drob_cfg_set_ptr_align(cfg, 0, 16);
+    drob_cfg_set_ptr_align(cfg, 1, 16);
+    ret |= test_specialize("mul_vec_offset", mul_vec_offset, cfg,
+                           call_vec, -500, 500);
+
+    drob_teardown();
+    return ret;
+}
@@ -0,0 +1,38 @@
+#include "common.h"
+
+/* Without optimizations, all local variables live in stack slots */
+static long __attribute__((noinline, optimize("O0"))) mix(long a, long b)
+{
+    long x = a + b;
+    long y = a - b;
+    long z = x ^ y;
+
+    if (z > 100) {
+        z -= x;
+    } else {
+        z += y;
+    }
+    return z + x;
+}
+
+static long call_mix(drob_f func, long a)
+{
+    return ((typeof(mix)*)func)(a, a * 7 % 301);
+}
+
+int main(void)
+{
+    drob_cfg *cfg;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("mix", mix, cfg, call_mix, -300, 300);
+
+    drob_teardown();
+    return ret;
+}
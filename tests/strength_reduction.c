@@ -0,0 +1,63 @@
+#include "common.h"
+
+static long __attribute__((noinline))
+mul(long x, long factor)
+{
+    return x * factor;
+}
+
+static unsigned long __attribute__((noinline))
+udiv(unsigned long x, unsigned long divisor)
+{
+    return x / divisor;
+}
+
+static long cur;
+
+static long call_mul(drob_f func, long x)
+{
+    return ((typeof(mul)*)func)(x, cur);
+}
+
+static long call_udiv(drob_f func, long x)
+{
+    /* also cover values with the highest bit set */
+    return ((typeof(udiv)*)func)(x * 0x123456789l, cur);
+}
+
+int main(void)
+{
+    /* powers of two, LEA factors and general constants */
+    static const long factors[] = {
+        0, 1, 2, 3, 5, 8, 9, 1024, -1, 7, 10, 1000, -12345,
+    };
+    static const long divisors[] = {
+        1, 2, 8, 4096, 3, 5, 7, 9, 10, 1000,
+    };
+    drob_cfg *cfg;
+    unsigned int i;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(factors) / sizeof(factors[0]); i++) {
+        cur = factors[i];
+        cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                            DROB_PARAM_TYPE_LONG);
+        drob_cfg_set_param_long(cfg, 1, cur);
+        ret |= test_specialize("mul", mul, cfg, call_mul, -500, 500);
+    }
+
+    for (i = 0; i < sizeof(divisors) / sizeof(divisors[0]); i++) {
+        cur = divisors[i];
+        cfg = drob_cfg_new2(DROB_PARAM_TYPE_ULONG, DROB_PARAM_TYPE_ULONG,
+                            DROB_PARAM_TYPE_ULONG);
+        drob_cfg_set_param_ulong(cfg, 1, cur);
+        ret |= test_specialize("udiv", udiv, cfg, call_udiv, -500, 500);
+    }
+
+    drob_teardown();
+    return ret;
+}
@@ -0,0 +1,60 @@
+#include "common.h"
+
+static long __attribute__((noinline))
+weigh(long a, long b, long c, long d, long e, long f, long g, long h)
+{
+    return a + b * 2 + c * 3 + d * 4 + e * 5 + f * 6 + g * 7 + h * 8;
+}
+
+/* The call passes stack arguments, so it must not become a jump */
+static long __attribute__((noinline, optimize("no-optimize-sibling-calls")))
+weigh_all(long x, long y)
+{
+    return weigh(x, y, x, y, x, y, x, y);
+}
+
+static long __attribute__((noinline))
+weigh_two(long a, long b)
+{
+    return a * 3 - b;
+}
+
+/* The call only passes register arguments and can become a jump */
+static long __attribute__((noinline, optimize("no-optimize-sibling-calls")))
+weigh_some(long x, long y)
+{
+    return weigh_two(y, x);
+}
+
+static long call_weigh_all(drob_f func, long x)
+{
+    return ((typeof(weigh_all)*)func)(x, 13);
+}
+
+static long call_weigh_some(drob_f func, long x)
+{
+    return ((typeof(weigh_some)*)func)(x, 13);
+}
+
+int main(void)
+{
+    drob_cfg *cfg;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("weigh_all", weigh_all, cfg, call_weigh_all, -500,
+                           500);
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("weigh_some", weigh_some, cfg, call_weigh_some,
+                           -500, 500);
+
+    drob_teardown();
+    return ret;
+}
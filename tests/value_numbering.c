@@ -0,0 +1,110 @@
+#include "common.h"
+
+/*
+ * The second addition computes the same value as the first one and can
+ * reuse it.
+ *
+ * long square_sum(long x, long y)
+ * {
+ *     return (x + y) * (x + y);
+ * }
+ */
+long square_sum(long x, long y);
+asm(".text\n"
+    ".type square_sum, @function\n"
+    "square_sum:\n"
+    "    mov %rdi, %rax\n"
+    "    add %rsi, %rax\n"
+    "    mov %rdi, %rdx\n"
+    "    add %rsi, %rdx\n"
+    "    imul %rdx, %rax\n"
+    "    ret\n"
+    ".size square_sum, .-square_sum\n");
+
+/*
+ * x is modified between both additions, so the second one computes a
+ * different value.
+ *
+ * long shifted_product(long x, long y)
+ * {
+ *     return (x + y) * (x + 5 + y);
+ * }
+ */
+long shifted_product(long x, long y);
+asm(".text\n"
+    ".type shifted_product, @function\n"
+    "shifted_product:\n"
+    "    mov %rdi, %rax\n"
+    "    add %rsi, %rax\n"
+    "    add $5, %rdi\n"
+    "    mov %rdi, %rdx\n"
+    "    add %rsi, %rdx\n"
+    "    imul %rdx, %rax\n"
+    "    ret\n"
+    ".size shifted_product, .-shifted_product\n");
+
+/*
+ * The store modifies the loaded value, so it has to be loaded again.
+ *
+ * long reload(long *p)
+ * {
+ *     long val = *p;
+ *
+ *     *p = val * 3;
+ *     return val + *p;
+ * }
+ */
+long reload(long *p);
+asm(".text\n"
+    ".type reload, @function\n"
+    "reload:\n"
+    "    mov (%rdi), %rax\n"
+    "    lea (%rax,%rax,2), %rdx\n"
+    "    mov %rdx, (%rdi)\n"
+    "    add (%rdi), %rax\n"
+    "    ret\n"
+    ".size reload, .-reload\n");
+
+static long call_square_sum(drob_f func, long x)
+{
+    return ((typeof(square_sum)*)func)(x, 19);
+}
+
+static long call_shifted_product(drob_f func, long x)
+{
+    return ((typeof(shifted_product)*)func)(x, 19);
+}
+
+static long call_reload(drob_f func, long x)
+{
+    long val = x, sum;
+
+    sum = ((typeof(reload)*)func)(&val);
+    return sum * 10000 + val;
+}
+
+int main(void)
+{
+    drob_cfg *cfg;
+    int ret = 0;
+
+    if (test_setup()) {
+        return 1;
+    }
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("square_sum", square_sum, cfg, call_square_sum,
+                           -500, 500);
+
+    cfg = drob_cfg_new2(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_LONG,
+                        DROB_PARAM_TYPE_LONG);
+    ret |= test_specialize("shifted_product", shifted_product, cfg,
+                           call_shifted_product, -500, 500);
+
+    cfg = drob_cfg_new1(DROB_PARAM_TYPE_LONG, DROB_PARAM_TYPE_PTR);
+    ret |= test_specialize("reload", reload, cfg, call_reload, -500, 500);
+
+    drob_teardown();
+    return ret;
+}